@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 // Qt
 #include <QDropEvent>
 #include <QMenu>
+#include <QTimer>
 #include <QVBoxLayout>
 
 // KDE
@@ -57,6 +58,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 namespace Gwenview
 {
 
+static const int STATUS_MESSAGE_DURATION = 10000;
+
 inline Sorting::Enum sortingFromSortAction(const QAction* action)
 {
     Q_ASSERT(action);
@@ -71,6 +74,8 @@ struct BrowseMainPagePrivate : public Ui_BrowseMainPage
     KUrlNavigator* mUrlNavigator;
     SortedDirModel* mDirModel;
     int mDocumentCount;
+    QString mStatusMessage;
+    QTimer* mStatusMessageTimer;
     KActionCollection* mActionCollection;
     FilterController* mFilterController;
     KSelectAction* mSortAction;
@@ -181,6 +186,9 @@ struct BrowseMainPagePrivate : public Ui_BrowseMainPage
     void updateDocumentCountLabel()
     {
         QString text = i18ncp("@label", "%1 document", "%1 documents", mDocumentCount);
+        if (!mStatusMessage.isEmpty()) {
+            text = i18nc("@label document count, then a temporary message", "%1 - %2", text, mStatusMessage);
+        }
         mDocumentCountLabel->setText(text);
     }
 
@@ -253,6 +261,10 @@ BrowseMainPage::BrowseMainPage(QWidget* parent, KActionCollection* actionCollect
     d->mGvCore = gvCore;
     d->mDirModel = gvCore->sortedDirModel();
     d->mDocumentCount = 0;
+    d->mStatusMessageTimer = new QTimer(this);
+    d->mStatusMessageTimer->setInterval(STATUS_MESSAGE_DURATION);
+    d->mStatusMessageTimer->setSingleShot(true);
+    connect(d->mStatusMessageTimer, SIGNAL(timeout()), SLOT(clearStatusMessage()));
     d->mActionCollection = actionCollection;
     d->setupWidgets();
     d->setupActions(actionCollection);
@@ -416,6 +428,19 @@ void BrowseMainPage::setStatusBarVisible(bool visible)
     d->mStatusBarContainer->setVisible(visible);
 }
 
+void BrowseMainPage::showStatusMessage(const QString& text)
+{
+    d->mStatusMessage = text;
+    d->updateDocumentCountLabel();
+    d->mStatusMessageTimer->start();
+}
+
+void BrowseMainPage::clearStatusMessage()
+{
+    d->mStatusMessage.clear();
+    d->updateDocumentCountLabel();
+}
+
 void BrowseMainPage::slotUrlsDropped(const QUrl &destUrl, QDropEvent* event)
 {
     const QList<QUrl> urlList = KUrlMimeData::urlsFromMimeData(event->mimeData());
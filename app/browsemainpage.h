@@ -65,6 +65,11 @@ public:
     void setFullScreenMode(bool);
     void setStatusBarVisible(bool);
 
+    /**
+     * Shows @p text next to the document count for a few seconds
+     */
+    void showStatusMessage(const QString& text);
+
     QToolButton* toggleSideBarButton() const;
 
 private Q_SLOTS:
@@ -74,6 +79,7 @@ private Q_SLOTS:
     void slotDirModelRowsInserted(const QModelIndex& parent, int start, int end);
     void slotDirModelRowsAboutToBeRemoved(const QModelIndex& parent, int start, int end);
     void slotDirModelReset();
+    void clearStatusMessage();
     void updateSortOrder();
     void updateThumbnailDetails();
     void slotUrlsDropped(const QUrl &destUrl, QDropEvent*);
@@ -42,6 +42,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <KActionCollection>
 #include <QFileDialog>
 #include <KFileItem>
+#include <KIO/Global>
 #include <KLocalizedString>
 #include <KMessageBox>
 #include <KNotificationRestrictions>
@@ -92,6 +93,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <lib/slideshow.h>
 #include <lib/signalblocker.h>
 #include <lib/semanticinfo/sorteddirmodel.h>
+#include <lib/thumbnailprovider/thumbnailcachecleaner.h>
 #include <lib/thumbnailprovider/thumbnailprovider.h>
 #include <lib/thumbnailview/thumbnailbarview.h>
 #include <lib/thumbnailview/thumbnailview.h>
@@ -111,6 +113,9 @@ namespace Gwenview
 
 static const int BROWSE_PRELOAD_DELAY = 1000;
 static const int VIEW_PRELOAD_DELAY = 100;
+// Do not slow down startup, and do not clean more than once a day
+static const int THUMBNAIL_CACHE_CLEANING_DELAY = 60 * 1000;
+static const int THUMBNAIL_CACHE_CLEANING_INTERVAL = 24 * 60 * 60;
 
 static const char* SESSION_CURRENT_PAGE_KEY = "Page";
 static const char* SESSION_URL_KEY = "Url";
@@ -158,6 +163,7 @@ struct MainWindow::Private
     DocumentInfoProvider* mDocumentInfoProvider;
     ThumbnailViewHelper* mThumbnailViewHelper;
     QPointer<ThumbnailProvider> mThumbnailProvider;
+    ThumbnailCacheCleaner* mThumbnailCacheCleaner;
     BrowseMainPage* mBrowseMainPage;
     StartMainPage* mStartMainPage;
     SideBar* mSideBar;
@@ -801,6 +807,7 @@ MainWindow::MainWindow()
     d->mPreloader = new Preloader(this);
     d->mNotificationRestrictions = 0;
     d->mThumbnailProvider = new ThumbnailProvider();
+    d->mThumbnailCacheCleaner = 0;
     d->mActiveThumbnailView = 0;
     d->initDirModel();
     d->setupWidgets();
@@ -826,10 +833,13 @@ MainWindow::MainWindow()
 #ifdef Q_OS_OSX
     qApp->installEventFilter(this);
 #endif
+    QTimer::singleShot(THUMBNAIL_CACHE_CLEANING_DELAY, this, SLOT(cleanThumbnailCache()));
 }
 
 MainWindow::~MainWindow()
 {
+    // Stop cleaning before the thumbnail dir is possibly removed
+    delete d->mThumbnailCacheCleaner;
     if (GwenviewConfig::deleteThumbnailCacheOnExit()) {
         QDir dir(ThumbnailProvider::thumbnailBaseDir());
         if (dir.exists()) {
@@ -1544,6 +1554,29 @@ void MainWindow::preloadNextUrl()
     }
 }
 
+void MainWindow::cleanThumbnailCache()
+{
+    const QDateTime lastCleaning = GwenviewConfig::lastThumbnailCacheCleaning();
+    if (d->mThumbnailCacheCleaner
+            || (lastCleaning.isValid() && lastCleaning.secsTo(QDateTime::currentDateTime()) < THUMBNAIL_CACHE_CLEANING_INTERVAL)) {
+        return;
+    }
+    d->mThumbnailCacheCleaner = new ThumbnailCacheCleaner;
+    d->mThumbnailCacheCleaner->setSizeLimit(qint64(GwenviewConfig::thumbnailCacheSizeLimit()) * 1024 * 1024);
+    connect(d->mThumbnailCacheCleaner, &ThumbnailCacheCleaner::finished, this, [=](const ThumbnailCacheCleaner::Report& report) {
+        LOG("Thumbnail cache cleaned:" << report.mOrphanCount << "orphan thumbnails and"
+            << report.mEvictedCount << "old thumbnails removed," << report.mRemovedBytes / 1024 << "KB freed,"
+            << report.mRemainingBytes / 1024 << "KB used");
+        d->mBrowseMainPage->showStatusMessage(
+            i18ncp("@info:status", "Thumbnail cache cleaned: %1 thumbnail removed, %2 freed",
+                   "Thumbnail cache cleaned: %1 thumbnails removed, %2 freed",
+                   report.mOrphanCount + report.mEvictedCount, KIO::convertSize(report.mRemovedBytes)));
+        GwenviewConfig::setLastThumbnailCacheCleaning(QDateTime::currentDateTime());
+        GwenviewConfig::self()->save();
+    });
+    d->mThumbnailCacheCleaner->start();
+}
+
 QSize MainWindow::sizeHint() const
 {
     return KXmlGuiWindow::sizeHint().expandedTo(QSize(750, 500));
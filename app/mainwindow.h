@@ -122,6 +122,7 @@ private Q_SLOTS:
     void print();
 
     void preloadNextUrl();
+    void cleanThumbnailCache();
 
     void toggleMenuBar();
     void toggleStatusBar(bool visible);
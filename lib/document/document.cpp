@@ -39,6 +39,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "loadingdocumentimpl.h"
 #include "loadingjob.h"
 #include "savejob.h"
+#include "traceutils.h"
 
 namespace Gwenview
 {
@@ -124,6 +125,7 @@ void DocumentPrivate::scheduleImageDownSampling(int invertedZoom)
 
 void DocumentPrivate::downSampleImage(int invertedZoom)
 {
+    GV_TRACE_SPAN("document", "Document::downSampleImage");
     mDownSampledImageMap[invertedZoom] = mImage.scaled(mImage.size() / invertedZoom, Qt::KeepAspectRatio, Qt::FastTransformation);
     if (mDownSampledImageMap[invertedZoom].size().isEmpty()) {
         mDownSampledImageMap[invertedZoom] = mImage;
@@ -525,6 +527,7 @@ void Document::enqueueJob(DocumentJob* job)
     } else {
         d->mCurrentJob = job;
         LOG("Starting first job");
+        TraceUtils::recordAsyncBegin("document", job->metaObject()->className(), job, d->mUrl.toDisplayString());
         job->start();
         busyChanged(d->mUrl, true);
     }
@@ -535,6 +538,7 @@ void Document::slotJobFinished(KJob* job)
 {
     LOG("job=" << job);
     GV_RETURN_IF_FAIL(job == d->mCurrentJob.data());
+    TraceUtils::recordAsyncEnd("document", job->metaObject()->className(), job);
 
     if (d->mJobQueue.isEmpty()) {
         LOG("All done");
@@ -545,6 +549,7 @@ void Document::slotJobFinished(KJob* job)
         LOG("Starting next job");
         d->mCurrentJob = d->mJobQueue.dequeue();
         GV_RETURN_IF_FAIL(d->mCurrentJob);
+        TraceUtils::recordAsyncBegin("document", d->mCurrentJob->metaObject()->className(), d->mCurrentJob.data(), d->mUrl.toDisplayString());
         d->mCurrentJob.data()->start();
     }
     LOG_QUEUE("Removed done job", d);
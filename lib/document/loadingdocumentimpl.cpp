@@ -60,6 +60,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
 #include "jpegdocumentloadedimpl.h"
 #include "orientation.h"
 #include "svgdocumentloadedimpl.h"
+#include "traceutils.h"
 #include "urlutils.h"
 #include "videodocumentloadedimpl.h"
 #include "gwenviewconfig.h"
@@ -188,6 +189,7 @@ struct LoadingDocumentImplPrivate
 
     bool loadMetaInfo()
     {
+        GV_TRACE_SPAN_DETAIL("document", "LoadingDocumentImpl::loadMetaInfo", q->document()->url().toDisplayString());
         LOG("mFormatHint" << mFormatHint);
         QBuffer buffer;
         buffer.setBuffer(&mData);
@@ -291,6 +293,8 @@ struct LoadingDocumentImplPrivate
 
     void loadImageData()
     {
+        GV_TRACE_SPAN_DETAIL("document", "LoadingDocumentImpl::loadImageData",
+            q->document()->url().toDisplayString() + QStringLiteral(" invertedZoom=") + QString::number(mImageDataInvertedZoom));
         QBuffer buffer;
         buffer.setBuffer(&mData);
         buffer.open(QIODevice::ReadOnly);
@@ -386,6 +390,7 @@ LoadingDocumentImpl::~LoadingDocumentImpl()
 void LoadingDocumentImpl::init()
 {
     QUrl url = document()->url();
+    GV_TRACE_SPAN_DETAIL("document", "LoadingDocumentImpl::init", url.toDisplayString());
 
     if (UrlUtils::urlIsFastLocalFile(url)) {
         // Load file content directly
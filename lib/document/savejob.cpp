@@ -39,6 +39,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 
 // Local
 #include "documentloadedimpl.h"
+#include "traceutils.h"
 
 namespace Gwenview
 {
@@ -74,6 +75,7 @@ SaveJob::~SaveJob()
 
 void SaveJob::saveInternal()
 {
+    GV_TRACE_SPAN_DETAIL("save", "SaveJob::saveInternal", d->mNewUrl.toDisplayString());
     if (!d->mImpl->saveInternal(d->mSaveFile.data(), d->mFormat)) {
         d->mSaveFile->cancelWriting();
         setError(UserDefinedError + 2);
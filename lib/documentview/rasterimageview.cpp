@@ -23,9 +23,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 
 // Local
 #include <lib/documentview/abstractrasterimageviewtool.h>
+#include <lib/documentview/rendercache.h>
 #include <lib/imagescaler.h>
 #include <lib/cms/cmsprofile.h>
 #include <lib/gvdebug.h>
+#include <lib/traceutils.h>
 
 // KDE
 
@@ -40,6 +42,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 namespace Gwenview
 {
 
+/** Size of the tiles shared with other views through RenderCache */
+static const int TILE_SIZE = 256;
+
 struct RasterImageViewPrivate
 {
     RasterImageView* q;
@@ -65,8 +70,12 @@ struct RasterImageViewPrivate
 
     QPointer<AbstractRasterImageViewTool> mTool;
 
+    Qt::TransformationMode mTransformationMode;
+
     bool mApplyDisplayTransform; // Defaults to true. Can be set to false if there is no need or no way to apply color profile
     cmsHTRANSFORM mDisplayTransform;
+    // Description of the monitor profile mDisplayTransform converts to
+    QString mDisplayProfile;
 
     void updateDisplayTransform(QImage::Format format)
     {
@@ -86,8 +95,10 @@ struct RasterImageViewPrivate
         Cms::Profile::Ptr monitorProfile = Cms::Profile::getMonitorProfile();
         if (!monitorProfile) {
             qWarning() << "Could not get monitor color profile";
+            mDisplayProfile.clear();
             return;
         }
+        mDisplayProfile = monitorProfile->description();
 
         cmsUInt32Number cmsFormat = 0;
         switch (format) {
@@ -147,7 +158,74 @@ struct RasterImageViewPrivate
     void setScalerRegionToVisibleRect()
     {
         QRectF rect = mapViewportToZoomedImage(q->boundingRect());
-        mScaler->setDestinationRegion(QRegion(rect.toRect()));
+        setScalerRegion(QRegion(rect.toRect()));
+    }
+
+    RenderCacheKey renderCacheKey(const QRect& tile) const
+    {
+        RenderCacheKey key;
+        key.mDocument = q->document().data();
+        key.mZoom = q->zoom();
+        key.mTile = tile;
+        key.mTransformationMode = mTransformationMode;
+        key.mRenderingIntent = int(mRenderingIntent);
+        // Views which cannot apply the display transform, or which show the
+        // document on another monitor, must not share tiles
+        key.mDisplayTransform = mApplyDisplayTransform;
+        key.mDisplayProfile = mDisplayProfile;
+        key.mPyramidFallback = mScaler->usesPyramidFallback();
+        return key;
+    }
+
+    /**
+     * Draws tiles already rendered by any view from the render cache and
+     * only asks the scaler for the missing ones.
+     */
+    void setScalerRegion(const QRegion& region)
+    {
+        GV_TRACE_SPAN("view", "RasterImageView::setScalerRegion");
+        if (!q->document()) {
+            return;
+        }
+        if (q->zoom() >= Document::maxDownSampledZoom()) {
+            mScaler->setPyramidFallback(!RenderCache::instance()->requestFullImage(q->document().data()));
+        }
+        QRegion missingRegion;
+        Q_FOREACH(const QRect& tile, mScaler->tilesForRegion(region)) {
+            const QImage image = RenderCache::instance()->tile(renderCacheKey(tile));
+            if (image.isNull()) {
+                missingRegion += tile;
+            } else {
+                drawToBuffer(tile.left(), tile.top(), image);
+            }
+        }
+        mScaler->setDestinationRegion(missingRegion);
+    }
+
+    void drawToBuffer(int zoomedImageLeft, int zoomedImageTop, const QImage& image)
+    {
+        resizeBuffer();
+        int viewportLeft = zoomedImageLeft - q->scrollPos().x();
+        int viewportTop = zoomedImageTop - q->scrollPos().y();
+        mBufferIsEmpty = false;
+        {
+            QPainter painter(&mCurrentBuffer);
+            if (q->document()->hasAlphaChannel()) {
+                drawAlphaBackground(
+                    &painter, QRect(viewportLeft, viewportTop, image.width(), image.height()),
+                    QPoint(zoomedImageLeft, zoomedImageTop)
+                );
+            } else {
+                painter.setCompositionMode(QPainter::CompositionMode_Source);
+            }
+            painter.drawImage(viewportLeft, viewportTop, image);
+        }
+        q->update();
+
+        if (!mEmittedCompleted) {
+            mEmittedCompleted = true;
+            q->completed();
+        }
     }
 
     void resizeBuffer()
@@ -205,8 +283,10 @@ RasterImageView::RasterImageView(QGraphicsItem* parent)
     d->mEnlargeSmallerImages = false;
 
     d->mBufferIsEmpty = true;
+    d->mTransformationMode = Qt::FastTransformation;
     d->mScaler = new ImageScaler(this);
-    connect(d->mScaler, &ImageScaler::scaledRect, this, &RasterImageView::updateFromScaler);
+    d->mScaler->setTileSize(TILE_SIZE);
+    connect(d->mScaler, &ImageScaler::scaledTile, this, &RasterImageView::updateFromScaler);
 
     d->createBackgroundTexture();
     d->setupUpdateTimer();
@@ -281,6 +361,7 @@ void RasterImageView::finishSetDocument()
 {
     GV_RETURN_IF_FAIL(document()->size().isValid());
 
+    RenderCache::instance()->setViewDocument(this, document().data());
     d->mScaler->setDocument(document());
     d->resizeBuffer();
     applyPendingScrollPos();
@@ -324,8 +405,9 @@ void RasterImageView::slotDocumentIsAnimatedUpdated()
     d->startAnimationIfNecessary();
 }
 
-void RasterImageView::updateFromScaler(int zoomedImageLeft, int zoomedImageTop, const QImage& image)
+void RasterImageView::updateFromScaler(const QRect& tile, int zoomedImageLeft, int zoomedImageTop, const QImage& image)
 {
+    GV_TRACE_SPAN("view", "RasterImageView::updateFromScaler");
     if (d->mApplyDisplayTransform) {
         d->updateDisplayTransform(image.format());
         if (d->mDisplayTransform) {
@@ -334,28 +416,13 @@ void RasterImageView::updateFromScaler(int zoomedImageLeft, int zoomedImageTop,
         }
     }
 
-    d->resizeBuffer();
-    int viewportLeft = zoomedImageLeft - scrollPos().x();
-    int viewportTop = zoomedImageTop - scrollPos().y();
-    d->mBufferIsEmpty = false;
-    {
-        QPainter painter(&d->mCurrentBuffer);
-        if (document()->hasAlphaChannel()) {
-            d->drawAlphaBackground(
-                &painter, QRect(viewportLeft, viewportTop, image.width(), image.height()),
-                QPoint(zoomedImageLeft, zoomedImageTop)
-            );
-        } else {
-            painter.setCompositionMode(QPainter::CompositionMode_Source);
-        }
-        painter.drawImage(viewportLeft, viewportTop, image);
+    // The scaler may have returned a slightly shifted rect because of
+    // rounding. Only share tiles which exactly match the requested one.
+    if (tile.topLeft() == QPoint(zoomedImageLeft, zoomedImageTop) && tile.size() == image.size()) {
+        RenderCache::instance()->insertTile(d->renderCacheKey(tile), image);
     }
-    update();
 
-    if (!d->mEmittedCompleted) {
-        d->mEmittedCompleted = true;
-        completed();
-    }
+    d->drawToBuffer(zoomedImageLeft, zoomedImageTop, image);
 }
 
 void RasterImageView::onZoomChanged()
@@ -363,10 +430,11 @@ void RasterImageView::onZoomChanged()
     // If we zoom more than twice, then assume the user wants to see the real
     // pixels, for example to fine tune a crop operation
     if (zoom() < 2.) {
-        d->mScaler->setTransformationMode(Qt::SmoothTransformation);
+        d->mTransformationMode = Qt::SmoothTransformation;
     } else {
-        d->mScaler->setTransformationMode(Qt::FastTransformation);
+        d->mTransformationMode = Qt::FastTransformation;
     }
+    d->mScaler->setTransformationMode(d->mTransformationMode);
     if (!d->mUpdateTimer->isActive()) {
         updateBuffer();
     }
@@ -457,7 +525,7 @@ void RasterImageView::updateBuffer(const QRegion& region)
     if (region.isEmpty()) {
         d->setScalerRegionToVisibleRect();
     } else {
-        d->mScaler->setDestinationRegion(region);
+        d->setScalerRegion(region);
     }
 }
 
@@ -79,7 +79,7 @@ private Q_SLOTS:
     void slotDocumentMetaInfoLoaded();
     void slotDocumentIsAnimatedUpdated();
     void finishSetDocument();
-    void updateFromScaler(int, int, const QImage&);
+    void updateFromScaler(const QRect& tile, int, int, const QImage&);
     void updateImageRect(const QRect& imageRect);
     void updateBuffer(const QRegion& region = QRegion());
 
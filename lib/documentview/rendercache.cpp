@@ -0,0 +1,270 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+// Self
+#include "rendercache.h"
+
+// Local
+#include <lib/document/document.h>
+#include <lib/memoryutils.h>
+
+// KDE
+
+// Qt
+#include <QCache>
+#include <QDebug>
+#include <QHash>
+#include <QSet>
+
+namespace Gwenview
+{
+
+#undef ENABLE_LOG
+#undef LOG
+//#define ENABLE_LOG
+#ifdef ENABLE_LOG
+#define LOG(x) qDebug() << x
+#else
+#define LOG(x) ;
+#endif
+
+/** Size of the tile cache, in kilobytes */
+static const int DEFAULT_TILE_CACHE_SIZE = 128 * 1024;
+
+inline qulonglong getFullImageBudget()
+{
+    // By default allow full images to use a quarter of the memory
+    qulonglong defaultValue = MemoryUtils::getTotalMemory() / 4;
+    QByteArray ba = qgetenv("GV_FULL_IMAGE_MEMORY_BUDGET");
+    if (ba.isEmpty()) {
+        return defaultValue;
+    }
+    LOG("Custom full image memory budget:" << ba << "MB");
+    bool ok;
+    qulonglong value = ba.toULongLong(&ok);
+    return ok ? value * 1024 * 1024 : defaultValue;
+}
+
+inline qulonglong fullImageBytes(const Document* document)
+{
+    const QSize size = document->size();
+    return qulonglong(size.width()) * size.height() * 4;
+}
+
+uint qHash(const RenderCacheKey& key, uint seed)
+{
+    return qHash(key.mDocument, seed)
+        ^ qHash(key.mZoom, seed)
+        ^ qHash(key.mTile.left(), seed) * 31
+        ^ qHash(key.mTile.top(), seed) * 17
+        ^ uint(key.mTransformationMode)
+        ^ (uint(key.mRenderingIntent) << 8)
+        ^ (uint(key.mPyramidFallback) << 16)
+        ^ (uint(key.mDisplayTransform) << 17)
+        ^ qHash(key.mDisplayProfile, seed);
+}
+
+typedef QCache<RenderCacheKey, QImage> TileCache;
+
+struct RenderCachePrivate
+{
+    RenderCache* q;
+    TileCache mTileCache;
+    /// Keys of the tiles inserted for each document, so that tiles can be
+    /// dropped without going through the whole cache. May contain keys the
+    /// cache has already evicted.
+    QHash<const Document*, QSet<RenderCacheKey> > mKeysForDocument;
+    QSet<const Document*> mConnectedDocuments;
+    QHash<const QObject*, const Document*> mDocumentForView;
+    /// Documents which have been allowed to load their full image
+    QSet<const Document*> mFullImageDocuments;
+    qulonglong mFullImageBudget;
+
+    void watchDocument(const Document* document)
+    {
+        if (mConnectedDocuments.contains(document)) {
+            return;
+        }
+        mConnectedDocuments << document;
+        QObject::connect(document, SIGNAL(destroyed(QObject*)),
+                         q, SLOT(slotDocumentDestroyed(QObject*)));
+        // Documents are watched as soon as a view shows them, before the view
+        // connects to imageRectUpdated(), so stale tiles are dropped before
+        // views ask for them again
+        QObject::connect(document, SIGNAL(imageRectUpdated(QRect)),
+                         q, SLOT(slotImageRectUpdated(QRect)));
+    }
+
+    void addKey(const RenderCacheKey& key)
+    {
+        QSet<RenderCacheKey>& keys = mKeysForDocument[key.mDocument];
+        if (keys.count() >= 2 * mTileCache.count()) {
+            // Forget the keys of evicted tiles
+            QSet<RenderCacheKey>::Iterator it = keys.begin();
+            while (it != keys.end()) {
+                if (mTileCache.contains(*it)) {
+                    ++it;
+                } else {
+                    it = keys.erase(it);
+                }
+            }
+        }
+        keys << key;
+    }
+
+    void forgetDocumentIfUnused(const Document* document)
+    {
+        Q_FOREACH(const Document* displayed, mDocumentForView) {
+            if (displayed == document) {
+                return;
+            }
+        }
+        mFullImageDocuments.remove(document);
+    }
+};
+
+RenderCache::RenderCache()
+: d(new RenderCachePrivate)
+{
+    d->q = this;
+    d->mTileCache.setMaxCost(DEFAULT_TILE_CACHE_SIZE);
+    d->mFullImageBudget = getFullImageBudget();
+}
+
+RenderCache::~RenderCache()
+{
+    delete d;
+}
+
+RenderCache* RenderCache::instance()
+{
+    static RenderCache cache;
+    return &cache;
+}
+
+QImage RenderCache::tile(const RenderCacheKey& key) const
+{
+    QImage* image = d->mTileCache.object(key);
+    return image ? *image : QImage();
+}
+
+void RenderCache::insertTile(const RenderCacheKey& key, const QImage& image)
+{
+    if (image.isNull()) {
+        return;
+    }
+    d->watchDocument(key.mDocument);
+    // Cost is in kilobytes
+    d->mTileCache.insert(key, new QImage(image), qMax(1, image.byteCount() / 1024));
+    d->addKey(key);
+}
+
+void RenderCache::removeDocument(const Document* document)
+{
+    Q_FOREACH(const RenderCacheKey& key, d->mKeysForDocument.take(document)) {
+        d->mTileCache.remove(key);
+    }
+}
+
+void RenderCache::removeTiles(const Document* document, const QRect& imageRect)
+{
+    QHash<const Document*, QSet<RenderCacheKey> >::Iterator keysIt = d->mKeysForDocument.find(document);
+    if (keysIt == d->mKeysForDocument.end()) {
+        return;
+    }
+    QSet<RenderCacheKey>& keys = keysIt.value();
+    QSet<RenderCacheKey>::Iterator it = keys.begin();
+    while (it != keys.end()) {
+        const RenderCacheKey& key = *it;
+        // Tiles are in zoomed image coordinates. Grow the rect a bit: smooth
+        // scaling reads neighbor pixels.
+        const QRect zoomedRect = QRectF(QPointF(imageRect.topLeft()) * key.mZoom, QSizeF(imageRect.size()) * key.mZoom)
+            .toAlignedRect().adjusted(-2, -2, 2, 2);
+        if (key.mTile.intersects(zoomedRect)) {
+            d->mTileCache.remove(key);
+            it = keys.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void RenderCache::slotImageRectUpdated(const QRect& imageRect)
+{
+    removeTiles(static_cast<const Document*>(sender()), imageRect);
+}
+
+void RenderCache::setViewDocument(const QObject* view, const Document* document)
+{
+    const Document* oldDocument = d->mDocumentForView.value(view);
+    if (oldDocument == document) {
+        return;
+    }
+    if (!d->mDocumentForView.contains(view)) {
+        connect(view, SIGNAL(destroyed(QObject*)), SLOT(slotViewDestroyed(QObject*)));
+    }
+    if (document) {
+        d->mDocumentForView[view] = document;
+        d->watchDocument(document);
+    } else {
+        d->mDocumentForView.remove(view);
+        disconnect(view, 0, this, 0);
+    }
+    if (oldDocument) {
+        d->forgetDocumentIfUnused(oldDocument);
+    }
+}
+
+bool RenderCache::requestFullImage(const Document* document)
+{
+    if (document->loadingState() == Document::Loaded || d->mFullImageDocuments.contains(document)) {
+        return true;
+    }
+    qulonglong total = fullImageBytes(document);
+    Q_FOREACH(const Document* other, d->mFullImageDocuments) {
+        total += fullImageBytes(other);
+    }
+    if (total > d->mFullImageBudget && !d->mFullImageDocuments.isEmpty()) {
+        LOG("Not enough memory budget for" << document->url() << ", falling back to down sampled image");
+        return false;
+    }
+    d->mFullImageDocuments << document;
+    return true;
+}
+
+void RenderCache::slotDocumentDestroyed(QObject* object)
+{
+    // Do not use qobject_cast: the Document part of object has already been
+    // destroyed
+    const Document* document = static_cast<const Document*>(object);
+    removeDocument(document);
+    d->mConnectedDocuments.remove(document);
+    d->mFullImageDocuments.remove(document);
+}
+
+void RenderCache::slotViewDestroyed(QObject* view)
+{
+    const Document* document = d->mDocumentForView.take(view);
+    if (document) {
+        d->forgetDocumentIfUnused(document);
+    }
+}
+
+} // namespace
@@ -0,0 +1,146 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <lib/gwenviewlib_export.h>
+
+// Local
+
+// KDE
+
+// Qt
+#include <QImage>
+#include <QObject>
+#include <QRect>
+#include <QString>
+
+namespace Gwenview
+{
+
+class Document;
+
+/**
+ * Identifies a scaled and color-transformed tile of a document.
+ */
+struct RenderCacheKey
+{
+    RenderCacheKey()
+    : mDocument(0)
+    , mZoom(0)
+    , mTransformationMode(Qt::FastTransformation)
+    , mRenderingIntent(0)
+    , mDisplayTransform(false)
+    , mPyramidFallback(false)
+    {}
+
+    const Document* mDocument;
+    qreal mZoom;
+    /// Tile rect, in zoomed image coordinates
+    QRect mTile;
+    Qt::TransformationMode mTransformationMode;
+    /// Rendering intent used for the display transform
+    int mRenderingIntent;
+    /// True if the tile went through the display transform
+    bool mDisplayTransform;
+    /// Description of the monitor profile used for the display transform
+    QString mDisplayProfile;
+    /// True if the tile has been scaled from a down sampled image because the
+    /// full image did not fit in the memory budget
+    bool mPyramidFallback;
+
+    bool operator==(const RenderCacheKey& other) const
+    {
+        return mDocument == other.mDocument
+            && mZoom == other.mZoom
+            && mTile == other.mTile
+            && mTransformationMode == other.mTransformationMode
+            && mRenderingIntent == other.mRenderingIntent
+            && mDisplayTransform == other.mDisplayTransform
+            && mDisplayProfile == other.mDisplayProfile
+            && mPyramidFallback == other.mPyramidFallback;
+    }
+};
+
+uint qHash(const RenderCacheKey& key, uint seed = 0);
+
+struct RenderCachePrivate;
+/**
+ * A process-wide cache of rendered tiles, shared by all RasterImageView
+ * instances. When several views show the same document at the same zoom, as
+ * can happen in compare mode, tiles are only scaled and color-transformed
+ * once.
+ *
+ * It also keeps track of the documents currently displayed so that views can
+ * decide whether decoding another full resolution image fits in the memory
+ * budget.
+ */
+class GWENVIEWLIB_EXPORT RenderCache : public QObject
+{
+    Q_OBJECT
+public:
+    static RenderCache* instance();
+
+    QImage tile(const RenderCacheKey& key) const;
+
+    void insertTile(const RenderCacheKey& key, const QImage& image);
+
+    /**
+     * Drop all tiles of @p document
+     */
+    void removeDocument(const Document* document);
+
+    /**
+     * Drop the tiles of @p document which show part of @p imageRect, in
+     * image coordinates. This is done automatically when the document emits
+     * imageRectUpdated().
+     */
+    void removeTiles(const Document* document, const QRect& imageRect);
+
+    /**
+     * Tell the cache @p view is showing @p document. Pass a null document
+     * to unregister the view.
+     */
+    void setViewDocument(const QObject* view, const Document* document);
+
+    /**
+     * Returns true if the full image of @p document can be decoded without
+     * making the full images of all displayed documents exceed the memory
+     * budget. If it can, the memory is accounted for until no view shows
+     * @p document anymore. Documents whose full image is already loaded are
+     * always allowed.
+     */
+    bool requestFullImage(const Document* document);
+
+private Q_SLOTS:
+    void slotDocumentDestroyed(QObject*);
+    void slotImageRectUpdated(const QRect&);
+    void slotViewDestroyed(QObject*);
+
+private:
+    RenderCache();
+    ~RenderCache();
+    RenderCachePrivate* const d;
+};
+
+} // namespace
+
+#endif /* RENDERCACHE_H */
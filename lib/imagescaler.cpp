@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 // Local
 #include <lib/document/document.h>
 #include <lib/paintutils.h>
+#include <lib/traceutils.h>
 
 #undef ENABLE_LOG
 #undef LOG
@@ -45,12 +46,32 @@ namespace Gwenview
 // Amount of pixels to keep so that smooth scale is correct
 static const int SMOOTH_MARGIN = 3;
 
+// Zoom used to pick the down sampled image when falling back from the full
+// image. This selects the half-resolution image.
+static const qreal PYRAMID_FALLBACK_ZOOM = 0.2;
+
 struct ImageScalerPrivate
 {
     Qt::TransformationMode mTransformationMode;
     Document::Ptr mDocument;
     qreal mZoom;
     QRegion mRegion;
+    int mTileSize;
+    bool mPyramidFallback;
+
+    bool usesPyramidFallback() const
+    {
+        return mPyramidFallback && mZoom >= Document::maxDownSampledZoom()
+            && mDocument && mDocument->image().isNull();
+    }
+
+    /**
+     * Zoom for which the source image must be picked
+     */
+    qreal sourceZoom() const
+    {
+        return usesPyramidFallback() ? PYRAMID_FALLBACK_ZOOM : mZoom;
+    }
 };
 
 ImageScaler::ImageScaler(QObject* parent)
@@ -59,6 +80,8 @@ ImageScaler::ImageScaler(QObject* parent)
 {
     d->mTransformationMode = Qt::FastTransformation;
     d->mZoom = 0;
+    d->mTileSize = 0;
+    d->mPyramidFallback = false;
 }
 
 ImageScaler::~ImageScaler()
@@ -90,6 +113,51 @@ void ImageScaler::setTransformationMode(Qt::TransformationMode mode)
     d->mTransformationMode = mode;
 }
 
+void ImageScaler::setTileSize(int size)
+{
+    d->mTileSize = size;
+}
+
+void ImageScaler::setPyramidFallback(bool value)
+{
+    d->mPyramidFallback = value;
+}
+
+bool ImageScaler::usesPyramidFallback() const
+{
+    return d->usesPyramidFallback();
+}
+
+QVector<QRect> ImageScaler::tilesForRegion(const QRegion& region) const
+{
+    QVector<QRect> tiles;
+    if (!d->mDocument || d->mZoom <= 0) {
+        return tiles;
+    }
+    if (d->mTileSize <= 0) {
+        Q_FOREACH(const QRect & rect, region.rects()) {
+            tiles << rect;
+        }
+        return tiles;
+    }
+    const QRect imageRect = PaintUtils::containingRect(
+        QRectF(QPointF(0, 0), QSizeF(d->mDocument->size()) * d->mZoom));
+    const QRect bounds = region.boundingRect().intersected(imageRect);
+    if (bounds.isEmpty()) {
+        return tiles;
+    }
+    const int size = d->mTileSize;
+    for (int y = bounds.top() / size * size; y <= bounds.bottom(); y += size) {
+        for (int x = bounds.left() / size * size; x <= bounds.right(); x += size) {
+            const QRect tile = QRect(x, y, size, size).intersected(imageRect);
+            if (region.intersects(tile)) {
+                tiles << tile;
+            }
+        }
+    }
+    return tiles;
+}
+
 void ImageScaler::setDestinationRegion(const QRegion& region)
 {
     LOG(region);
@@ -105,8 +173,9 @@ void ImageScaler::setDestinationRegion(const QRegion& region)
 
 void ImageScaler::doScale()
 {
-    if (d->mZoom < Document::maxDownSampledZoom()) {
-        if (!d->mDocument->prepareDownSampledImageForZoom(d->mZoom)) {
+    const qreal sourceZoom = d->sourceZoom();
+    if (sourceZoom < Document::maxDownSampledZoom()) {
+        if (!d->mDocument->prepareDownSampledImageForZoom(sourceZoom)) {
             LOG("Asked for a down sampled image");
             return;
         }
@@ -117,26 +186,35 @@ void ImageScaler::doScale()
     }
 
     LOG("Starting");
-    Q_FOREACH(const QRect & rect, d->mRegion.rects()) {
-        LOG(rect);
-        scaleRect(rect);
+    if (d->mTileSize > 0) {
+        Q_FOREACH(const QRect & tile, tilesForRegion(d->mRegion)) {
+            LOG(tile);
+            scaleRect(tile);
+        }
+    } else {
+        Q_FOREACH(const QRect & rect, d->mRegion.rects()) {
+            LOG(rect);
+            scaleRect(rect);
+        }
     }
     LOG("Done");
 }
 
 void ImageScaler::scaleRect(const QRect& rect)
 {
+    GV_TRACE_SPAN("scaler", "ImageScaler::scaleRect");
     const qreal REAL_DELTA = 0.001;
-    if (qAbs(d->mZoom - 1.0) < REAL_DELTA) {
+    const qreal sourceZoom = d->sourceZoom();
+    if (qAbs(d->mZoom - 1.0) < REAL_DELTA && sourceZoom == d->mZoom) {
         QImage tmp = d->mDocument->image().copy(rect);
-        scaledRect(rect.left(), rect.top(), tmp);
+        emitScaledRect(rect, rect.left(), rect.top(), tmp);
         return;
     }
 
     QImage image;
     qreal zoom;
-    if (d->mZoom < Document::maxDownSampledZoom()) {
-        image = d->mDocument->downSampledImageForZoom(d->mZoom);
+    if (sourceZoom < Document::maxDownSampledZoom()) {
+        image = d->mDocument->downSampledImageForZoom(sourceZoom);
         Q_ASSERT(!image.isNull());
         qreal zoom1 = qreal(image.width()) / d->mDocument->width();
         zoom = d->mZoom / zoom1;
@@ -206,7 +284,16 @@ void ImageScaler::scaleRect(const QRect& rect)
               );
     }
 
-    emit scaledRect(destRect.left() + destLeftMargin, destRect.top() + destTopMargin, tmp);
+    emitScaledRect(rect, destRect.left() + destLeftMargin, destRect.top() + destTopMargin, tmp);
+}
+
+void ImageScaler::emitScaledRect(const QRect& rect, int left, int top, const QImage& image)
+{
+    if (d->mTileSize > 0) {
+        emit scaledTile(rect, left, top, image);
+    } else {
+        emit scaledRect(left, top, image);
+    }
 }
 
 } // namespace
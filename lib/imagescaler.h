@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 // Qt
 #include <QObject>
+#include <QVector>
 
 // KDE
 
@@ -51,12 +52,46 @@ public:
 
     void setTransformationMode(Qt::TransformationMode);
 
+    /**
+     * If @p size is greater than 0, the destination region is split into
+     * square tiles of @p size pixels, aligned on the zoomed image, and
+     * scaledTile() is emitted for each of them. This makes it possible to
+     * cache scaled tiles.
+     */
+    void setTileSize(int size);
+
+    /**
+     * Returns the tiles covering @p region, in zoomed image coordinates.
+     * Uses the current zoom and tile size.
+     */
+    QVector<QRect> tilesForRegion(const QRegion& region) const;
+
+    /**
+     * When set, the scaler does not load the full image if the zoom requires
+     * it, but scales up a down sampled image instead. Used to keep memory
+     * usage in check when many images are displayed.
+     */
+    void setPyramidFallback(bool);
+
+    /**
+     * Returns true if the scaler is currently scaling from a down sampled
+     * image because of setPyramidFallback()
+     */
+    bool usesPyramidFallback() const;
+
 Q_SIGNALS:
     void scaledRect(int left, int top, const QImage&);
 
+    /**
+     * Emitted instead of scaledRect() when a tile size has been set. @p tile
+     * is the requested tile.
+     */
+    void scaledTile(const QRect& tile, int left, int top, const QImage&);
+
 private:
     ImageScalerPrivate * const d;
     void scaleRect(const QRect&);
+    void emitScaledRect(const QRect& rect, int left, int top, const QImage&);
 
 private Q_SLOTS:
     void doScale();
@@ -214,6 +214,83 @@ bool JpegContent::load(const QString& path)
     return loadFromData(file.readAll());
 }
 
+bool JpegContent::loadHeader(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Could not open '" << path << "' for reading\n";
+        return false;
+    }
+    return loadHeader(&file);
+}
+
+bool JpegContent::loadHeader(QIODevice* device)
+{
+    d->mPendingTransformation = false;
+    d->mTransformMatrix.reset();
+    d->mImage = QImage();
+    d->mRawData.clear();
+    d->mComment.clear();
+    d->mExifData.clear();
+    d->mSize = QSize();
+
+    uchar soi[2];
+    if (device->read(reinterpret_cast<char*>(soi), 2) != 2 || soi[0] != 0xFF || soi[1] != 0xD8) {
+        return false;
+    }
+
+    // Walk the marker segments until the frame header, which contains the
+    // size. The EXIF data is in the APP1 segment, which comes before.
+    Q_FOREVER {
+        uchar header[4];
+        if (device->read(reinterpret_cast<char*>(header), 4) != 4 || header[0] != 0xFF) {
+            return false;
+        }
+        const uchar marker = header[1];
+        const int length = ((header[2] << 8) | header[3]) - 2;
+        if (length < 0 || marker == 0xDA /* SOS */ || marker == 0xD9 /* EOI */) {
+            return false;
+        }
+
+        // SOF0 to SOF15, except DHT, JPG and DAC which use the same range
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            const QByteArray data = device->read(length);
+            if (data.size() < 5) {
+                return false;
+            }
+            const uchar* frame = reinterpret_cast<const uchar*>(data.constData());
+            d->mSize = QSize((frame[3] << 8) | frame[4], (frame[1] << 8) | frame[2]);
+            break;
+        }
+
+        if (marker == 0xE1 /* APP1 */ && d->mExifData.empty()) {
+            const QByteArray data = device->read(length);
+            if (data.size() != length) {
+                return false;
+            }
+            const QByteArray exifHeader("Exif\0\0", 6);
+            if (data.startsWith(exifHeader)) {
+                try {
+                    Exiv2::ExifParser::decode(d->mExifData,
+                                              reinterpret_cast<const Exiv2::byte*>(data.constData()) + exifHeader.size(),
+                                              data.size() - exifHeader.size());
+                } catch (const Exiv2::Error& error) {
+                    qWarning() << "Could not decode EXIF data:" << error.what();
+                    d->mExifData.clear();
+                }
+            }
+            continue;
+        }
+
+        if (!device->seek(device->pos() + length)) {
+            return false;
+        }
+    }
+
+    adjustSizeToOrientation();
+    return true;
+}
+
 bool JpegContent::loadFromData(const QByteArray& data)
 {
     Exiv2::Image::AutoPtr image;
@@ -242,11 +319,16 @@ bool JpegContent::loadFromData(const QByteArray& data, Exiv2::Image* exiv2Image)
     d->mExifData = exiv2Image->exifData();
     d->mComment = QString::fromUtf8(exiv2Image->comment().c_str());
 
+    adjustSizeToOrientation();
+    return true;
+}
+
+void JpegContent::adjustSizeToOrientation()
+{
     if (!GwenviewConfig::applyExifOrientation()) {
-        return true;
+        return;
     }
 
-    // Adjust the size according to the orientation
     switch (orientation()) {
     case TRANSPOSE:
     case ROT_90:
@@ -257,8 +339,6 @@ bool JpegContent::loadFromData(const QByteArray& data, Exiv2::Image* exiv2Image)
     default:
         break;
     }
-
-    return true;
 }
 
 QByteArray JpegContent::rawData() const
@@ -65,6 +65,16 @@ public:
     void setImage(const QImage& image);
 
     bool load(const QString& file);
+
+    /**
+     * Reads only the start of @p file, up to the frame header, to get the
+     * size, the orientation and the embedded thumbnail. Much faster than
+     * load() for big files or on network storage, but the content cannot be
+     * transformed nor saved afterwards: rawData() is empty and comment() is
+     * not loaded.
+     */
+    bool loadHeader(const QString& file);
+    bool loadHeader(QIODevice* device);
     bool loadFromData(const QByteArray& rawData);
     /**
      * Use this version of loadFromData if you already have an Exiv2::Image*
@@ -84,6 +94,7 @@ private:
     JpegContent(const JpegContent&);
     void operator=(const JpegContent&);
     void applyPendingTransformation();
+    void adjustSizeToOrientation();
     int dotsPerMeter(const QString& keyName) const;
 };
 
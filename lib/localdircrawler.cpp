@@ -0,0 +1,764 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+// Self
+#include "localdircrawler.h"
+
+#include <sys/stat.h>
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+// Qt
+#include <QAtomicInt>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMimeDatabase>
+#include <QMimeType>
+#include <QMutex>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <QVector>
+#include <QWaitCondition>
+
+// KDE
+#include <KDirWatch>
+#include <KIO/UDSEntry>
+
+namespace Gwenview
+{
+
+#undef ENABLE_LOG
+#undef LOG
+//#define ENABLE_LOG
+#ifdef ENABLE_LOG
+#define LOG(x) qDebug() << x
+#else
+#define LOG(x) ;
+#endif
+
+// Listing is mostly waiting for the disk: more threads than that do not help
+static const int MAX_THREAD_COUNT = 8;
+
+// How many items a thread reads before handing them to the main thread
+static const int BATCH_SIZE = 500;
+
+// How long to wait for more changes before reading a dirty dir again, in ms.
+// Copying many files to a dir makes it dirty many times in a row.
+static const int DIRTY_DELAY = 200;
+
+static QString joinPath(const QString& dir, const QString& name)
+{
+    return dir.endsWith('/') ? dir + name : dir + '/' + name;
+}
+
+#ifdef Q_OS_UNIX
+/**
+ * Reads the entries of a dir. On Linux it uses getdents64 directly, to get
+ * many entries per system call.
+ */
+class DirReader
+{
+public:
+    DirReader(const QString& path)
+    : mFd(::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+#ifdef Q_OS_LINUX
+    , mBufferSize(0)
+    , mBufferPos(0)
+#else
+    , mDir(0)
+#endif
+    {
+#ifndef Q_OS_LINUX
+        if (mFd >= 0) {
+            // mDir takes ownership of mFd
+            mDir = fdopendir(mFd);
+            if (!mDir) {
+                ::close(mFd);
+                mFd = -1;
+            }
+        }
+#endif
+    }
+
+    ~DirReader()
+    {
+#ifdef Q_OS_LINUX
+        if (mFd >= 0) {
+            ::close(mFd);
+        }
+#else
+        if (mDir) {
+            closedir(mDir);
+        }
+#endif
+    }
+
+    bool isOpen() const
+    {
+        return mFd >= 0;
+    }
+
+    int fd() const
+    {
+        return mFd;
+    }
+
+    /**
+     * Reads the next entry. @p type is set to one of the DT_* values.
+     * Returns false at the end of the dir.
+     */
+    bool next(const char** name, unsigned char* type)
+    {
+#ifdef Q_OS_LINUX
+        if (mFd < 0) {
+            return false;
+        }
+        if (mBufferPos >= mBufferSize) {
+            const long size = syscall(SYS_getdents64, mFd, mBuffer, sizeof(mBuffer));
+            if (size <= 0) {
+                return false;
+            }
+            mBufferSize = size;
+            mBufferPos = 0;
+        }
+        const char* data = reinterpret_cast<const char*>(mBuffer) + mBufferPos;
+        const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(data);
+        mBufferPos += entry->d_reclen;
+        *name = entry->d_name;
+        *type = entry->d_type;
+        return true;
+#else
+        if (!mDir) {
+            return false;
+        }
+        const struct dirent* entry = readdir(mDir);
+        if (!entry) {
+            return false;
+        }
+        *name = entry->d_name;
+        *type = entry->d_type;
+        return true;
+#endif
+    }
+
+private:
+    int mFd;
+#ifdef Q_OS_LINUX
+    // From the getdents64 man page: glibc only provides a wrapper since 2.30
+    struct LinuxDirent64
+    {
+        quint64 d_ino;
+        qint64 d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+    // quint64 to get the alignment getdents64 expects
+    quint64 mBuffer[4096];
+    long mBufferSize;
+    long mBufferPos;
+#else
+    DIR* mDir;
+#endif
+};
+
+struct StatResult
+{
+    mode_t mMode;
+    qint64 mSize;
+    qint64 mModificationTime;
+};
+
+static bool statAt(int dirFd, const char* name, bool followSymlinks, StatResult* result)
+{
+#if defined(Q_OS_LINUX) && defined(STATX_BASIC_STATS)
+    struct statx buf;
+    const int flags = AT_STATX_SYNC_AS_STAT | (followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW);
+    if (statx(dirFd, name, flags, STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME, &buf) != 0) {
+        return false;
+    }
+    result->mMode = buf.stx_mode;
+    result->mSize = buf.stx_size;
+    result->mModificationTime = buf.stx_mtime.tv_sec;
+#else
+    struct stat buf;
+    if (fstatat(dirFd, name, &buf, followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    result->mMode = buf.st_mode;
+    result->mSize = buf.st_size;
+    result->mModificationTime = buf.st_mtime;
+#endif
+    return true;
+}
+
+enum EntryKind {
+    EntrySkipped,
+    EntryFile,
+    EntryDir
+};
+
+/**
+ * Finds out the kind of entry @p name. If it is a file, fills @p entry with
+ * its metadata. Symlinks to files are followed, symlinks to dirs are not, to
+ * avoid loops.
+ */
+static EntryKind statEntry(int dirFd, const char* name, unsigned char type, KIO::UDSEntry* entry)
+{
+    StatResult result;
+    if (type == DT_DIR) {
+        return EntryDir;
+    } else if (type == DT_UNKNOWN) {
+        // Some file systems do not fill d_type
+        if (!statAt(dirFd, name, false /* followSymlinks */, &result)) {
+            return EntrySkipped;
+        }
+        if (S_ISDIR(result.mMode)) {
+            return EntryDir;
+        }
+        if (S_ISLNK(result.mMode)) {
+            type = DT_LNK;
+        } else if (!S_ISREG(result.mMode)) {
+            return EntrySkipped;
+        }
+    } else if (type != DT_REG && type != DT_LNK) {
+        return EntrySkipped;
+    }
+    if (type == DT_LNK || type == DT_REG) {
+        if (!statAt(dirFd, name, true /* followSymlinks */, &result)) {
+            return EntrySkipped;
+        }
+        if (!S_ISREG(result.mMode)) {
+            return EntrySkipped;
+        }
+    }
+    entry->insert(KIO::UDSEntry::UDS_FILE_TYPE, qint64(result.mMode & S_IFMT));
+    entry->insert(KIO::UDSEntry::UDS_ACCESS, qint64(result.mMode & 07777));
+    entry->insert(KIO::UDSEntry::UDS_SIZE, result.mSize);
+    entry->insert(KIO::UDSEntry::UDS_MODIFICATION_TIME, result.mModificationTime);
+    return EntryFile;
+}
+#endif
+
+/**
+ * The content of a dir, or part of it for big dirs
+ */
+struct DirBatch
+{
+    QString mPath;
+    QStringList mFileNames;
+    QStringList mSubDirNames;
+    KFileItemList mItems;
+};
+
+/**
+ * State shared by the threads of a listing
+ */
+struct CrawlState
+{
+    CrawlState(LocalDirCrawler* crawler)
+    : mCrawler(crawler)
+    , mBusyCount(0)
+    , mActiveWorkerCount(0)
+    , mFlushScheduled(false)
+    , mFinished(false)
+    {}
+
+    LocalDirCrawler* const mCrawler;
+    QAtomicInt mCancelled;
+
+    QMutex mMutex;
+    QWaitCondition mQueueCondition;
+    // Dirs waiting to be read
+    QStringList mQueue;
+    // Workers reading a dir, which may queue more dirs
+    int mBusyCount;
+    // Workers which have not left yet
+    int mActiveWorkerCount;
+    // Batches waiting for the main thread
+    QVector<DirBatch> mBatches;
+    // Dirty dirs which have been read again, waiting for the main thread
+    QVector<DirBatch> mRescans;
+    // Dirty dirs which could not be read again
+    QStringList mFailedRescans;
+    bool mFlushScheduled;
+    bool mFinished;
+
+    /**
+     * Hands @p batch to the main thread and queues its subdirs.
+     * Must be called with mMutex locked.
+     */
+    void push(const DirBatch& batch)
+    {
+        Q_FOREACH(const QString& name, batch.mSubDirNames) {
+            mQueue << joinPath(batch.mPath, name);
+        }
+        if (!batch.mSubDirNames.isEmpty()) {
+            mQueueCondition.wakeAll();
+        }
+        mBatches << batch;
+        scheduleFlush();
+    }
+
+    void scheduleFlush()
+    {
+        if (!mFlushScheduled) {
+            mFlushScheduled = true;
+            QMetaObject::invokeMethod(mCrawler, "flush", Qt::QueuedConnection);
+        }
+    }
+};
+
+/**
+ * Reads the dir @p path into @p batch. If @p state is set, batches of
+ * BATCH_SIZE items are pushed to it while reading. Returns false if the dir
+ * could not be read.
+ */
+static bool readDir(const QString& path, const QMimeDatabase& mimeDb, DirBatch* batch, CrawlState* state)
+{
+#ifdef Q_OS_UNIX
+    DirReader reader(path);
+    if (!reader.isOpen()) {
+        LOG("Could not open" << path);
+        return false;
+    }
+    const QUrl dirUrl = QUrl::fromLocalFile(path);
+    batch->mPath = path;
+    const char* name;
+    unsigned char type;
+    while (reader.next(&name, &type)) {
+        // Skips "." and ".." as well as hidden entries
+        if (name[0] == '.') {
+            continue;
+        }
+        if (state && state->mCancelled.load()) {
+            return false;
+        }
+        KIO::UDSEntry entry;
+        const EntryKind kind = statEntry(reader.fd(), name, type, &entry);
+        if (kind == EntryDir) {
+            batch->mSubDirNames << QFile::decodeName(name);
+        } else if (kind == EntryFile) {
+            const QString fileName = QFile::decodeName(name);
+            entry.insert(KIO::UDSEntry::UDS_NAME, fileName);
+            // If the extension is not enough, KFileItem looks at the content
+            // when the mime type is needed
+            const QList<QMimeType> mimeTypes = mimeDb.mimeTypesForFileName(fileName);
+            if (mimeTypes.count() == 1) {
+                entry.insert(KIO::UDSEntry::UDS_MIME_TYPE, mimeTypes.first().name());
+            }
+            batch->mFileNames << fileName;
+            batch->mItems << KFileItem(entry, dirUrl, true /* delayedMimeTypes */, true /* urlIsDirectory */);
+
+            if (state && batch->mItems.count() >= BATCH_SIZE) {
+                QMutexLocker locker(&state->mMutex);
+                state->push(*batch);
+                locker.unlock();
+                *batch = DirBatch();
+                batch->mPath = path;
+            }
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(mimeDb);
+    Q_UNUSED(batch);
+    Q_UNUSED(state);
+    return false;
+#endif
+}
+
+class CrawlRunnable : public QRunnable
+{
+public:
+    CrawlRunnable(const QSharedPointer<CrawlState>& state)
+    : mState(state)
+    {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        QMimeDatabase mimeDb;
+        QMutexLocker locker(&mState->mMutex);
+        for (;;) {
+            while (mState->mQueue.isEmpty() && mState->mBusyCount > 0 && !mState->mCancelled.load()) {
+                mState->mQueueCondition.wait(&mState->mMutex);
+            }
+            if (mState->mQueue.isEmpty() || mState->mCancelled.load()) {
+                break;
+            }
+            const QString path = mState->mQueue.takeLast();
+            ++mState->mBusyCount;
+            locker.unlock();
+
+            DirBatch batch;
+            const bool ok = readDir(path, mimeDb, &batch, mState.data());
+
+            locker.relock();
+            if (ok) {
+                // Always push the last batch, even if empty: the main thread
+                // needs to know the dir has been read to watch it
+                mState->push(batch);
+            }
+            --mState->mBusyCount;
+            mState->mQueueCondition.wakeAll();
+        }
+        --mState->mActiveWorkerCount;
+        if (mState->mActiveWorkerCount == 0) {
+            mState->mFinished = true;
+            mState->scheduleFlush();
+        }
+    }
+
+private:
+    QSharedPointer<CrawlState> mState;
+};
+
+/**
+ * Reads a dirty dir again
+ */
+class RescanRunnable : public QRunnable
+{
+public:
+    RescanRunnable(const QSharedPointer<CrawlState>& state, const QString& path)
+    : mState(state)
+    , mPath(path)
+    {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (mState->mCancelled.load()) {
+            return;
+        }
+        QMimeDatabase mimeDb;
+        DirBatch batch;
+        const bool ok = readDir(mPath, mimeDb, &batch, 0);
+
+        QMutexLocker locker(&mState->mMutex);
+        if (ok) {
+            mState->mRescans << batch;
+        } else {
+            mState->mFailedRescans << mPath;
+        }
+        mState->scheduleFlush();
+    }
+
+private:
+    QSharedPointer<CrawlState> mState;
+    QString mPath;
+};
+
+struct DirContent
+{
+    QSet<QString> mFileNames;
+    QSet<QString> mSubDirNames;
+};
+
+struct LocalDirCrawlerPrivate
+{
+    LocalDirCrawler* q;
+    QThreadPool mThreadPool;
+    QSharedPointer<CrawlState> mState;
+    QUrl mRootUrl;
+    QScopedPointer<KDirWatch> mDirWatch;
+    // Content of the dirs which have been read, by path
+    QHash<QString, DirContent> mDirs;
+    bool mRunning;
+    // Dirs which changed and have not been read again yet
+    QSet<QString> mDirtyPaths;
+    // Dirs being read again by a RescanRunnable
+    QSet<QString> mRescanningPaths;
+    QTimer mDirtyTimer;
+
+    void resetDirWatch()
+    {
+        mDirWatch.reset(new KDirWatch);
+        QObject::connect(mDirWatch.data(), &KDirWatch::dirty, q, &LocalDirCrawler::slotDirty);
+        QObject::connect(mDirWatch.data(), &KDirWatch::deleted, q, &LocalDirCrawler::slotDirty);
+    }
+
+    void crawl(const QStringList& paths)
+    {
+        if (!mState) {
+            mState.reset(new CrawlState(q));
+        }
+        QMutexLocker locker(&mState->mMutex);
+        mState->mQueue << paths;
+        mRunning = true;
+        if (mState->mActiveWorkerCount > 0) {
+            mState->mQueueCondition.wakeAll();
+            return;
+        }
+        mState->mFinished = false;
+        const int count = mThreadPool.maxThreadCount();
+        // Count the workers now, so that the first one to be done does not
+        // finish the listing before the others have started
+        mState->mActiveWorkerCount = count;
+        for (int idx = 0; idx < count; ++idx) {
+            mThreadPool.start(new CrawlRunnable(mState));
+        }
+    }
+
+    /**
+     * Forgets about dir @p path and its subdirs, and adds their files to
+     * @p deletedItems
+     */
+    void removeDir(const QString& path, KFileItemList* deletedItems)
+    {
+        if (!mDirs.contains(path)) {
+            return;
+        }
+        const DirContent content = mDirs.take(path);
+        mDirWatch->removeDir(path);
+        Q_FOREACH(const QString& name, content.mFileNames) {
+            deletedItems->append(deletedItem(joinPath(path, name)));
+        }
+        Q_FOREACH(const QString& name, content.mSubDirNames) {
+            removeDir(joinPath(path, name), deletedItems);
+        }
+    }
+
+    /**
+     * Compares the new content of the dirty dir @p batch.mPath with the old
+     * one. Adds files which are gone to @p deletedItems, new files to
+     * @p addedItems and new subdirs to @p newDirs.
+     */
+    void applyRescan(const DirBatch& batch, KFileItemList* deletedItems, KFileItemList* addedItems, QStringList* newDirs)
+    {
+        const QString& path = batch.mPath;
+        const DirContent oldContent = mDirs.value(path);
+        DirContent content;
+        content.mFileNames = batch.mFileNames.toSet();
+        content.mSubDirNames = batch.mSubDirNames.toSet();
+        mDirs[path] = content;
+
+        Q_FOREACH(const QString& name, oldContent.mFileNames) {
+            if (!content.mFileNames.contains(name)) {
+                deletedItems->append(deletedItem(joinPath(path, name)));
+            }
+        }
+        Q_FOREACH(const QString& name, oldContent.mSubDirNames) {
+            if (!content.mSubDirNames.contains(name)) {
+                removeDir(joinPath(path, name), deletedItems);
+            }
+        }
+
+        for (int idx = 0; idx < batch.mItems.count(); ++idx) {
+            if (!oldContent.mFileNames.contains(batch.mFileNames.at(idx))) {
+                addedItems->append(batch.mItems.at(idx));
+            }
+        }
+        Q_FOREACH(const QString& name, content.mSubDirNames) {
+            if (!oldContent.mSubDirNames.contains(name)) {
+                newDirs->append(joinPath(path, name));
+            }
+        }
+    }
+
+    static KFileItem deletedItem(const QString& path)
+    {
+        // Pass the mode, so that KFileItem does not try to stat a file which
+        // is gone
+        return KFileItem(QUrl::fromLocalFile(path), QString(), S_IFREG);
+    }
+};
+
+LocalDirCrawler::LocalDirCrawler(QObject* parent)
+: QObject(parent)
+, d(new LocalDirCrawlerPrivate)
+{
+    d->q = this;
+    d->mRunning = false;
+    d->mThreadPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), MAX_THREAD_COUNT));
+    d->mDirtyTimer.setInterval(DIRTY_DELAY);
+    d->mDirtyTimer.setSingleShot(true);
+    connect(&d->mDirtyTimer, &QTimer::timeout, this, &LocalDirCrawler::rescanDirtyDirs);
+    d->resetDirWatch();
+}
+
+LocalDirCrawler::~LocalDirCrawler()
+{
+    stop();
+    delete d;
+}
+
+bool LocalDirCrawler::canList(const QUrl& url)
+{
+#ifdef Q_OS_UNIX
+    return url.isLocalFile();
+#else
+    Q_UNUSED(url);
+    return false;
+#endif
+}
+
+void LocalDirCrawler::start(const QString& path)
+{
+    stop();
+    const QString cleanPath = QDir::cleanPath(path);
+    LOG(cleanPath);
+    d->mRootUrl = QUrl::fromLocalFile(cleanPath);
+    d->crawl(QStringList() << cleanPath);
+}
+
+void LocalDirCrawler::stop()
+{
+    if (d->mState) {
+        d->mState->mCancelled.store(1);
+        {
+            QMutexLocker locker(&d->mState->mMutex);
+            d->mState->mQueueCondition.wakeAll();
+        }
+        d->mThreadPool.waitForDone();
+        d->mState.clear();
+    }
+    d->mRunning = false;
+    d->mDirtyTimer.stop();
+    d->mDirtyPaths.clear();
+    d->mRescanningPaths.clear();
+    if (!d->mDirs.isEmpty()) {
+        d->mDirs.clear();
+        d->resetDirWatch();
+    }
+}
+
+bool LocalDirCrawler::isRunning() const
+{
+    return d->mRunning;
+}
+
+void LocalDirCrawler::flush()
+{
+    if (!d->mState) {
+        return;
+    }
+    QVector<DirBatch> batches;
+    QVector<DirBatch> rescans;
+    QStringList failedRescans;
+    bool finished;
+    {
+        QMutexLocker locker(&d->mState->mMutex);
+        batches.swap(d->mState->mBatches);
+        rescans.swap(d->mState->mRescans);
+        failedRescans.swap(d->mState->mFailedRescans);
+        d->mState->mFlushScheduled = false;
+        finished = d->mState->mFinished;
+        d->mState->mFinished = false;
+    }
+
+    KFileItemList items;
+    Q_FOREACH(const DirBatch& batch, batches) {
+        if (!d->mDirs.contains(batch.mPath)) {
+            d->mDirWatch->addDir(batch.mPath);
+        }
+        DirContent& content = d->mDirs[batch.mPath];
+        Q_FOREACH(const QString& name, batch.mFileNames) {
+            content.mFileNames << name;
+        }
+        Q_FOREACH(const QString& name, batch.mSubDirNames) {
+            content.mSubDirNames << name;
+        }
+        items << batch.mItems;
+    }
+
+    KFileItemList deletedItems;
+    QStringList newDirs;
+    Q_FOREACH(const QString& path, failedRescans) {
+        d->mRescanningPaths.remove(path);
+        d->removeDir(path, &deletedItems);
+    }
+    Q_FOREACH(const DirBatch& batch, rescans) {
+        d->mRescanningPaths.remove(batch.mPath);
+        // The dir may have been removed with its parent in the meantime
+        if (d->mDirs.contains(batch.mPath)) {
+            d->applyRescan(batch, &deletedItems, &items, &newDirs);
+        }
+    }
+    if (!d->mDirtyPaths.isEmpty() && !d->mDirtyTimer.isActive()) {
+        // Dirs which changed again while they were being read
+        d->mDirtyTimer.start();
+    }
+
+    LOG(batches.count() << "batches," << rescans.count() << "rescans," << items.count() << "items, finished:" << finished);
+    if (!deletedItems.isEmpty()) {
+        emit itemsDeleted(deletedItems);
+    }
+    if (!items.isEmpty()) {
+        emit itemsAdded(d->mRootUrl, items);
+    }
+    if (!newDirs.isEmpty()) {
+        d->crawl(newDirs);
+    }
+    if (finished) {
+        d->mRunning = false;
+        emit completed();
+    }
+}
+
+void LocalDirCrawler::slotDirty(const QString& path)
+{
+    if (!d->mDirs.contains(path)) {
+        return;
+    }
+    LOG(path);
+    d->mDirtyPaths << path;
+    if (!d->mDirtyTimer.isActive()) {
+        d->mDirtyTimer.start();
+    }
+}
+
+void LocalDirCrawler::rescanDirtyDirs()
+{
+    if (!d->mState) {
+        return;
+    }
+    QSet<QString>::Iterator it = d->mDirtyPaths.begin();
+    while (it != d->mDirtyPaths.end()) {
+        const QString path = *it;
+        if (d->mRescanningPaths.contains(path)) {
+            // Read it again once the current read is done, as it may have
+            // missed the last changes
+            ++it;
+            continue;
+        }
+        it = d->mDirtyPaths.erase(it);
+        if (!d->mDirs.contains(path)) {
+            continue;
+        }
+        d->mRescanningPaths << path;
+        d->mThreadPool.start(new RescanRunnable(d->mState, path));
+    }
+}
+
+} // namespace
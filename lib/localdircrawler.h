@@ -0,0 +1,96 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#ifndef LOCALDIRCRAWLER_H
+#define LOCALDIRCRAWLER_H
+
+// Local
+#include <lib/gwenviewlib_export.h>
+
+// KDE
+#include <KFileItem>
+
+// Qt
+#include <QObject>
+
+class QUrl;
+
+namespace Gwenview
+{
+
+struct LocalDirCrawlerPrivate;
+/**
+ * Recursively lists the files of a local dir, without going through KIO.
+ *
+ * Dirs are read on several threads, file types are guessed from file
+ * extensions and the resulting items are reported in batches. Once listed,
+ * dirs are watched so that added and deleted files are reported too: changed
+ * dirs are read again on the listing threads, shortly after their last
+ * change.
+ *
+ * Hidden files and dirs are skipped, and symlinks to dirs are not followed.
+ */
+class GWENVIEWLIB_EXPORT LocalDirCrawler : public QObject
+{
+    Q_OBJECT
+public:
+    LocalDirCrawler(QObject* parent = 0);
+    ~LocalDirCrawler();
+
+    /**
+     * Returns true if @p url can be listed by LocalDirCrawler
+     */
+    static bool canList(const QUrl& url);
+
+    /**
+     * Starts listing @p path, stopping any previous listing
+     */
+    void start(const QString& path);
+
+    void stop();
+
+    bool isRunning() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when new files have been found in @p rootUrl or its subdirs
+     */
+    void itemsAdded(const QUrl& rootUrl, const KFileItemList&);
+
+    void itemsDeleted(const KFileItemList&);
+
+    /**
+     * Emitted when all dirs have been listed
+     */
+    void completed();
+
+private Q_SLOTS:
+    void flush();
+    void slotDirty(const QString& path);
+    void rescanDirtyDirs();
+
+private:
+    LocalDirCrawlerPrivate* const d;
+    friend struct LocalDirCrawlerPrivate;
+};
+
+} // namespace
+
+#endif /* LOCALDIRCRAWLER_H */
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 
 // Local
 #include <lib/gvdebug.h>
+#include <lib/localdircrawler.h>
 
 // KDE
 #include <KDirLister>
@@ -31,33 +32,83 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 // Qt
 #include <QDebug>
 
+// std
+#include <algorithm>
+
 namespace Gwenview
 {
 
 struct RecursiveDirModelPrivate {
+    RecursiveDirModelPrivate()
+    : mDirLister(0)
+    , mCrawler(0)
+    , mGapStart(0)
+    , mGapSize(0)
+    , mRebuildStart(-1)
+    {}
+
     KDirLister* mDirLister;
+    // Used instead of mDirLister for local urls
+    LocalDirCrawler* mCrawler;
+    QUrl mUrl;
 
     int rowForUrl(const QUrl &url) const
     {
         return mRowForUrl.value(url, -1);
     }
 
-    void removeAt(int row)
+    /**
+     * Removes rows first to last. While removing several ranges, they must
+     * be removed in ascending order, using rows as they are after the
+     * previous removals, then finishRemoval() must be called.
+     *
+     * Removed items leave a gap in mList, which moves forward as ranges are
+     * removed, so that each item is moved at most once during the whole
+     * batch. count() and at() skip the gap.
+     */
+    void removeRange(int first, int last)
+    {
+        Q_ASSERT(first >= mGapStart);
+        // Move the items before the range to the start of the gap
+        if (mGapSize > 0) {
+            for (int row = mGapStart; row < first; ++row) {
+                mList.swap(row, row + mGapSize);
+            }
+        }
+        mGapStart = first;
+        for (int row = first; row <= last; ++row) {
+            KFileItem& item = mList[row + mGapSize];
+            mRowForUrl.remove(item.url());
+            item = KFileItem();
+        }
+        mGapSize += last - first + 1;
+        if (mRebuildStart == -1) {
+            mRebuildStart = first;
+        }
+    }
+
+    void finishRemoval()
     {
-        KFileItem item = mList.takeAt(row);
-        mRowForUrl.remove(item.url());
-
-        // Decrease row value for all urls after the one we removed
-        // ("row" now points to the item after the one we removed since we used takeAt)
-        const int count = mList.count();
-        for (; row < count; ++row) {
-            QUrl url = mList.at(row).url();
-            mRowForUrl[url]--;
+        if (mGapSize == 0) {
+            return;
         }
+        const int newCount = count();
+        for (int row = mGapStart; row < newCount; ++row) {
+            mList.swap(row, row + mGapSize);
+        }
+        mList.erase(mList.begin() + newCount, mList.end());
+        mGapStart = 0;
+        mGapSize = 0;
+
+        for (int row = mRebuildStart; row < newCount; ++row) {
+            mRowForUrl[mList.at(row).url()] = row;
+        }
+        mRebuildStart = -1;
     }
 
     void addItem(const KFileItem& item)
     {
+        Q_ASSERT(mGapSize == 0);
         mRowForUrl.insert(item.url(), mList.count());
         mList.append(item);
     }
@@ -66,23 +117,47 @@ struct RecursiveDirModelPrivate {
     {
         mRowForUrl.clear();
         mList.clear();
+        mGapStart = 0;
+        mGapSize = 0;
+        mRebuildStart = -1;
     }
 
-    // RecursiveDirModel can only access mList through this read-only getter.
+    // RecursiveDirModel can only access mList through these read-only getters.
     // This ensures it cannot introduce inconsistencies between mList and mRowForUrl.
-    const KFileItemList& list() const
+    int count() const
     {
-        return mList;
+        return mList.count() - mGapSize;
+    }
+
+    KFileItem at(int row) const
+    {
+        if (row < 0 || row >= count()) {
+            return KFileItem();
+        }
+        return mList.at(row < mGapStart ? row : row + mGapSize);
     }
 
 private:
     KFileItemList mList;
     QHash<QUrl, int> mRowForUrl;
+    int mGapStart;
+    int mGapSize;
+    // First row whose entry in mRowForUrl is out of date
+    int mRebuildStart;
 };
 
 RecursiveDirModel::RecursiveDirModel(QObject* parent)
 : QAbstractListModel(parent)
 , d(new RecursiveDirModelPrivate)
+{
+    createDirLister();
+    d->mCrawler = new LocalDirCrawler(this);
+    connect(d->mCrawler, &LocalDirCrawler::itemsAdded, this, &RecursiveDirModel::slotItemsAdded);
+    connect(d->mCrawler, &LocalDirCrawler::itemsDeleted, this, &RecursiveDirModel::slotItemsDeleted);
+    connect(d->mCrawler, &LocalDirCrawler::completed, this, &RecursiveDirModel::completed);
+}
+
+void RecursiveDirModel::createDirLister()
 {
     d->mDirLister = new KDirLister(this);
     connect(d->mDirLister, &KDirLister::itemsAdded, this, &RecursiveDirModel::slotItemsAdded);
@@ -99,7 +174,7 @@ RecursiveDirModel::~RecursiveDirModel()
 
 QUrl RecursiveDirModel::url() const
 {
-    return d->mDirLister->url();
+    return d->mUrl;
 }
 
 void RecursiveDirModel::setUrl(const QUrl &url)
@@ -107,7 +182,19 @@ void RecursiveDirModel::setUrl(const QUrl &url)
     beginResetModel();
     d->clear();
     endResetModel();
-    d->mDirLister->openUrl(url);
+    d->mUrl = url;
+    if (LocalDirCrawler::canList(url)) {
+        if (!d->mDirLister->url().isEmpty()) {
+            // Replace the dir lister, so that it stops watching the dirs it
+            // listed
+            delete d->mDirLister;
+            createDirLister();
+        }
+        d->mCrawler->start(url.toLocalFile());
+    } else {
+        d->mCrawler->stop();
+        d->mDirLister->openUrl(url);
+    }
 }
 
 int RecursiveDirModel::rowCount(const QModelIndex& parent) const
@@ -115,7 +202,7 @@ int RecursiveDirModel::rowCount(const QModelIndex& parent) const
     if (parent.isValid()) {
         return 0;
     } else {
-        return d->list().count();
+        return d->count();
     }
 }
 
@@ -124,7 +211,7 @@ QVariant RecursiveDirModel::data(const QModelIndex& index, int role) const
     if (index.parent().isValid()) {
         return QVariant();
     }
-    KFileItem item = d->list().value(index.row());
+    KFileItem item = d->at(index.row());
     if (item.isNull()) {
         qWarning() << "Invalid row" << index.row();
         return QVariant();
@@ -158,7 +245,7 @@ void RecursiveDirModel::slotItemsAdded(const QUrl&, const KFileItemList& newList
     }
 
     if (!fileList.isEmpty()) {
-        beginInsertRows(QModelIndex(), d->list().count(), d->list().count() + fileList.count());
+        beginInsertRows(QModelIndex(), d->count(), d->count() + fileList.count());
         Q_FOREACH(const KFileItem& item, fileList) {
             d->addItem(item);
         }
@@ -172,6 +259,7 @@ void RecursiveDirModel::slotItemsAdded(const QUrl&, const KFileItemList& newList
 
 void RecursiveDirModel::slotItemsDeleted(const KFileItemList& list)
 {
+    QVector<int> rows;
     Q_FOREACH(const KFileItem& item, list) {
         if (item.isDir()) {
             continue;
@@ -182,15 +270,34 @@ void RecursiveDirModel::slotItemsDeleted(const KFileItemList& list)
             GV_FATAL_FAILS;
             continue;
         }
-        beginRemoveRows(QModelIndex(), row, row);
-        d->removeAt(row);
+        rows << row;
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    removeSortedRows(rows);
+}
+
+void RecursiveDirModel::removeSortedRows(const QVector<int>& rows)
+{
+    // Rows in each range are shifted by the rows removed before it
+    int removedCount = 0;
+    for (int idx = 0; idx < rows.count();) {
+        const int first = rows.at(idx);
+        int last = first;
+        for (++idx; idx < rows.count() && rows.at(idx) == last + 1; ++idx) {
+            ++last;
+        }
+        beginRemoveRows(QModelIndex(), first - removedCount, last - removedCount);
+        d->removeRange(first - removedCount, last - removedCount);
         endRemoveRows();
+        removedCount += last - first + 1;
     }
+    d->finishRemoval();
 }
 
 void RecursiveDirModel::slotCleared()
 {
-    if (d->list().isEmpty()) {
+    if (d->count() == 0) {
         return;
     }
     beginResetModel();
@@ -200,15 +307,14 @@ void RecursiveDirModel::slotCleared()
 
 void RecursiveDirModel::slotDirCleared(const QUrl &dirUrl)
 {
-    int row;
-    for (row = d->list().count() - 1; row >= 0; --row) {
-        const QUrl url = d->list().at(row).url();
-        if (dirUrl.isParentOf(url)) {
-            beginRemoveRows(QModelIndex(), row, row);
-            d->removeAt(row);
-            endRemoveRows();
+    QVector<int> rows;
+    const int count = d->count();
+    for (int row = 0; row < count; ++row) {
+        if (dirUrl.isParentOf(d->at(row).url())) {
+            rows << row;
         }
     }
+    removeSortedRows(rows);
 }
 
 } // namespace
@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 
 // Qt
 #include <QAbstractListModel>
+#include <QVector>
 
 class QUrl;
 
@@ -37,7 +38,8 @@ namespace Gwenview
 
 struct RecursiveDirModelPrivate;
 /**
- * Recursively list content of a dir
+ * Recursively list content of a dir. Local dirs are listed with
+ * LocalDirCrawler, other dirs with KDirLister.
  */
 class GWENVIEWLIB_EXPORT RecursiveDirModel : public QAbstractListModel
 {
@@ -61,6 +63,14 @@ private Q_SLOTS:
     void slotDirCleared(const QUrl&);
     void slotCleared();
 private:
+    void createDirLister();
+
+    /**
+     * Removes @p rows, which must be sorted and unique, emitting one
+     * rowsRemoved() signal per range of consecutive rows
+     */
+    void removeSortedRows(const QVector<int>& rows);
+
     RecursiveDirModelPrivate* const d;
 };
 
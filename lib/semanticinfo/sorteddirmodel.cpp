@@ -21,13 +21,18 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <config-gwenview.h>
 
 // Qt
+#include <QCollator>
+#include <QFutureWatcher>
+#include <QSet>
 #include <QTimer>
+#include <QtConcurrent>
 #include <QDebug>
 #include <QUrl>
 
 // KDE
+#include <KConfigGroup>
 #include <KDirLister>
-
+#include <KSharedConfig>
 
 // Local
 #include <lib/archiveutils.h>
@@ -58,8 +63,43 @@ AbstractSortedDirModelFilter::~AbstractSortedDirModelFilter()
     }
 }
 
+/**
+ * Once a folder being listed reaches this many entries, new entries are
+ * appended instead of being inserted at their sorted position, and the model
+ * is sorted once when listing is done.
+ */
+static const int LARGE_FOLDER_ROW_COUNT = 5000;
+
+/**
+ * What lessThan() needs to know about an item, computed once per source row
+ * instead of once per comparison.
+ */
+struct SortKey
+{
+    SortKey(const QCollatorSortKey& nameKey)
+    : mNameKey(nameKey)
+    , mHasDate(false)
+    {}
+
+    bool mIsDirOrArchive;
+    bool mIsDir;
+    bool mIsHidden;
+    KIO::filesize_t mSize;
+    QCollatorSortKey mNameKey;
+    // Only computed when sorting by date
+    bool mHasDate;
+    QDateTime mDate;
+};
+
+static void readDate(KFileItem& item)
+{
+    // Fills the TimeUtils cache
+    TimeUtils::dateTimeForFileItem(item);
+}
+
 struct SortedDirModelPrivate
 {
+    SortedDirModel* q;
 #ifdef GWENVIEW_SEMANTICINFO_BACKEND_NONE
     KDirModel* mSourceModel;
 #else
@@ -69,25 +109,118 @@ struct SortedDirModelPrivate
     QList<AbstractSortedDirModelFilter*> mFilters;
     QTimer mDelayedApplyFiltersTimer;
     MimeTypeUtils::Kinds mKindFilter;
+    bool mListing;
+    bool mNaturalSorting;
+    QCollator mCollator;
+    // Indexed by the KDirModel node of the source index, which works for
+    // trees too. Items are created on demand.
+    QHash<void*, SortKey*> mSortKeys;
+
+    // Items whose date has not been read yet, by url
+    QHash<QUrl, KFileItem> mPendingDateItems;
+    // Items whose date is being read in worker threads
+    KFileItemList mDateItems;
+    QSet<QUrl> mDateUrls;
+    QFutureWatcher<void> mDateWatcher;
+    QTimer mReadDatesTimer;
+
+    SortKey* sortKey(const QModelIndex& sourceIndex)
+    {
+        if (mCollator.caseSensitivity() != q->sortCaseSensitivity()) {
+            clearSortKeys();
+            mCollator.setCaseSensitivity(q->sortCaseSensitivity());
+        }
+        SortKey*& key = mSortKeys[sourceIndex.internalPointer()];
+        if (!key) {
+            const KFileItem item = mSourceModel->itemForIndex(sourceIndex);
+            key = new SortKey(mCollator.sortKey(item.text()));
+            key->mIsDirOrArchive = ArchiveUtils::fileItemIsDirOrArchive(item);
+            key->mIsDir = item.isDir();
+            key->mIsHidden = item.isHidden();
+            key->mSize = item.size();
+        }
+        return key;
+    }
+
+    /**
+     * Returns the date of @p key. Reading Exif data is too slow to be done
+     * while sorting, so dates which are not in the TimeUtils cache are read
+     * in worker threads. Until then, the modification time is used.
+     */
+    const QDateTime& date(SortKey* key, const QModelIndex& sourceIndex)
+    {
+        if (!key->mHasDate) {
+            const KFileItem item = mSourceModel->itemForIndex(sourceIndex);
+            if (!TimeUtils::cachedDateTimeForFileItem(item, &key->mDate)) {
+                key->mDate = item.time(KFileItem::ModificationTime);
+                const QUrl url = item.targetUrl();
+                if (!mDateUrls.contains(url) && !mPendingDateItems.contains(url)) {
+                    mPendingDateItems.insert(url, item);
+                    mReadDatesTimer.start();
+                }
+            }
+            key->mHasDate = true;
+        }
+        return key->mDate;
+    }
+
+    void clearSortKeys()
+    {
+        qDeleteAll(mSortKeys);
+        mSortKeys.clear();
+    }
+
+    void connectDirLister(KDirLister* dirLister)
+    {
+        QObject::connect(dirLister, &KDirLister::started, q, &SortedDirModel::slotListingStarted);
+        QObject::connect(dirLister, static_cast<void (KDirLister::*)()>(&KDirLister::completed),
+                         q, &SortedDirModel::slotListingFinished);
+        QObject::connect(dirLister, static_cast<void (KDirLister::*)()>(&KDirLister::canceled),
+                         q, &SortedDirModel::slotListingFinished);
+    }
 };
 
 SortedDirModel::SortedDirModel(QObject* parent)
 : KDirSortFilterProxyModel(parent)
 , d(new SortedDirModelPrivate)
 {
+    d->q = this;
+    d->mListing = false;
+    // Match the name comparison of KDirSortFilterProxyModel
+    d->mNaturalSorting = KConfigGroup(KSharedConfig::openConfig(), "KDE").readEntry("NaturalSorting", true);
+    d->mCollator.setNumericMode(true);
+    d->mCollator.setCaseSensitivity(sortCaseSensitivity());
 #ifdef GWENVIEW_SEMANTICINFO_BACKEND_NONE
     d->mSourceModel = new KDirModel(this);
 #else
     d->mSourceModel = new SemanticInfoDirModel(this);
 #endif
+    // Sort keys are indexed by KDirModel node: they must be dropped before
+    // QSortFilterProxyModel reacts to source changes, since nodes may be
+    // deleted or their content changed. Connect before calling
+    // setSourceModel()
+    connect(d->mSourceModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &SortedDirModel::slotSourceRowsAboutToBeInserted);
+    connect(d->mSourceModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &SortedDirModel::clearSortKeys);
+    connect(d->mSourceModel, &QAbstractItemModel::rowsAboutToBeMoved, this, &SortedDirModel::clearSortKeys);
+    connect(d->mSourceModel, &QAbstractItemModel::modelAboutToBeReset, this, &SortedDirModel::clearSortKeys);
+    connect(d->mSourceModel, &QAbstractItemModel::layoutAboutToBeChanged, this, &SortedDirModel::clearSortKeys);
+    connect(d->mSourceModel, &QAbstractItemModel::dataChanged, this, &SortedDirModel::slotSourceDataChanged);
+    d->connectDirLister(dirLister());
     setSourceModel(d->mSourceModel);
     d->mDelayedApplyFiltersTimer.setInterval(0);
     d->mDelayedApplyFiltersTimer.setSingleShot(true);
     connect(&d->mDelayedApplyFiltersTimer, &QTimer::timeout, this, &SortedDirModel::doApplyFilters);
+    d->mReadDatesTimer.setInterval(0);
+    d->mReadDatesTimer.setSingleShot(true);
+    connect(&d->mReadDatesTimer, &QTimer::timeout, this, &SortedDirModel::readPendingDates);
+    connect(&d->mDateWatcher, &QFutureWatcher<void>::finished, this, &SortedDirModel::slotDatesRead);
 }
 
 SortedDirModel::~SortedDirModel()
 {
+    d->mDateWatcher.cancel();
+    d->mDateWatcher.waitForFinished();
+    d->clearSortKeys();
     delete d;
 }
 
@@ -258,24 +391,33 @@ void SortedDirModel::doApplyFilters()
 
 bool SortedDirModel::lessThan(const QModelIndex& left, const QModelIndex& right) const
 {
-    const KFileItem leftItem = itemForSourceIndex(left);
-    const KFileItem rightItem = itemForSourceIndex(right);
+    SortKey* leftKey = d->sortKey(left);
+    SortKey* rightKey = d->sortKey(right);
 
-    const bool leftIsDirOrArchive = ArchiveUtils::fileItemIsDirOrArchive(leftItem);
-    const bool rightIsDirOrArchive = ArchiveUtils::fileItemIsDirOrArchive(rightItem);
-
-    if (leftIsDirOrArchive != rightIsDirOrArchive) {
-        return leftIsDirOrArchive;
+    if (leftKey->mIsDirOrArchive != rightKey->mIsDirOrArchive) {
+        return leftKey->mIsDirOrArchive;
     }
 
     if (sortColumn() != KDirModel::ModifiedTime) {
+        // KDirSortFilterProxyModel puts folders and hidden items first, only
+        // take shortcuts when both items are of the same kind, and let it
+        // handle ties
+        if (leftKey->mIsDir == rightKey->mIsDir && leftKey->mIsHidden == rightKey->mIsHidden) {
+            if (sortColumn() == KDirModel::Name && d->mNaturalSorting) {
+                const int result = leftKey->mNameKey.compare(rightKey->mNameKey);
+                if (result != 0) {
+                    return result < 0;
+                }
+            } else if (sortColumn() == KDirModel::Size && !leftKey->mIsDir) {
+                if (leftKey->mSize != rightKey->mSize) {
+                    return leftKey->mSize < rightKey->mSize;
+                }
+            }
+        }
         return KDirSortFilterProxyModel::lessThan(left, right);
     }
 
-    const QDateTime leftDate = TimeUtils::dateTimeForFileItem(leftItem);
-    const QDateTime rightDate = TimeUtils::dateTimeForFileItem(rightItem);
-
-    return leftDate < rightDate;
+    return d->date(leftKey, left) < d->date(rightKey, right);
 }
 
 bool SortedDirModel::hasDocuments() const
@@ -297,6 +439,89 @@ bool SortedDirModel::hasDocuments() const
 void SortedDirModel::setDirLister(KDirLister* dirLister)
 {
     d->mSourceModel->setDirLister(dirLister);
+    d->connectDirLister(dirLister);
+}
+
+void SortedDirModel::clearSortKeys()
+{
+    d->clearSortKeys();
+}
+
+void SortedDirModel::slotSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        delete d->mSortKeys.take(topLeft.sibling(row, 0).internalPointer());
+    }
+}
+
+void SortedDirModel::slotSourceRowsAboutToBeInserted(const QModelIndex& parent, int start, int end)
+{
+    // Inserting rows does not change existing nodes, so sort keys can be kept
+    if (!d->mListing || !dynamicSortFilter()) {
+        return;
+    }
+    if (d->mSourceModel->rowCount(parent) + end - start + 1 < LARGE_FOLDER_ROW_COUNT) {
+        return;
+    }
+    // Inserting each new batch at its sorted position scatters it all over
+    // the model, and the cost of updating the view and the persistent
+    // indexes grows with the folder size. Append the remaining batches as
+    // they come and sort only once, when listing is done.
+    setDynamicSortFilter(false);
+}
+
+void SortedDirModel::readPendingDates()
+{
+    if (d->mDateWatcher.isRunning() || d->mPendingDateItems.isEmpty()) {
+        // slotDatesRead() calls us again when the current batch is done
+        return;
+    }
+    d->mDateItems = d->mPendingDateItems.values();
+    d->mDateUrls = d->mPendingDateItems.keys().toSet();
+    d->mPendingDateItems.clear();
+    d->mDateWatcher.setFuture(QtConcurrent::map(d->mDateItems, readDate));
+}
+
+void SortedDirModel::slotDatesRead()
+{
+    const bool canceled = d->mDateWatcher.isCanceled();
+    d->mDateItems.clear();
+    d->mDateUrls.clear();
+    // A canceled batch was read for the previous listing
+    if (!canceled && sortColumn() == KDirModel::ModifiedTime) {
+        // Sort again, using the dates which have just been read
+        d->clearSortKeys();
+        invalidate();
+    }
+    readPendingDates();
+}
+
+void SortedDirModel::slotListingStarted()
+{
+    d->mListing = true;
+    // Do not read dates for the previous listing. Sort keys are dropped so
+    // that items which are listed again get queued again.
+    d->mReadDatesTimer.stop();
+    d->mPendingDateItems.clear();
+    d->mDateWatcher.cancel();
+    // mDateItems must live until the batch is finished
+    d->mDateUrls.clear();
+    d->clearSortKeys();
+}
+
+void SortedDirModel::slotListingFinished()
+{
+    d->mListing = false;
+    if (dynamicSortFilter()) {
+        return;
+    }
+    // Turning dynamic sorting back on sorts the model
+    setDynamicSortFilter(true);
+    if (!d->mFilters.isEmpty()) {
+        // Without dynamic sorting, rows accepted once semantic info became
+        // available have not been filtered again
+        applyFilters();
+    }
 }
 
 } //namespace
@@ -122,6 +122,13 @@ protected:
 
 private Q_SLOTS:
     void doApplyFilters();
+    void clearSortKeys();
+    void slotSourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void slotSourceRowsAboutToBeInserted(const QModelIndex& parent, int start, int end);
+    void slotListingStarted();
+    void slotListingFinished();
+    void readPendingDates();
+    void slotDatesRead();
 
 private:
     friend struct SortedDirModelPrivate;
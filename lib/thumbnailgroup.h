@@ -32,28 +32,53 @@ namespace Gwenview
 
 namespace ThumbnailGroup
 {
+/**
+ * The thumbnail sizes defined by the freedesktop.org thumbnail specification,
+ * from the smallest to the largest
+ */
 enum Enum {
     Normal,
-    Large
+    Large,
+    XLarge,
+    XXLarge
 };
 
 inline int pixelSize(Enum value)
 {
-    if (value == Normal) {
+    switch (value) {
+    case Normal:
         return 128;
-    } else {
+    case Large:
         return 256;
+    case XLarge:
+        return 512;
+    case XXLarge:
+        return 1024;
     }
+    return 128;
 }
 
 inline Enum fromPixelSize(int value)
 {
     if (value <= 128) {
         return Normal;
-    } else {
+    } else if (value <= 256) {
         return Large;
+    } else if (value <= 512) {
+        return XLarge;
+    } else {
+        return XXLarge;
     }
 }
+
+/**
+ * Returns the group of thumbnails shown @p value logical pixels big on a
+ * screen whose device pixel ratio is @p devicePixelRatio
+ */
+inline Enum fromPixelSize(int value, qreal devicePixelRatio)
+{
+    return fromPixelSize(qRound(value * devicePixelRatio));
+}
 } // namespace ThumbnailGroup
 
 } // namespace Gwenview
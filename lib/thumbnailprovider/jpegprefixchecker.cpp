@@ -0,0 +1,213 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+// Self
+#include "jpegprefixchecker.h"
+
+// Qt
+#include <QBuffer>
+#include <QImage>
+
+// Local
+#include <lib/jpegcontent.h>
+
+namespace Gwenview
+{
+
+// SOF0 to SOF15, except DHT, JPG and DAC which use the same range
+static bool isStartOfFrame(uchar marker)
+{
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+static bool isProgressiveStartOfFrame(uchar marker)
+{
+    return marker == 0xC2 || marker == 0xC6 || marker == 0xCA || marker == 0xCE;
+}
+
+// Markers which are not followed by a length
+static bool isStandaloneMarker(uchar marker)
+{
+    return marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8);
+}
+
+JpegPrefixChecker::JpegPrefixChecker(int pixelSize, bool useEmbeddedThumbnail)
+: mPixelSize(pixelSize)
+, mUseEmbeddedThumbnail(useEmbeddedThumbnail)
+, mStatus(NeedMoreData)
+, mPosition(0)
+, mInScan(false)
+, mHeaderChecked(false)
+, mWidth(0)
+, mHeight(0)
+, mProgressive(false)
+, mComponentCount(0)
+{
+}
+
+JpegPrefixChecker::Status JpegPrefixChecker::status() const
+{
+    return mStatus;
+}
+
+JpegPrefixChecker::Status JpegPrefixChecker::check(const QByteArray& data)
+{
+    if (mStatus != NeedMoreData) {
+        return mStatus;
+    }
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+    const int size = data.size();
+
+    if (mPosition == 0) {
+        if (size < 2) {
+            return mStatus;
+        }
+        if (bytes[0] != 0xFF || bytes[1] != 0xD8) {
+            mStatus = NeedWholeFile;
+            return mStatus;
+        }
+        mPosition = 2;
+    }
+
+    Q_FOREVER {
+        if (mInScan) {
+            // The scan ends at the first marker. 0xFF00 is an escaped 0xFF
+            // and restart markers are part of the scan.
+            for (; mPosition + 1 < size; ++mPosition) {
+                if (bytes[mPosition] != 0xFF) {
+                    continue;
+                }
+                const uchar next = bytes[mPosition + 1];
+                if (next != 0x00 && next != 0xFF && (next < 0xD0 || next > 0xD7)) {
+                    break;
+                }
+            }
+            if (mPosition + 1 >= size) {
+                return mStatus;
+            }
+            mInScan = false;
+            Q_FOREACH(int component, mScanDcComponents) {
+                mDcComponents.insert(component);
+            }
+            if (mDcComponents.count() >= mComponentCount) {
+                mStatus = PrefixIsEnough;
+                return mStatus;
+            }
+        }
+
+        if (mPosition + 2 > size) {
+            return mStatus;
+        }
+        if (bytes[mPosition] != 0xFF) {
+            mStatus = NeedWholeFile;
+            return mStatus;
+        }
+        const uchar marker = bytes[mPosition + 1];
+        if (marker == 0xFF) {
+            // Fill byte
+            ++mPosition;
+            continue;
+        }
+        if (marker == 0xD9 /* EOI */) {
+            // Nothing left to download anyway
+            mStatus = NeedWholeFile;
+            return mStatus;
+        }
+        if (isStandaloneMarker(marker)) {
+            mPosition += 2;
+            continue;
+        }
+
+        if (mPosition + 4 > size) {
+            return mStatus;
+        }
+        const int length = (bytes[mPosition + 2] << 8) | bytes[mPosition + 3];
+        const int segmentEnd = mPosition + 2 + length;
+        const uchar* segment = bytes + mPosition + 4;
+        if (length < 2) {
+            mStatus = NeedWholeFile;
+            return mStatus;
+        }
+
+        if (isStartOfFrame(marker)) {
+            if (segmentEnd > size) {
+                return mStatus;
+            }
+            if (length < 8) {
+                mStatus = NeedWholeFile;
+                return mStatus;
+            }
+            mHeight = (segment[1] << 8) | segment[2];
+            mWidth = (segment[3] << 8) | segment[4];
+            mComponentCount = segment[5];
+            mProgressive = isProgressiveStartOfFrame(marker);
+        } else if (marker == 0xDA /* SOS */) {
+            if (segmentEnd > size) {
+                return mStatus;
+            }
+            if (!mHeaderChecked) {
+                mHeaderChecked = true;
+                if (embeddedThumbnailIsEnough(data.left(mPosition))) {
+                    mStatus = PrefixIsEnough;
+                    return mStatus;
+                }
+                if (!mProgressive || mComponentCount == 0 || qMax(mWidth, mHeight) / 8 < mPixelSize) {
+                    mStatus = NeedWholeFile;
+                    return mStatus;
+                }
+            }
+            const int componentCount = segment[0];
+            if (length < 6 + 2 * componentCount) {
+                mStatus = NeedWholeFile;
+                return mStatus;
+            }
+            // Only the first DC scan of a component counts, refinement scans
+            // (successive approximation high bit not 0) do not add anything
+            const int spectralStart = segment[1 + 2 * componentCount];
+            const int approximationHigh = segment[3 + 2 * componentCount] >> 4;
+            mScanDcComponents.clear();
+            if (spectralStart == 0 && approximationHigh == 0) {
+                for (int i = 0; i < componentCount; ++i) {
+                    mScanDcComponents << segment[1 + 2 * i];
+                }
+            }
+            mInScan = true;
+        }
+        mPosition = segmentEnd;
+    }
+}
+
+bool JpegPrefixChecker::embeddedThumbnailIsEnough(const QByteArray& header) const
+{
+    if (!mUseEmbeddedThumbnail) {
+        return false;
+    }
+    QByteArray data = header;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+    JpegContent content;
+    if (!content.loadHeader(&buffer)) {
+        return false;
+    }
+    const QImage thumbnail = content.thumbnail();
+    return qMax(thumbnail.width(), thumbnail.height()) >= mPixelSize;
+}
+
+} // namespace
@@ -0,0 +1,97 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#ifndef JPEGPREFIXCHECKER_H
+#define JPEGPREFIXCHECKER_H
+
+#include <lib/gwenviewlib_export.h>
+
+// Qt
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+
+namespace Gwenview
+{
+
+/**
+ * Tells whether the start of a JPEG file is enough to create a thumbnail,
+ * so that downloading a remote image can stop early.
+ *
+ * The start is enough if it contains an embedded thumbnail of the requested
+ * size, or if the image is progressive and big enough for the first DC
+ * scans to produce a thumbnail of the requested size: libjpeg decodes a
+ * truncated progressive file, and decoding at 1/8 scale only needs the DC
+ * coefficients.
+ *
+ * The data is parsed incrementally, check() only looks at what it has not
+ * seen yet.
+ */
+class GWENVIEWLIB_EXPORT JpegPrefixChecker
+{
+public:
+    enum Status {
+        NeedMoreData,
+        PrefixIsEnough,
+        NeedWholeFile
+    };
+
+    /**
+     * @p pixelSize is the size of the thumbnail to create. The embedded
+     * thumbnail is only considered if @p useEmbeddedThumbnail is true.
+     */
+    JpegPrefixChecker(int pixelSize, bool useEmbeddedThumbnail);
+
+    /**
+     * Checks @p data, the start of the file received so far. Between two
+     * calls, @p data must only grow with the data received since.
+     */
+    Status check(const QByteArray& data);
+
+    Status status() const;
+
+private:
+    int mPixelSize;
+    bool mUseEmbeddedThumbnail;
+    Status mStatus;
+
+    // Where parsing resumes
+    int mPosition;
+    // True while going through entropy-coded data
+    bool mInScan;
+    // True once the embedded thumbnail has been looked at
+    bool mHeaderChecked;
+
+    int mWidth;
+    int mHeight;
+    bool mProgressive;
+    int mComponentCount;
+
+    // Components whose DC coefficients are complete
+    QSet<int> mDcComponents;
+    // Components whose DC coefficients are in the current scan
+    QList<int> mScanDcComponents;
+
+    bool embeddedThumbnailIsEnough(const QByteArray& header) const;
+};
+
+} // namespace
+
+#endif /* JPEGPREFIXCHECKER_H */
@@ -0,0 +1,141 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+// Self
+#include "pngtextreader.h"
+
+// Qt
+#include <QByteArray>
+#include <QFile>
+#include <QtEndian>
+
+namespace Gwenview
+{
+
+namespace PngTextReader
+{
+
+// Text chunks are small, anything bigger is not worth reading
+static const quint32 MAX_TEXT_CHUNK_SIZE = 64 * 1024;
+
+static QByteArray uncompress(const QByteArray& data)
+{
+    // qUncompress() expects the uncompressed size first, it grows its
+    // buffer if this is not enough
+    QByteArray input(4, '\0');
+    qToBigEndian<quint32>(data.size() * 4, reinterpret_cast<uchar*>(input.data()));
+    input += data;
+    return qUncompress(input);
+}
+
+static void readText(const QByteArray& data, QHash<QString, QString>* texts)
+{
+    const int keyEnd = data.indexOf('\0');
+    if (keyEnd <= 0) {
+        return;
+    }
+    texts->insert(QString::fromLatin1(data.left(keyEnd)), QString::fromLatin1(data.mid(keyEnd + 1)));
+}
+
+static void readCompressedText(const QByteArray& data, QHash<QString, QString>* texts)
+{
+    // Keyword, null, compression method, compressed text
+    const int keyEnd = data.indexOf('\0');
+    if (keyEnd <= 0 || keyEnd + 2 > data.size() || data.at(keyEnd + 1) != 0) {
+        return;
+    }
+    texts->insert(QString::fromLatin1(data.left(keyEnd)), QString::fromLatin1(uncompress(data.mid(keyEnd + 2))));
+}
+
+static void readInternationalText(const QByteArray& data, QHash<QString, QString>* texts)
+{
+    // Keyword, null, compression flag, compression method, language tag,
+    // null, translated keyword, null, UTF-8 text
+    const int keyEnd = data.indexOf('\0');
+    if (keyEnd <= 0 || keyEnd + 3 > data.size()) {
+        return;
+    }
+    const bool compressed = data.at(keyEnd + 1) != 0;
+    const int languageEnd = data.indexOf('\0', keyEnd + 3);
+    const int translatedKeyEnd = languageEnd < 0 ? -1 : data.indexOf('\0', languageEnd + 1);
+    if (translatedKeyEnd < 0) {
+        return;
+    }
+    QByteArray text = data.mid(translatedKeyEnd + 1);
+    if (compressed) {
+        text = uncompress(text);
+    }
+    texts->insert(QString::fromLatin1(data.left(keyEnd)), QString::fromUtf8(text));
+}
+
+bool read(QIODevice* device, QHash<QString, QString>* texts)
+{
+    static const char signature[] = "\x89PNG\r\n\x1a\n";
+    if (device->read(8) != QByteArray::fromRawData(signature, 8)) {
+        return false;
+    }
+
+    Q_FOREVER {
+        uchar header[8];
+        if (device->read(reinterpret_cast<char*>(header), 8) != 8) {
+            // Truncated file, keep what we got
+            return true;
+        }
+        const quint32 length = qFromBigEndian<quint32>(header);
+        const QByteArray type = QByteArray(reinterpret_cast<const char*>(header + 4), 4);
+        if (type == "IDAT" || type == "IEND") {
+            return true;
+        }
+
+        const bool isText = type == "tEXt" || type == "zTXt" || type == "iTXt";
+        if (isText && length <= MAX_TEXT_CHUNK_SIZE) {
+            const QByteArray data = device->read(length);
+            if (data.size() != int(length)) {
+                return true;
+            }
+            if (type == "tEXt") {
+                readText(data, texts);
+            } else if (type == "zTXt") {
+                readCompressedText(data, texts);
+            } else {
+                readInternationalText(data, texts);
+            }
+            // Skip the CRC
+            if (!device->seek(device->pos() + 4)) {
+                return true;
+            }
+        } else if (!device->seek(device->pos() + qint64(length) + 4)) {
+            return true;
+        }
+    }
+}
+
+bool read(const QString& path, QHash<QString, QString>* texts)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return read(&file, texts);
+}
+
+} // namespace
+
+} // namespace
@@ -0,0 +1,56 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#ifndef PNGTEXTREADER_H
+#define PNGTEXTREADER_H
+
+#include <lib/gwenviewlib_export.h>
+
+// Qt
+#include <QHash>
+#include <QString>
+
+class QIODevice;
+
+namespace Gwenview
+{
+
+/**
+ * Reads the text chunks of PNG files without decoding their pixels.
+ *
+ * Only the chunks which come before the image data are read, this is where
+ * the thumbnail specification stores the Thumb::* keys.
+ */
+namespace PngTextReader
+{
+
+/**
+ * Reads the tEXt, zTXt and iTXt chunks of @p device into @p texts. Returns
+ * false if @p device does not contain a PNG image.
+ */
+GWENVIEWLIB_EXPORT bool read(QIODevice* device, QHash<QString, QString>* texts);
+
+GWENVIEWLIB_EXPORT bool read(const QString& path, QHash<QString, QString>* texts);
+
+} // namespace
+
+} // namespace
+
+#endif /* PNGTEXTREADER_H */
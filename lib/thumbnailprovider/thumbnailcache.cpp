@@ -0,0 +1,221 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+// Self
+#include "thumbnailcache.h"
+
+// Local
+
+// KDE
+
+// Qt
+#include <QCache>
+#include <QDateTime>
+#include <QDebug>
+#include <QHash>
+
+namespace Gwenview
+{
+
+#undef ENABLE_LOG
+#undef LOG
+//#define ENABLE_LOG
+#ifdef ENABLE_LOG
+#define LOG(x) qDebug() << x
+#else
+#define LOG(x) ;
+#endif
+
+/** Size of the cache, in kilobytes */
+static const int DEFAULT_CACHE_SIZE = 64 * 1024;
+
+inline int getCacheSize()
+{
+    QByteArray ba = qgetenv("GV_THUMBNAIL_CACHE_SIZE");
+    if (ba.isEmpty()) {
+        return DEFAULT_CACHE_SIZE;
+    }
+    LOG("Custom thumbnail cache size:" << ba << "MB");
+    bool ok;
+    int value = ba.toInt(&ok);
+    return ok ? value * 1024 : DEFAULT_CACHE_SIZE;
+}
+
+struct ThumbnailCacheKey
+{
+    QUrl mUrl;
+    ThumbnailGroup::Enum mGroup;
+
+    ThumbnailCacheKey(const QUrl& url, ThumbnailGroup::Enum group)
+    : mUrl(url)
+    , mGroup(group)
+    {}
+
+    bool operator==(const ThumbnailCacheKey& other) const
+    {
+        return mGroup == other.mGroup && mUrl == other.mUrl;
+    }
+};
+
+inline uint qHash(const ThumbnailCacheKey& key, uint seed = 0)
+{
+    return qHash(key.mUrl, seed) ^ uint(key.mGroup);
+}
+
+struct ThumbnailCacheEntry
+{
+    QPixmap mPixmap;
+    QSize mOriginalSize;
+    QDateTime mTime;
+    KIO::filesize_t mFileSize;
+};
+
+struct ThumbnailCachePrivate
+{
+    QCache<ThumbnailCacheKey, ThumbnailCacheEntry> mCache;
+    QHash<ThumbnailCacheKey, const QObject*> mLoaders;
+
+    /// Returns true if @p loader was loading @p key
+    bool finishLoading(const ThumbnailCacheKey& key, const QObject* loader)
+    {
+        QHash<ThumbnailCacheKey, const QObject*>::Iterator it = mLoaders.find(key);
+        if (it == mLoaders.end() || it.value() != loader) {
+            return false;
+        }
+        mLoaders.erase(it);
+        return true;
+    }
+};
+
+ThumbnailCache::ThumbnailCache()
+: d(new ThumbnailCachePrivate)
+{
+    d->mCache.setMaxCost(getCacheSize());
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    delete d;
+}
+
+ThumbnailCache* ThumbnailCache::instance()
+{
+    static ThumbnailCache cache;
+    return &cache;
+}
+
+int ThumbnailCache::maxCost() const
+{
+    return d->mCache.maxCost();
+}
+
+bool ThumbnailCache::find(const KFileItem& item, ThumbnailGroup::Enum group, QPixmap* pixmap, QSize* originalSize) const
+{
+    const ThumbnailCacheKey key(item.url(), group);
+    ThumbnailCacheEntry* entry = d->mCache.object(key);
+    if (!entry) {
+        return false;
+    }
+    if (entry->mTime != item.time(KFileItem::ModificationTime) || entry->mFileSize != item.size()) {
+        LOG("Outdated entry for" << item.url());
+        d->mCache.remove(key);
+        return false;
+    }
+    if (pixmap) {
+        *pixmap = entry->mPixmap;
+    }
+    if (originalSize) {
+        *originalSize = entry->mOriginalSize;
+    }
+    return true;
+}
+
+void ThumbnailCache::insert(const KFileItem& item, ThumbnailGroup::Enum group, const QPixmap& pixmap, const QSize& originalSize)
+{
+    const ThumbnailCacheKey key(item.url(), group);
+    if (!pixmap.isNull()) {
+        ThumbnailCacheEntry* entry = new ThumbnailCacheEntry;
+        entry->mPixmap = pixmap;
+        entry->mOriginalSize = originalSize;
+        entry->mTime = item.time(KFileItem::ModificationTime);
+        entry->mFileSize = item.size();
+        // Cost is in kilobytes
+        const int cost = qMax(1, pixmap.width() * pixmap.height() * pixmap.depth() / 8 / 1024);
+        d->mCache.insert(key, entry, cost);
+    }
+    // Notify even if the cache is too small for the pixmap: it does not
+    // matter for waiting providers, they only need to know they can stop
+    // waiting
+    d->mLoaders.remove(key);
+    emit thumbnailInserted(key.mUrl, group);
+}
+
+void ThumbnailCache::remove(const QUrl& url)
+{
+    for (int group = ThumbnailGroup::Normal; group <= ThumbnailGroup::XXLarge; ++group) {
+        d->mCache.remove(ThumbnailCacheKey(url, ThumbnailGroup::Enum(group)));
+    }
+}
+
+bool ThumbnailCache::startLoading(const QUrl& url, ThumbnailGroup::Enum group, const QObject* loader)
+{
+    const ThumbnailCacheKey key(url, group);
+    const QObject* currentLoader = d->mLoaders.value(key);
+    if (currentLoader && currentLoader != loader) {
+        return false;
+    }
+    d->mLoaders.insert(key, loader);
+    return true;
+}
+
+void ThumbnailCache::loadingFailed(const QUrl& url, ThumbnailGroup::Enum group, const QObject* loader)
+{
+    const ThumbnailCacheKey key(url, group);
+    if (d->finishLoading(key, loader)) {
+        emit thumbnailLoadingFailed(url, group);
+    }
+}
+
+void ThumbnailCache::cancelLoading(const QUrl& url, ThumbnailGroup::Enum group, const QObject* loader)
+{
+    const ThumbnailCacheKey key(url, group);
+    if (d->finishLoading(key, loader)) {
+        emit thumbnailLoadingCancelled(url, group);
+    }
+}
+
+void ThumbnailCache::cancelLoading(const QObject* loader)
+{
+    QList<ThumbnailCacheKey> cancelledKeys;
+    QHash<ThumbnailCacheKey, const QObject*>::Iterator it = d->mLoaders.begin();
+    while (it != d->mLoaders.end()) {
+        if (it.value() == loader) {
+            cancelledKeys << it.key();
+            it = d->mLoaders.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    Q_FOREACH(const ThumbnailCacheKey& key, cancelledKeys) {
+        emit thumbnailLoadingCancelled(key.mUrl, key.mGroup);
+    }
+}
+
+} // namespace
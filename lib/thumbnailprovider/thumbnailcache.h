@@ -0,0 +1,114 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <lib/gwenviewlib_export.h>
+
+// Local
+#include <lib/thumbnailgroup.h>
+
+// KDE
+#include <KFileItem>
+
+// Qt
+#include <QObject>
+#include <QPixmap>
+#include <QUrl>
+
+namespace Gwenview
+{
+
+struct ThumbnailCachePrivate;
+/**
+ * A process-wide cache of the thumbnails loaded by all ThumbnailProvider
+ * instances, so that switching between views showing the same items does
+ * not load their thumbnails again.
+ *
+ * Entries are checked against the modification time and the size of the
+ * item. The least recently used entries are dropped when the cache gets
+ * bigger than its budget.
+ *
+ * The cache also knows which thumbnails are being loaded, so that when
+ * several providers are asked for the same item, only one of them loads it.
+ * The others wait for one of the signals.
+ */
+class GWENVIEWLIB_EXPORT ThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    static ThumbnailCache* instance();
+
+    /**
+     * Returns true if there is an up-to-date thumbnail for @p item.
+     * @p pixmap and @p originalSize can be null.
+     */
+    bool find(const KFileItem& item, ThumbnailGroup::Enum group, QPixmap* pixmap, QSize* originalSize) const;
+
+    /**
+     * Stores the thumbnail of @p item. If @p item was being loaded, waiting
+     * providers are notified through thumbnailInserted().
+     */
+    void insert(const KFileItem& item, ThumbnailGroup::Enum group, const QPixmap& pixmap, const QSize& originalSize);
+
+    /**
+     * Drop the thumbnails of @p url
+     */
+    void remove(const QUrl& url);
+
+    /**
+     * Returns true if @p loader becomes responsible for loading the thumbnail
+     * of @p url, false if another loader is already loading it.
+     */
+    bool startLoading(const QUrl& url, ThumbnailGroup::Enum group, const QObject* loader);
+
+    /**
+     * Tells the cache the thumbnail of @p url could not be loaded
+     */
+    void loadingFailed(const QUrl& url, ThumbnailGroup::Enum group, const QObject* loader);
+
+    /**
+     * Tells the cache @p loader no longer loads the thumbnail of @p url.
+     * A waiting provider should take over.
+     */
+    void cancelLoading(const QUrl& url, ThumbnailGroup::Enum group, const QObject* loader);
+
+    /**
+     * Cancels all the thumbnails @p loader is loading
+     */
+    void cancelLoading(const QObject* loader);
+
+    int maxCost() const;
+
+Q_SIGNALS:
+    void thumbnailInserted(const QUrl& url, Gwenview::ThumbnailGroup::Enum group);
+    void thumbnailLoadingFailed(const QUrl& url, Gwenview::ThumbnailGroup::Enum group);
+    void thumbnailLoadingCancelled(const QUrl& url, Gwenview::ThumbnailGroup::Enum group);
+
+private:
+    ThumbnailCache();
+    ~ThumbnailCache();
+    ThumbnailCachePrivate* const d;
+};
+
+} // namespace
+
+#endif /* THUMBNAILCACHE_H */
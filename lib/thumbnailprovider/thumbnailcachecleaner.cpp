@@ -0,0 +1,253 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+// Self
+#include "thumbnailcachecleaner.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Qt
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QUrl>
+
+// Local
+#include "pngtextreader.h"
+#include "thumbnailprovider.h"
+
+// std
+#include <algorithm>
+
+namespace Gwenview
+{
+
+#undef ENABLE_LOG
+#undef LOG
+//#define ENABLE_LOG
+#ifdef ENABLE_LOG
+#define LOG(x) qDebug() << x
+#else
+#define LOG(x) ;
+#endif
+
+// Evict a bit more than needed, so that the next runs do not have to evict
+// again right away
+static const qreal EVICTION_TARGET_RATIO = 0.9;
+
+#if defined(Q_OS_LINUX) && defined(SYS_ioprio_set)
+// From linux/ioprio.h, which is not always installed
+static const int IOPRIO_WHO_PROCESS = 1;
+static const int IOPRIO_CLASS_IDLE = 3;
+static const int IOPRIO_CLASS_SHIFT = 13;
+#endif
+
+struct CacheEntry
+{
+    QString mPath;
+    qint64 mSize;
+    qint64 mLastUse;
+
+    bool operator<(const CacheEntry& other) const
+    {
+        return mLastUse < other.mLastUse;
+    }
+};
+
+/**
+ * Returns true if the original of the thumbnail at @p path has been deleted.
+ * If the folder of the original is missing too, it may be on an unmounted
+ * device, so the thumbnail is kept.
+ */
+static bool isOrphan(const QString& path)
+{
+    QHash<QString, QString> texts;
+    if (!PngTextReader::read(path, &texts)) {
+        return false;
+    }
+    const QUrl url(texts.value("Thumb::URI"));
+    if (!url.isLocalFile()) {
+        return false;
+    }
+    const QFileInfo info(url.toLocalFile());
+    return !info.exists() && info.dir().exists();
+}
+
+static ThumbnailCacheCleaner::Report cleanCache(qint64 sizeLimit, const QAtomicInt* cancelled)
+{
+    ThumbnailCacheCleaner::Report report;
+    const QString baseDir = ThumbnailProvider::thumbnailBaseDir();
+    QStringList dirs;
+    for (int group = ThumbnailGroup::Normal; group <= ThumbnailGroup::XXLarge; ++group) {
+        dirs << ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Enum(group));
+    }
+    dirs << baseDir + QStringLiteral("gwenview-packs/");
+
+    QVector<CacheEntry> entries;
+    qint64 totalSize = 0;
+    Q_FOREACH(const QString& dir, dirs) {
+        const bool isPackDir = dir.endsWith(QStringLiteral("gwenview-packs/"));
+        QDirIterator it(dir, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            if (cancelled->load()) {
+                return report;
+            }
+            it.next();
+            const QFileInfo info = it.fileInfo();
+            ++report.mScannedCount;
+            if (!isPackDir && isOrphan(info.filePath())) {
+                LOG("Removing orphan" << info.filePath());
+                if (QFile::remove(info.filePath())) {
+                    ++report.mOrphanCount;
+                    report.mRemovedBytes += info.size();
+                }
+                continue;
+            }
+            CacheEntry entry;
+            entry.mPath = info.filePath();
+            entry.mSize = info.size();
+            // The access time may not be updated, depending on mount options
+            entry.mLastUse = qMax(info.lastRead(), info.lastModified()).toMSecsSinceEpoch();
+            entries << entry;
+            totalSize += entry.mSize;
+        }
+    }
+
+    if (sizeLimit > 0 && totalSize > sizeLimit) {
+        const qint64 targetSize = qint64(sizeLimit * EVICTION_TARGET_RATIO);
+        std::sort(entries.begin(), entries.end());
+        for (int i = 0; i < entries.count() && totalSize > targetSize; ++i) {
+            if (cancelled->load()) {
+                break;
+            }
+            const CacheEntry& entry = entries.at(i);
+            LOG("Evicting" << entry.mPath);
+            if (QFile::remove(entry.mPath)) {
+                ++report.mEvictedCount;
+                report.mRemovedBytes += entry.mSize;
+                totalSize -= entry.mSize;
+            }
+        }
+    }
+    report.mRemainingBytes = totalSize;
+    return report;
+}
+
+/**
+ * Cleans the cache in its own thread. Once lowered, the priorities of a
+ * thread cannot always be raised again, so the thread is never shared with
+ * other work.
+ */
+class CleanerThread : public QThread
+{
+public:
+    CleanerThread()
+    : mSizeLimit(0)
+    , mCancelled(0)
+    {}
+
+    qint64 mSizeLimit;
+    const QAtomicInt* mCancelled;
+    ThumbnailCacheCleaner::Report mReport;
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+#if defined(Q_OS_LINUX) && defined(SYS_ioprio_set)
+        // 0 means the current thread
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+#endif
+        mReport = cleanCache(mSizeLimit, mCancelled);
+    }
+};
+
+struct ThumbnailCacheCleanerPrivate
+{
+    qint64 mSizeLimit;
+    QAtomicInt mCancelled;
+    CleanerThread mThread;
+};
+
+ThumbnailCacheCleaner::ThumbnailCacheCleaner(QObject* parent)
+: QObject(parent)
+, d(new ThumbnailCacheCleanerPrivate)
+{
+    qRegisterMetaType<Report>("Gwenview::ThumbnailCacheCleaner::Report");
+    d->mSizeLimit = 0;
+    d->mThread.mCancelled = &d->mCancelled;
+    connect(&d->mThread, SIGNAL(finished()), SLOT(slotFinished()));
+}
+
+ThumbnailCacheCleaner::~ThumbnailCacheCleaner()
+{
+    cancel();
+    d->mThread.wait();
+    delete d;
+}
+
+void ThumbnailCacheCleaner::setSizeLimit(qint64 bytes)
+{
+    d->mSizeLimit = bytes;
+}
+
+void ThumbnailCacheCleaner::start()
+{
+    if (isRunning()) {
+        return;
+    }
+    d->mCancelled.store(0);
+    d->mThread.mSizeLimit = d->mSizeLimit;
+    // On Linux, this uses the SCHED_IDLE policy
+    d->mThread.start(QThread::IdlePriority);
+}
+
+bool ThumbnailCacheCleaner::isRunning() const
+{
+    return d->mThread.isRunning();
+}
+
+void ThumbnailCacheCleaner::cancel()
+{
+    d->mCancelled.store(1);
+}
+
+ThumbnailCacheCleaner::Report ThumbnailCacheCleaner::clean()
+{
+    d->mCancelled.store(0);
+    return cleanCache(d->mSizeLimit, &d->mCancelled);
+}
+
+void ThumbnailCacheCleaner::slotFinished()
+{
+    const Report report = d->mThread.mReport;
+    LOG("Scanned" << report.mScannedCount << "thumbnails, removed" << report.mOrphanCount << "orphans and"
+        << report.mEvictedCount << "old ones");
+    emit finished(report);
+}
+
+} // namespace
@@ -0,0 +1,104 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#ifndef THUMBNAILCACHECLEANER_H
+#define THUMBNAILCACHECLEANER_H
+
+#include <lib/gwenviewlib_export.h>
+
+// Qt
+#include <QObject>
+
+namespace Gwenview
+{
+
+struct ThumbnailCacheCleanerPrivate;
+
+/**
+ * Keeps the thumbnail dir within a size budget.
+ *
+ * Thumbnails whose original has been deleted are removed. If the remaining
+ * thumbnails still take more than the budget, the least recently used ones
+ * are removed until they fit. Gwenview thumbnail packs are only evicted by
+ * age.
+ */
+class GWENVIEWLIB_EXPORT ThumbnailCacheCleaner : public QObject
+{
+    Q_OBJECT
+public:
+    struct Report
+    {
+        Report()
+        : mScannedCount(0)
+        , mOrphanCount(0)
+        , mEvictedCount(0)
+        , mRemovedBytes(0)
+        , mRemainingBytes(0)
+        {}
+
+        int mScannedCount;
+        // Thumbnails removed because their original no longer exists
+        int mOrphanCount;
+        // Thumbnails removed to fit in the budget
+        int mEvictedCount;
+        qint64 mRemovedBytes;
+        qint64 mRemainingBytes;
+    };
+
+    explicit ThumbnailCacheCleaner(QObject* parent = 0);
+    /**
+     * Cancels the cleaning and waits for it to stop
+     */
+    ~ThumbnailCacheCleaner();
+
+    /**
+     * Sets the size budget, in bytes. 0 means no limit: only the thumbnails
+     * of deleted originals are removed.
+     */
+    void setSizeLimit(qint64 bytes);
+
+    /**
+     * Cleans the cache in a background thread, at low CPU and I/O priority.
+     * finished() is emitted when done.
+     */
+    void start();
+
+    bool isRunning() const;
+
+    void cancel();
+
+    /**
+     * Cleans the cache in the calling thread
+     */
+    Report clean();
+
+Q_SIGNALS:
+    void finished(const Gwenview::ThumbnailCacheCleaner::Report& report);
+
+private Q_SLOTS:
+    void slotFinished();
+
+private:
+    ThumbnailCacheCleanerPrivate* const d;
+};
+
+} // namespace
+
+#endif /* THUMBNAILCACHECLEANER_H */
@@ -26,6 +26,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 #include "jpegcontent.h"
 #include "gwenviewconfig.h"
 #include "exiv2imageloader.h"
+#include "pngtextreader.h"
+#include "thumbnailpack.h"
+#include "thumbnailwriter.h"
+#include "traceutils.h"
 
 // KDE
 #include <QDebug>
@@ -37,6 +41,19 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 #include <QImageReader>
 #include <QMatrix>
 #include <QBuffer>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace Gwenview
 {
@@ -52,6 +69,11 @@ namespace Gwenview
 
 const int MIN_PREV_SIZE = 1000;
 
+#ifdef Q_OS_LINUX
+/** How much nicer than the viewer the generating threads are */
+static const int THREAD_NICE_INCREMENT = 10;
+#endif
+
 //------------------------------------------------------------------------
 //
 // ThumbnailContext
@@ -59,6 +81,7 @@ const int MIN_PREV_SIZE = 1000;
 //------------------------------------------------------------------------
 bool ThumbnailContext::load(const QString &pixPath, int pixelSize)
 {
+    GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailContext::load", pixPath);
     mImage = QImage();
     mNeedCaching = true;
     Orientation orientation = NORMAL;
@@ -73,6 +96,7 @@ bool ThumbnailContext::load(const QString &pixPath, int pixelSize)
     QByteArray data;
     QBuffer buffer;
     int previewRatio = 1;
+    bool contentLoaded = false;
 
 #ifdef KDCRAW_FOUND
     // raw images deserve special treatment
@@ -97,6 +121,7 @@ bool ThumbnailContext::load(const QString &pixPath, int pixelSize)
             qWarning() << "unable to load preview for " << pixPath.toUtf8().constData();
             return false;
         }
+        contentLoaded = true;
 
         buffer.setBuffer(&data);
         buffer.open(QIODevice::ReadOnly);
@@ -113,7 +138,9 @@ bool ThumbnailContext::load(const QString &pixPath, int pixelSize)
         }
 
         if (reader.format() == "jpeg" && GwenviewConfig::applyExifOrientation()) {
-            content.load(pixPath);
+            // Only read the start of the file: if the embedded thumbnail is
+            // big enough, the rest of the file is never read
+            contentLoaded = content.loadHeader(pixPath) || content.load(pixPath);
         }
     }
 
@@ -121,7 +148,7 @@ bool ThumbnailContext::load(const QString &pixPath, int pixelSize)
     // If applyExifOrientation is not set, don't use the
     // embedded thumbnail since it might be rotated differently
     // than the actual image
-    if (!content.rawData().isEmpty() && GwenviewConfig::applyExifOrientation()) {
+    if (contentLoaded && GwenviewConfig::applyExifOrientation()) {
         QImage thumbnail = content.thumbnail();
         orientation = content.orientation();
 
@@ -187,53 +214,318 @@ bool ThumbnailContext::load(const QString &pixPath, int pixelSize)
     return true;
 }
 
+//------------------------------------------------------------------------
+//
+// ThumbnailTask
+//
+//------------------------------------------------------------------------
+/**
+ * The pool running the tasks of all ThumbnailGenerator instances. Tasks use
+ * the thumbnail writer, so the pool must be done before the writer is
+ * waited for: when the application is about to quit, it drops the tasks
+ * which have not started and waits for the running ones.
+ */
+class ThumbnailThreadPool : public QThreadPool
+{
+public:
+    ThumbnailThreadPool()
+    {
+        int count = GwenviewConfig::thumbnailGenerationThreadCount();
+        if (count <= 0) {
+            // Leave one core to the viewer
+            count = qMax(1, QThread::idealThreadCount() - 1);
+        }
+        setMaxThreadCount(count);
+        if (qApp) {
+            QObject::connect(qApp, &QCoreApplication::aboutToQuit, this, [this]() {
+                clear();
+                waitForDone();
+            });
+        }
+    }
+
+    ~ThumbnailThreadPool()
+    {
+        waitForDone();
+    }
+};
+
+Q_GLOBAL_STATIC(ThumbnailThreadPool, sThreadPool)
+
+/**
+ * Makes the current thread nicer, so that generating thumbnails does not
+ * slow down the viewer. QThread::setPriority() has no effect with the
+ * default scheduling policy of Linux, and the threads of the pool only ever
+ * generate thumbnails, so they stay niced once done.
+ */
+static void lowerThreadPriority()
+{
+#ifdef Q_OS_LINUX
+    static QThreadStorage<bool> sLowered;
+    if (sLowered.hasLocalData()) {
+        return;
+    }
+    sLowered.setLocalData(true);
+    // The nice value is per thread on Linux
+    const id_t tid = syscall(SYS_gettid);
+    errno = 0;
+    const int niceValue = getpriority(PRIO_PROCESS, tid);
+    if (errno == 0) {
+        setpriority(PRIO_PROCESS, tid, qMin(niceValue + THREAD_NICE_INCREMENT, 19));
+    }
+#endif
+}
+
+class ThumbnailTask : public QRunnable
+{
+public:
+    ThumbnailTask(ThumbnailGenerator* generator, const ThumbnailRequest& request)
+    : mGenerator(generator)
+    , mRequest(request)
+    {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (!mGenerator->testCancel()) {
+            process();
+        }
+        mGenerator->taskFinished();
+    }
+
+private:
+    ThumbnailGenerator* mGenerator;
+    ThumbnailRequest mRequest;
+
+    void process()
+    {
+        // Pool threads are created with the default priority
+        lowerThreadPriority();
+
+        ThumbnailResult result;
+        result.mOriginalUri = mRequest.mOriginalUri;
+        result.mThumbnailGroup = mRequest.mThumbnailGroup;
+        if (mRequest.mIsThumbnail) {
+            result.mImage = QImage(mRequest.mPixPath);
+            result.mOriginalSize = result.mImage.size();
+            mGenerator->deliver(result);
+            return;
+        }
+        if (mRequest.mStatOriginal) {
+            mRequest.mOriginalTime = QFileInfo(mRequest.mPixPath).lastModified().toTime_t();
+        }
+        if (mRequest.mCheckCache && loadFromCache(&result)) {
+            mGenerator->deliver(result);
+            return;
+        }
+        if (!mRequest.mGenerate) {
+            result.mCacheMiss = true;
+            mGenerator->deliver(result);
+            return;
+        }
+        if (mGenerator->testCancel()) {
+            return;
+        }
+        generate(&result);
+        mGenerator->deliver(result);
+    }
+
+    bool isValid(const QString& uri, const QString& mtime, const QString& size) const
+    {
+        KIO::filesize_t fileSize = size.toULongLong();
+        return uri == mRequest.mOriginalUri
+            && mtime.toInt() == mRequest.mOriginalTime
+            && (fileSize == 0 || fileSize == mRequest.mOriginalFileSize);
+    }
+
+    /**
+     * Returns the thumbnail stored at @p path if it is valid. The text chunks
+     * are checked before the pixels are decoded, so that outdated thumbnails
+     * are not decoded for nothing.
+     */
+    QImage loadValidThumbnail(const QString& path) const
+    {
+        QImage thumb = mGenerator->mWriter->value(path);
+        if (!thumb.isNull()) {
+            if (!isValid(thumb.text("Thumb::URI"), thumb.text("Thumb::MTime"), thumb.text("Thumb::Size"))) {
+                return QImage();
+            }
+            return thumb;
+        }
+        QHash<QString, QString> texts;
+        if (!PngTextReader::read(path, &texts)
+                || !isValid(texts.value("Thumb::URI"), texts.value("Thumb::MTime"), texts.value("Thumb::Size"))) {
+            return QImage();
+        }
+        return QImage(path);
+    }
+
+    bool loadFromCache(ThumbnailResult* result)
+    {
+        GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailTask::loadFromCache", mRequest.mThumbnailPath);
+        QImage thumb = loadValidThumbnail(mRequest.mThumbnailPath);
+        if (thumb.isNull()) {
+            thumb = createFromLargerThumbnail();
+        }
+        if (thumb.isNull()) {
+            return false;
+        }
+        if (mRequest.mFillPack) {
+            mGenerator->mWriter->queuePackEntry(mRequest.mThumbnailPath, thumb);
+        }
+
+        bool ok;
+        int width = thumb.text("Thumb::Image::Width").toInt(&ok);
+        int height = 0;
+        if (ok) height = thumb.text("Thumb::Image::Height").toInt(&ok);
+        if (ok) {
+            result->mOriginalSize = QSize(width, height);
+        } else {
+            LOG("Thumbnail for" << mRequest.mOriginalUri << "does not contain correct image size information");
+        }
+        result->mImage = thumb;
+        return true;
+    }
+
+    /**
+     * If there is a valid thumbnail for a larger group, generate the thumbnail
+     * from it, so that the original does not have to be loaded
+     */
+    QImage createFromLargerThumbnail()
+    {
+        Q_FOREACH(const QString& path, mRequest.mLargerThumbnailPaths) {
+            const QImage largeImage = loadValidThumbnail(path);
+            if (largeImage.isNull()) {
+                continue;
+            }
+            GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailTask::createFromLargerThumbnail", path);
+            const int size = ThumbnailGroup::pixelSize(mRequest.mThumbnailGroup);
+            QImage thumb = largeImage;
+            if (qMax(thumb.width(), thumb.height()) > size) {
+                thumb = largeImage.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            }
+            Q_FOREACH(const QString& key, largeImage.textKeys()) {
+                thumb.setText(key, largeImage.text(key));
+            }
+            mGenerator->mWriter->queueThumbnail(mRequest.mThumbnailPath, thumb);
+            return thumb;
+        }
+        return QImage();
+    }
+
+    void generate(ThumbnailResult* result)
+    {
+        LOG("Loading" << mRequest.mPixPath);
+        ThumbnailContext context;
+        if (!context.load(mRequest.mPixPath, ThumbnailGroup::pixelSize(mRequest.mThumbnailGroup))) {
+            qWarning() << "Could not generate thumbnail for file" << mRequest.mOriginalUri;
+            return;
+        }
+        result->mImage = context.mImage;
+        result->mOriginalSize = QSize(context.mOriginalWidth, context.mOriginalHeight);
+        if (context.mNeedCaching) {
+            cacheThumbnail(&result->mImage, result->mOriginalSize);
+        }
+    }
+
+    void cacheThumbnail(QImage* image, const QSize& size)
+    {
+        image->setText("Thumb::URI"          , mRequest.mOriginalUri);
+        image->setText("Thumb::MTime"        , QString::number(mRequest.mOriginalTime));
+        image->setText("Thumb::Size"         , QString::number(mRequest.mOriginalFileSize));
+        image->setText("Thumb::Mimetype"     , mRequest.mOriginalMimeType);
+        image->setText("Thumb::Image::Width" , QString::number(size.width()));
+        image->setText("Thumb::Image::Height", QString::number(size.height()));
+        image->setText("Software"            , QStringLiteral("Gwenview"));
+
+        mGenerator->mWriter->queueThumbnail(mRequest.mThumbnailPath, *image);
+    }
+};
+
+class ThumbnailPackTask : public QRunnable
+{
+public:
+    ThumbnailPackTask(ThumbnailGenerator* generator, const QString& packPath, const QList<ThumbnailRequest>& requests)
+    : mGenerator(generator)
+    , mPackPath(packPath)
+    , mRequests(requests)
+    {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (!mGenerator->testCancel()) {
+            process();
+        }
+        mGenerator->taskFinished();
+    }
+
+private:
+    ThumbnailGenerator* mGenerator;
+    QString mPackPath;
+    QList<ThumbnailRequest> mRequests;
+
+    void process()
+    {
+        GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailPackTask::process", mPackPath);
+        lowerThreadPriority();
+        const QSharedPointer<const ThumbnailPack> pack = ThumbnailPack::cached(mPackPath);
+        Q_FOREACH(const ThumbnailRequest& request, mRequests) {
+            ThumbnailResult result;
+            result.mOriginalUri = request.mOriginalUri;
+            result.mThumbnailGroup = request.mThumbnailGroup;
+            if (pack) {
+                const time_t time = request.mStatOriginal
+                    ? QFileInfo(request.mPixPath).lastModified().toTime_t()
+                    : request.mOriginalTime;
+                result.mImage = pack->image(request.mOriginalUri, time, request.mOriginalFileSize, &result.mOriginalSize);
+            }
+            result.mCacheMiss = result.mImage.isNull();
+            mGenerator->deliver(result);
+        }
+    }
+};
+
 //------------------------------------------------------------------------
 //
 // ThumbnailGenerator
 //
 //------------------------------------------------------------------------
-ThumbnailGenerator::ThumbnailGenerator()
-: mCancel(false)
+ThumbnailGenerator::ThumbnailGenerator(ThumbnailWriter* writer)
+: mWriter(writer)
+, mFlushScheduled(false)
+, mTaskCount(0)
+, mCancel(false)
+, mDeleteWhenIdle(false)
 {}
 
-void ThumbnailGenerator::load(
-    const QString& originalUri, time_t originalTime, KIO::filesize_t originalFileSize, const QString& originalMimeType,
-    const QString& pixPath,
-    const QString& thumbnailPath,
-    ThumbnailGroup::Enum group)
+void ThumbnailGenerator::load(const ThumbnailRequest& request)
 {
-    QMutexLocker lock(&mMutex);
-    Q_ASSERT(mPixPath.isNull());
-
-    mOriginalUri = originalUri;
-    mOriginalTime = originalTime;
-    mOriginalFileSize = originalFileSize;
-    mOriginalMimeType = originalMimeType;
-    mPixPath = pixPath;
-    mThumbnailPath = thumbnailPath;
-    mThumbnailGroup = group;
-    if (!isRunning()) start();
-    mCond.wakeOne();
+    taskStarted();
+    sThreadPool->start(new ThumbnailTask(this, request));
 }
 
-QString ThumbnailGenerator::originalUri() const
+void ThumbnailGenerator::loadFromPack(const QString& packPath, const QList<ThumbnailRequest>& requests)
 {
-    return mOriginalUri;
+    taskStarted();
+    // Higher priority than ThumbnailTask: it answers for a whole directory
+    sThreadPool->start(new ThumbnailPackTask(this, packPath, requests), 1);
 }
 
-time_t ThumbnailGenerator::originalTime() const
+void ThumbnailGenerator::taskStarted()
 {
-    return mOriginalTime;
+    QMutexLocker lock(&mMutex);
+    Q_ASSERT(!mCancel);
+    ++mTaskCount;
 }
 
-KIO::filesize_t ThumbnailGenerator::originalFileSize() const
+int ThumbnailGenerator::maxThreadCount()
 {
-    return mOriginalFileSize;
+    return sThreadPool->maxThreadCount();
 }
 
-QString ThumbnailGenerator::originalMimeType() const
+bool ThumbnailGenerator::isRunning() const
 {
-    return mOriginalMimeType;
+    QMutexLocker lock(&mMutex);
+    return mTaskCount > 0;
 }
 
 bool ThumbnailGenerator::testCancel()
@@ -246,77 +538,64 @@ void ThumbnailGenerator::cancel()
 {
     QMutexLocker lock(&mMutex);
     mCancel = true;
-    mCond.wakeOne();
+    mResults.clear();
 }
 
-void ThumbnailGenerator::run()
+void ThumbnailGenerator::deleteWhenIdle()
 {
-    LOG("");
-    while (!testCancel()) {
-        QString pixPath;
-        int pixelSize;
-        {
-            QMutexLocker lock(&mMutex);
-            // empty mPixPath means nothing to do
-            LOG("Waiting for mPixPath");
-            if (mPixPath.isNull()) {
-                LOG("mPixPath.isNull");
-                mCond.wait(&mMutex);
-            }
-        }
-        if (testCancel()) {
-            return;
-        }
-        {
-            QMutexLocker lock(&mMutex);
-            pixPath = mPixPath;
-            pixelSize = ThumbnailGroup::pixelSize(mThumbnailGroup);
-        }
+    QMutexLocker lock(&mMutex);
+    mCancel = true;
+    mDeleteWhenIdle = true;
+    mResults.clear();
+    if (mTaskCount == 0) {
+        deleteLater();
+    }
+}
 
-        Q_ASSERT(!pixPath.isNull());
-        LOG("Loading" << pixPath);
-        ThumbnailContext context;
-        bool ok = context.load(pixPath, pixelSize);
-
-        {
-            QMutexLocker lock(&mMutex);
-            if (ok) {
-                mImage = context.mImage;
-                mOriginalWidth = context.mOriginalWidth;
-                mOriginalHeight = context.mOriginalHeight;
-                if (context.mNeedCaching) {
-                    cacheThumbnail();
-                }
-            } else {
-                qWarning() << "Could not generate thumbnail for file" << mOriginalUri;
-            }
-            mPixPath.clear(); // done, ready for next
-        }
-        if (testCancel()) {
+void ThumbnailGenerator::deliver(const ThumbnailResult& result)
+{
+    bool scheduleFlush;
+    {
+        QMutexLocker lock(&mMutex);
+        if (mCancel) {
             return;
         }
-        {
-            QSize size(mOriginalWidth, mOriginalHeight);
-            LOG("emitting done signal, size=" << size);
-            QMutexLocker lock(&mMutex);
-            done(mImage, size);
-            LOG("Done");
-        }
+        mResults << result;
+        scheduleFlush = !mFlushScheduled;
+        mFlushScheduled = true;
+    }
+    if (scheduleFlush) {
+        QMetaObject::invokeMethod(this, "flushResults", Qt::QueuedConnection);
+    }
+}
+
+void ThumbnailGenerator::flushResults()
+{
+    QList<ThumbnailResult> results;
+    {
+        QMutexLocker lock(&mMutex);
+        results.swap(mResults);
+        mFlushScheduled = false;
+    }
+    if (!results.isEmpty()) {
+        LOG("Delivering" << results.count() << "results");
+        emit thumbnailsReady(results);
     }
-    LOG("Ending thread");
 }
 
-void ThumbnailGenerator::cacheThumbnail()
+void ThumbnailGenerator::taskFinished()
 {
-    mImage.setText("Thumb::URI"          , mOriginalUri);
-    mImage.setText("Thumb::MTime"        , QString::number(mOriginalTime));
-    mImage.setText("Thumb::Size"         , QString::number(mOriginalFileSize));
-    mImage.setText("Thumb::Mimetype"     , mOriginalMimeType);
-    mImage.setText("Thumb::Image::Width" , QString::number(mOriginalWidth));
-    mImage.setText("Thumb::Image::Height", QString::number(mOriginalHeight));
-    mImage.setText("Software"            , QStringLiteral("Gwenview"));
-
-    emit thumbnailReadyToBeCached(mThumbnailPath, mImage);
+    bool deleteGenerator;
+    {
+        QMutexLocker lock(&mMutex);
+        --mTaskCount;
+        deleteGenerator = mTaskCount == 0 && mDeleteWhenIdle;
+    }
+    // If deleteGenerator is false, deleteWhenIdle() may be called and delete
+    // the generator at any time from now, so do not touch it anymore
+    if (deleteGenerator) {
+        QMetaObject::invokeMethod(this, "deleteLater", Qt::QueuedConnection);
+    }
 }
 
 } // namespace
@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 #define THUMBNAILGENERATOR_H
 
 // Local
+#include <lib/gwenviewlib_export.h>
 #include <lib/thumbnailgroup.h>
 
 // KDE
@@ -29,14 +30,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 
 // Qt
 #include <QImage>
+#include <QList>
 #include <QMutex>
-#include <QThread>
-#include <QWaitCondition>
+#include <QStringList>
 
 namespace Gwenview
 {
 
-struct ThumbnailContext {
+struct GWENVIEWLIB_EXPORT ThumbnailContext {
     QImage mImage;
     int mOriginalWidth;
     int mOriginalHeight;
@@ -45,50 +46,146 @@ struct ThumbnailContext {
     bool load(const QString &pixPath, int pixelSize);
 };
 
-class ThumbnailGenerator : public QThread
+/**
+ * Describes what a ThumbnailGenerator task must do for an item
+ */
+struct ThumbnailRequest
+{
+    ThumbnailRequest()
+    : mOriginalTime(0)
+    , mOriginalFileSize(0)
+    , mThumbnailGroup(ThumbnailGroup::Normal)
+    , mStatOriginal(false)
+    , mCheckCache(false)
+    , mGenerate(false)
+    , mIsThumbnail(false)
+    , mFillPack(false)
+    {}
+
+    QString mOriginalUri;
+    time_t mOriginalTime;
+    KIO::filesize_t mOriginalFileSize;
+    QString mOriginalMimeType;
+    /// Path of the local copy of the original
+    QString mPixPath;
+    QString mThumbnailPath;
+    /// Paths of the thumbnails of the larger groups, from the smallest to the
+    /// largest. If there is no valid thumbnail at mThumbnailPath, it is
+    /// created from the first valid one.
+    QStringList mLargerThumbnailPaths;
+    ThumbnailGroup::Enum mThumbnailGroup;
+    /// Read mOriginalTime from mPixPath, for items whose modification time
+    /// is unknown
+    bool mStatOriginal;
+    /// Look for a valid thumbnail in the cache first
+    bool mCheckCache;
+    /// Generate the thumbnail from mPixPath if there is no valid cached one
+    bool mGenerate;
+    /// mPixPath is a thumbnail itself, it just needs to be loaded
+    bool mIsThumbnail;
+    /// Add thumbnails found in the disk cache to the ThumbnailPack of the
+    /// directory
+    bool mFillPack;
+};
+
+struct ThumbnailResult
+{
+    ThumbnailResult()
+    : mThumbnailGroup(ThumbnailGroup::Normal)
+    , mCacheMiss(false)
+    {}
+
+    QString mOriginalUri;
+    /// The group of the request, the provider may have changed its group
+    /// since
+    ThumbnailGroup::Enum mThumbnailGroup;
+    /// Null if the thumbnail could not be loaded or generated
+    QImage mImage;
+    QSize mOriginalSize;
+    /// True if there is no valid cached thumbnail and the request did not ask
+    /// for generation
+    bool mCacheMiss;
+};
+
+class ThumbnailPackTask;
+class ThumbnailTask;
+class ThumbnailWriter;
+
+/**
+ * Loads and generates thumbnails on a thread pool shared by all generators.
+ *
+ * Each call to load() queues a task, so several thumbnails can be handled
+ * at the same time. The pool uses one thread less than the number of cores,
+ * or the number of threads defined by the ThumbnailGenerationThreadCount
+ * config entry, and its threads run with a low priority so that the viewer
+ * remains responsive.
+ *
+ * Results are delivered in batches: all the results which became ready
+ * since the last time the event loop ran are emitted with one signal.
+ */
+class ThumbnailGenerator : public QObject
 {
     Q_OBJECT
 public:
-    ThumbnailGenerator();
+    /**
+     * @p writer is looked up before the disk cache, since it contains
+     * thumbnails which have not been written yet. Tasks hand the thumbnails
+     * they create to it, and wait if it has too many thumbnails to write.
+     */
+    explicit ThumbnailGenerator(ThumbnailWriter* writer);
+
+    void load(const ThumbnailRequest& request);
+
+    /**
+     * Looks up the thumbnails of @p requests in the pack at @p packPath, using
+     * one task. All requests must be for local files, only mOriginalUri,
+     * mPixPath, mOriginalFileSize and mThumbnailGroup are used. Thumbnails which are not in
+     * the pack are reported with mCacheMiss set.
+     */
+    void loadFromPack(const QString& packPath, const QList<ThumbnailRequest>& requests);
+
+    /**
+     * Drop queued tasks. Running tasks are completed but their results are
+     * not emitted.
+     */
+    void cancel();
 
-    void load(
-        const QString& originalUri,
-        time_t originalTime,
-        KIO::filesize_t originalFileSize,
-        const QString& originalMimeType,
-        const QString& pixPath,
-        const QString& thumbnailPath,
-        ThumbnailGroup::Enum group);
+    /**
+     * Cancels the generator and deletes it as soon as all its running tasks
+     * are over. Use this instead of deleting the generator.
+     */
+    void deleteWhenIdle();
 
-    void cancel();
+    /**
+     * Returns true if some tasks are queued or running
+     */
+    bool isRunning() const;
 
-    QString originalUri() const;
-    time_t originalTime() const;
-    KIO::filesize_t originalFileSize() const;
-    QString originalMimeType() const;
-protected:
-    virtual void run() Q_DECL_OVERRIDE;
+    /**
+     * How many tasks can run at the same time
+     */
+    static int maxThreadCount();
 
 Q_SIGNALS:
-    void done(const QImage&, const QSize&);
-    void thumbnailReadyToBeCached(const QString& thumbnailPath, const QImage&);
+    void thumbnailsReady(const QList<ThumbnailResult>&);
+
+private Q_SLOTS:
+    void flushResults();
 
 private:
+    friend class ThumbnailPackTask;
+    friend class ThumbnailTask;
     bool testCancel();
-    void cacheThumbnail();
-    QImage mImage;
-    QString mPixPath;
-    QString mThumbnailPath;
-    QString mOriginalUri;
-    time_t mOriginalTime;
-    KIO::filesize_t mOriginalFileSize;
-    QString mOriginalMimeType;
-    int mOriginalWidth;
-    int mOriginalHeight;
-    QMutex mMutex;
-    QWaitCondition mCond;
-    ThumbnailGroup::Enum mThumbnailGroup;
+    void deliver(const ThumbnailResult& result);
+    void taskStarted();
+    void taskFinished();
+    ThumbnailWriter* const mWriter;
+    mutable QMutex mMutex;
+    QList<ThumbnailResult> mResults;
+    bool mFlushScheduled;
+    int mTaskCount;
     bool mCancel;
+    bool mDeleteWhenIdle;
 };
 
 } // namespace
@@ -0,0 +1,132 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+// Self
+#include "thumbnailitemqueue.h"
+
+// Local
+#include <lib/gvdebug.h>
+
+namespace Gwenview
+{
+
+ThumbnailItemQueue::ThumbnailItemQueue()
+: mFirstPosition(0)
+, mLastPosition(-1)
+{
+}
+
+bool ThumbnailItemQueue::isEmpty() const
+{
+    return mPositionForUrl.isEmpty();
+}
+
+int ThumbnailItemQueue::count() const
+{
+    return mPositionForUrl.count();
+}
+
+bool ThumbnailItemQueue::contains(const QUrl& url) const
+{
+    return mPositionForUrl.contains(url);
+}
+
+bool ThumbnailItemQueue::append(const KFileItem& item)
+{
+    const QUrl url = item.url();
+    if (mPositionForUrl.contains(url)) {
+        return false;
+    }
+    ++mLastPosition;
+    mItemForPosition.insert(mLastPosition, item);
+    mPositionForUrl.insert(url, mLastPosition);
+    return true;
+}
+
+void ThumbnailItemQueue::prepend(const KFileItemList& items)
+{
+    // Insert the last item first, so that the first item ends up at the front
+    for (int idx = items.count() - 1; idx >= 0; --idx) {
+        remove(items.at(idx).url());
+        insertFirst(items.at(idx));
+    }
+}
+
+void ThumbnailItemQueue::prioritize(const QList<QUrl>& urls)
+{
+    for (int idx = urls.count() - 1; idx >= 0; --idx) {
+        QHash<QUrl, qint64>::Iterator it = mPositionForUrl.find(urls.at(idx));
+        if (it == mPositionForUrl.end()) {
+            continue;
+        }
+        const KFileItem item = mItemForPosition.take(it.value());
+        mPositionForUrl.erase(it);
+        insertFirst(item);
+    }
+}
+
+bool ThumbnailItemQueue::remove(const QUrl& url)
+{
+    QHash<QUrl, qint64>::Iterator it = mPositionForUrl.find(url);
+    if (it == mPositionForUrl.end()) {
+        return false;
+    }
+    mItemForPosition.remove(it.value());
+    mPositionForUrl.erase(it);
+    return true;
+}
+
+KFileItem ThumbnailItemQueue::takeFirst()
+{
+    GV_RETURN_VALUE_IF_FAIL(!isEmpty(), KFileItem());
+    QMap<qint64, KFileItem>::Iterator it = mItemForPosition.begin();
+    const KFileItem item = it.value();
+    mItemForPosition.erase(it);
+    mPositionForUrl.remove(item.url());
+    return item;
+}
+
+void ThumbnailItemQueue::clear()
+{
+    mItemForPosition.clear();
+    mPositionForUrl.clear();
+    mFirstPosition = 0;
+    mLastPosition = -1;
+}
+
+KFileItemList ThumbnailItemQueue::items() const
+{
+    KFileItemList list;
+    list.reserve(mItemForPosition.count());
+    QMap<qint64, KFileItem>::ConstIterator it = mItemForPosition.constBegin(), end = mItemForPosition.constEnd();
+    for (; it != end; ++it) {
+        list << it.value();
+    }
+    return list;
+}
+
+void ThumbnailItemQueue::insertFirst(const KFileItem& item)
+{
+    --mFirstPosition;
+    mItemForPosition.insert(mFirstPosition, item);
+    mPositionForUrl.insert(item.url(), mFirstPosition);
+}
+
+} // namespace
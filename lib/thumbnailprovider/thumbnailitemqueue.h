@@ -0,0 +1,104 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#ifndef THUMBNAILITEMQUEUE_H
+#define THUMBNAILITEMQUEUE_H
+
+#include <lib/gwenviewlib_export.h>
+
+// KDE
+#include <KFileItem>
+
+// Qt
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QUrl>
+
+namespace Gwenview
+{
+
+/**
+ * The items waiting for their thumbnail, in the order they must be handled.
+ *
+ * Items are indexed by url, so that looking them up, removing them and
+ * moving them to the front takes O(log n) time, whatever the number of items.
+ * An url is never queued twice.
+ */
+class GWENVIEWLIB_EXPORT ThumbnailItemQueue
+{
+public:
+    ThumbnailItemQueue();
+
+    bool isEmpty() const;
+
+    int count() const;
+
+    bool contains(const QUrl& url) const;
+
+    /**
+     * Adds @p item after the other items. Does nothing and returns false if
+     * its url is already queued.
+     */
+    bool append(const KFileItem& item);
+
+    /**
+     * Moves @p items before the other items, in this order. Items which are
+     * not queued yet are added.
+     */
+    void prepend(const KFileItemList& items);
+
+    /**
+     * Moves the items of @p urls before the other items, in this order.
+     * Urls which are not queued are ignored.
+     */
+    void prioritize(const QList<QUrl>& urls);
+
+    /**
+     * Returns false if @p url was not queued
+     */
+    bool remove(const QUrl& url);
+
+    /**
+     * Removes the first item and returns it. The queue must not be empty.
+     */
+    KFileItem takeFirst();
+
+    void clear();
+
+    /**
+     * Returns the queued items, in order
+     */
+    KFileItemList items() const;
+
+private:
+    void insertFirst(const KFileItem& item);
+
+    /// Position => item. Positions before mFirstPosition and after
+    /// mLastPosition are free.
+    QMap<qint64, KFileItem> mItemForPosition;
+    QHash<QUrl, qint64> mPositionForUrl;
+    qint64 mFirstPosition;
+    qint64 mLastPosition;
+};
+
+} // namespace
+
+#endif /* THUMBNAILITEMQUEUE_H */
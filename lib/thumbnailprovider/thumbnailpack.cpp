@@ -0,0 +1,515 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+// Self
+#include "thumbnailpack.h"
+
+// Local
+#include "traceutils.h"
+
+// KDE
+
+// Qt
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QCache>
+#include <QDateTime>
+#include <QLockFile>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSharedPointer>
+
+namespace Gwenview
+{
+
+#undef ENABLE_LOG
+#undef LOG
+//#define ENABLE_LOG
+#ifdef ENABLE_LOG
+#define LOG(x) qDebug() << x
+#else
+#define LOG(x) ;
+#endif
+
+/*
+ * File layout, all numbers are in host byte order:
+ *
+ * FileHeader
+ * Record 1: RecordHeader, UTF-8 uri, pixels
+ * Record 2: ...
+ *
+ * The uri and the pixels are padded so that each part of a record starts on
+ * an 8 byte boundary.
+ */
+static const char MAGIC[8] = { 'G', 'V', 'T', 'P', 'A', 'C', 'K', '\0' };
+static const quint32 VERSION = 1;
+static const quint32 BYTE_ORDER_MARK = 0x01020304;
+static const quint32 RECORD_MAGIC = 0x47565452; // "GVTR"
+
+/** Do not bother compacting packs smaller than this */
+static const qint64 COMPACT_MIN_SIZE = 4 * 1024 * 1024;
+
+/** How long to wait for another process writing to the pack, in ms */
+static const int LOCK_TIMEOUT = 2000;
+
+/** How many opened packs ThumbnailPack::cached() keeps */
+static const int CACHED_PACK_COUNT = 16;
+
+struct FileHeader
+{
+    char mMagic[8];
+    quint32 mVersion;
+    quint32 mByteOrderMark;
+};
+
+struct RecordHeader
+{
+    quint32 mMagic;
+    quint32 mUriSize;
+    quint64 mOriginalTime;
+    quint64 mOriginalFileSize;
+    qint32 mOriginalWidth;
+    qint32 mOriginalHeight;
+    qint32 mWidth;
+    qint32 mHeight;
+    qint32 mBytesPerLine;
+    quint32 mFormat;
+};
+
+inline qint64 padded(qint64 size)
+{
+    return (size + 7) & ~qint64(7);
+}
+
+/**
+ * Returns the size of a pixel of the formats append() writes, 0 for any
+ * other format
+ */
+static int bytesPerPixel(quint32 format)
+{
+    switch (format) {
+    case QImage::Format_RGB888:
+        return 3;
+    case QImage::Format_ARGB32_Premultiplied:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+struct PackEntry
+{
+    qint64 mRecordOffset;
+    qint64 mRecordSize;
+    RecordHeader mHeader;
+
+    qint64 dataOffset() const
+    {
+        return mRecordOffset + sizeof(RecordHeader) + padded(mHeader.mUriSize);
+    }
+};
+
+/**
+ * Keeps the file mapped as long as images refer to it
+ */
+struct PackMapping
+{
+    QFile mFile;
+    const uchar* mData;
+    qint64 mSize;
+
+    PackMapping(const QString& path)
+    : mFile(path)
+    , mData(0)
+    , mSize(0)
+    {}
+};
+
+typedef QSharedPointer<PackMapping> PackMappingPtr;
+
+static void releaseMapping(void* info)
+{
+    delete static_cast<PackMappingPtr*>(info);
+}
+
+struct ThumbnailPackPrivate
+{
+    QString mPath;
+    PackMappingPtr mMapping;
+    QHash<QString, PackEntry> mIndex;
+    /// End of the last complete record
+    qint64 mValidEnd;
+    qint64 mLiveBytes;
+    qint64 mDeadBytes;
+
+    void clear()
+    {
+        mMapping.clear();
+        mIndex.clear();
+        mValidEnd = 0;
+        mLiveBytes = 0;
+        mDeadBytes = 0;
+    }
+
+    void addEntry(const QString& uri, const PackEntry& entry)
+    {
+        QHash<QString, PackEntry>::Iterator it = mIndex.find(uri);
+        if (it == mIndex.end()) {
+            mIndex.insert(uri, entry);
+        } else {
+            mDeadBytes += it.value().mRecordSize;
+            mLiveBytes -= it.value().mRecordSize;
+            it.value() = entry;
+        }
+        mLiveBytes += entry.mRecordSize;
+    }
+
+    bool load()
+    {
+        GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailPack::load", mPath);
+        clear();
+        PackMappingPtr mapping(new PackMapping(mPath));
+        if (!mapping->mFile.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        mapping->mSize = mapping->mFile.size();
+        if (mapping->mSize < qint64(sizeof(FileHeader))) {
+            return false;
+        }
+        mapping->mData = mapping->mFile.map(0, mapping->mSize);
+        if (!mapping->mData) {
+            qWarning() << "Could not map thumbnail pack" << mPath;
+            return false;
+        }
+
+        FileHeader fileHeader;
+        memcpy(&fileHeader, mapping->mData, sizeof(FileHeader));
+        if (memcmp(fileHeader.mMagic, MAGIC, sizeof(MAGIC)) != 0
+                || fileHeader.mVersion != VERSION
+                || fileHeader.mByteOrderMark != BYTE_ORDER_MARK) {
+            LOG("Invalid pack" << mPath);
+            return false;
+        }
+
+        qint64 offset = sizeof(FileHeader);
+        while (offset + qint64(sizeof(RecordHeader)) <= mapping->mSize) {
+            PackEntry entry;
+            memcpy(&entry.mHeader, mapping->mData + offset, sizeof(RecordHeader));
+            const RecordHeader& header = entry.mHeader;
+            const int bpp = bytesPerPixel(header.mFormat);
+            if (header.mMagic != RECORD_MAGIC || bpp == 0 || header.mWidth <= 0 || header.mHeight <= 0
+                    || qint64(header.mBytesPerLine) < qint64(header.mWidth) * bpp) {
+                break;
+            }
+            entry.mRecordOffset = offset;
+            entry.mRecordSize = sizeof(RecordHeader) + padded(header.mUriSize)
+                + padded(qint64(header.mBytesPerLine) * header.mHeight);
+            if (offset + entry.mRecordSize > mapping->mSize) {
+                // Incomplete record, the writing process probably crashed
+                break;
+            }
+            const char* uri = reinterpret_cast<const char*>(mapping->mData + offset + sizeof(RecordHeader));
+            addEntry(QString::fromUtf8(uri, header.mUriSize), entry);
+            offset += entry.mRecordSize;
+        }
+        mValidEnd = offset;
+        mMapping = mapping;
+        LOG(mPath << ":" << mIndex.count() << "entries");
+        return true;
+    }
+
+    static bool writeFileHeader(QIODevice* file)
+    {
+        FileHeader header;
+        memcpy(header.mMagic, MAGIC, sizeof(MAGIC));
+        header.mVersion = VERSION;
+        header.mByteOrderMark = BYTE_ORDER_MARK;
+        return file->write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    }
+
+    static bool writePadding(QIODevice* file, qint64 size)
+    {
+        const qint64 padding = padded(size) - size;
+        return padding == 0 || file->write(QByteArray(padding, '\0')) == padding;
+    }
+
+    /**
+     * Rewrites the file with live entries only. Must be called with the lock
+     * held and the file loaded.
+     */
+    void compact()
+    {
+        GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailPack::compact", mPath);
+        if (!load()) {
+            return;
+        }
+        // Do not truncate the file: other instances may have mapped it.
+        // Write a new one and replace the old one instead.
+        QSaveFile file(mPath);
+        if (!file.open(QIODevice::WriteOnly) || !writeFileHeader(&file)) {
+            qWarning() << "Could not compact thumbnail pack" << mPath;
+            return;
+        }
+        Q_FOREACH(const PackEntry& entry, mIndex) {
+            const char* data = reinterpret_cast<const char*>(mMapping->mData + entry.mRecordOffset);
+            if (file.write(data, entry.mRecordSize) != entry.mRecordSize) {
+                qWarning() << "Could not compact thumbnail pack" << mPath;
+                file.cancelWriting();
+                break;
+            }
+        }
+        file.commit();
+        load();
+    }
+};
+
+/**
+ * Opened packs, so that looking up the thumbnails of a directory does not map
+ * and index its pack again each time
+ */
+struct CachedPack
+{
+    QSharedPointer<const ThumbnailPack> mPack;
+    qint64 mFileSize;
+    QDateTime mLastModified;
+};
+
+struct PackCache
+{
+    QMutex mMutex;
+    QCache<QString, CachedPack> mPacks;
+
+    PackCache()
+    : mPacks(CACHED_PACK_COUNT)
+    {}
+};
+
+Q_GLOBAL_STATIC(PackCache, sPackCache)
+
+ThumbnailPack::ThumbnailPack(const QString& path)
+: d(new ThumbnailPackPrivate)
+{
+    d->mPath = path;
+    d->clear();
+}
+
+ThumbnailPack::~ThumbnailPack()
+{
+    delete d;
+}
+
+QString ThumbnailPack::packPath(const QString& groupDir, const QString& originalUri)
+{
+    // Packs of "<base>/normal/" go to "<base>/gwenview-packs/normal/", so that
+    // the freedesktop.org thumbnail dirs only contain what the spec expects
+    QString dir = groupDir;
+    if (dir.endsWith(QLatin1Char('/'))) {
+        dir.chop(1);
+    }
+    const int pos = dir.lastIndexOf(QLatin1Char('/'));
+    const QString packDir = dir.left(pos + 1) + QStringLiteral("gwenview-packs/") + dir.mid(pos + 1) + QLatin1Char('/');
+
+    const QString dirUri = originalUri.left(originalUri.lastIndexOf(QLatin1Char('/')));
+    QCryptographicHash md5(QCryptographicHash::Md5);
+    md5.addData(QFile::encodeName(dirUri));
+    return packDir + QString::fromLatin1(md5.result().toHex()) + QStringLiteral(".pack");
+}
+
+QString ThumbnailPack::path() const
+{
+    return d->mPath;
+}
+
+bool ThumbnailPack::open()
+{
+    return d->load();
+}
+
+QSharedPointer<const ThumbnailPack> ThumbnailPack::cached(const QString& path)
+{
+    // Another process may have written to the pack since it was cached
+    const QFileInfo info(path);
+    const qint64 fileSize = info.size();
+    const QDateTime lastModified = info.lastModified();
+    {
+        QMutexLocker locker(&sPackCache->mMutex);
+        const CachedPack* cachedPack = sPackCache->mPacks.object(path);
+        if (cachedPack && cachedPack->mFileSize == fileSize && cachedPack->mLastModified == lastModified) {
+            return cachedPack->mPack;
+        }
+    }
+
+    QSharedPointer<ThumbnailPack> pack(new ThumbnailPack(path));
+    if (!pack->open()) {
+        return QSharedPointer<const ThumbnailPack>();
+    }
+    CachedPack* cachedPack = new CachedPack;
+    cachedPack->mPack = pack;
+    cachedPack->mFileSize = fileSize;
+    cachedPack->mLastModified = lastModified;
+    QMutexLocker locker(&sPackCache->mMutex);
+    sPackCache->mPacks.insert(path, cachedPack);
+    return pack;
+}
+
+void ThumbnailPack::uncache(const QString& path)
+{
+    if (sPackCache.isDestroyed()) {
+        return;
+    }
+    QMutexLocker locker(&sPackCache->mMutex);
+    sPackCache->mPacks.remove(path);
+}
+
+int ThumbnailPack::count() const
+{
+    return d->mIndex.count();
+}
+
+QImage ThumbnailPack::image(const QString& originalUri, time_t originalTime, KIO::filesize_t originalFileSize, QSize* originalSize) const
+{
+    QHash<QString, PackEntry>::ConstIterator it = d->mIndex.constFind(originalUri);
+    if (it == d->mIndex.constEnd()) {
+        return QImage();
+    }
+    const PackEntry& entry = it.value();
+    const RecordHeader& header = entry.mHeader;
+    const qint64 dataEnd = entry.dataOffset() + qint64(header.mBytesPerLine) * header.mHeight;
+    if (!d->mMapping || dataEnd > d->mValidEnd || dataEnd > d->mMapping->mSize) {
+        // Entry has been appended after the file was mapped
+        return QImage();
+    }
+    if (bytesPerPixel(header.mFormat) == 0
+            || qint64(header.mBytesPerLine) < qint64(header.mWidth) * bytesPerPixel(header.mFormat)) {
+        return QImage();
+    }
+    if (qint64(header.mOriginalTime) != qint64(originalTime)
+            || (header.mOriginalFileSize != 0 && header.mOriginalFileSize != originalFileSize)) {
+        LOG("Outdated entry for" << originalUri);
+        return QImage();
+    }
+    if (originalSize) {
+        *originalSize = QSize(header.mOriginalWidth, header.mOriginalHeight);
+    }
+    return QImage(d->mMapping->mData + entry.dataOffset(),
+                  header.mWidth, header.mHeight, header.mBytesPerLine,
+                  QImage::Format(header.mFormat),
+                  releaseMapping, new PackMappingPtr(d->mMapping));
+}
+
+bool ThumbnailPack::append(const QString& originalUri, time_t originalTime, KIO::filesize_t originalFileSize, const QSize& originalSize, const QImage& image)
+{
+    GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailPack::append", originalUri);
+    if (image.isNull()) {
+        return false;
+    }
+    // Opaque thumbnails do not need an alpha channel, saves a quarter of the
+    // space
+    const QImage pixels = image.convertToFormat(image.hasAlphaChannel()
+                                                ? QImage::Format_ARGB32_Premultiplied
+                                                : QImage::Format_RGB888);
+    const QByteArray uri = originalUri.toUtf8();
+
+    RecordHeader header;
+    header.mMagic = RECORD_MAGIC;
+    header.mUriSize = uri.size();
+    header.mOriginalTime = originalTime;
+    header.mOriginalFileSize = originalFileSize;
+    header.mOriginalWidth = originalSize.width();
+    header.mOriginalHeight = originalSize.height();
+    header.mWidth = pixels.width();
+    header.mHeight = pixels.height();
+    header.mBytesPerLine = pixels.bytesPerLine();
+    header.mFormat = pixels.format();
+
+    const QString dir = QFileInfo(d->mPath).path();
+    if (!QFileInfo::exists(dir)) {
+        QDir().mkpath(dir);
+        QFile::setPermissions(dir, QFileDevice::WriteOwner | QFileDevice::ReadOwner | QFileDevice::ExeOwner);
+    }
+    QLockFile lock(d->mPath + QStringLiteral(".lock"));
+    if (!lock.tryLock(LOCK_TIMEOUT)) {
+        qWarning() << "Could not lock thumbnail pack" << d->mPath;
+        return false;
+    }
+
+    // Reload the index if another instance changed the file
+    if (d->mValidEnd == 0 || QFileInfo(d->mPath).size() != d->mValidEnd) {
+        if (!d->load()) {
+            d->clear();
+        }
+        // The writer does not need the mapping, only the index
+        d->mMapping.clear();
+    }
+
+    QFile file(d->mPath);
+    if (d->mValidEnd == 0) {
+        // Missing or invalid file, start a new one
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || !d->writeFileHeader(&file)) {
+            qWarning() << "Could not create thumbnail pack" << d->mPath;
+            return false;
+        }
+        file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+        d->mValidEnd = sizeof(FileHeader);
+    } else {
+        if (!file.open(QIODevice::ReadWrite) || !file.seek(d->mValidEnd)) {
+            qWarning() << "Could not open thumbnail pack" << d->mPath;
+            return false;
+        }
+    }
+
+    const qint64 pixelsSize = qint64(pixels.bytesPerLine()) * pixels.height();
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+        && file.write(uri) == uri.size()
+        && d->writePadding(&file, uri.size())
+        && file.write(reinterpret_cast<const char*>(pixels.constBits()), pixelsSize) == pixelsSize
+        && d->writePadding(&file, pixelsSize);
+    if (!ok) {
+        qWarning() << "Could not write to thumbnail pack" << d->mPath;
+        // Drop the incomplete record. Nothing refers to its bytes yet.
+        file.resize(d->mValidEnd);
+        return false;
+    }
+
+    PackEntry entry;
+    entry.mRecordOffset = d->mValidEnd;
+    entry.mRecordSize = file.pos() - d->mValidEnd;
+    entry.mHeader = header;
+    d->addEntry(originalUri, entry);
+    d->mValidEnd = file.pos();
+    if (file.size() > d->mValidEnd) {
+        // Leftovers of a crashed writer, which load() never indexes
+        file.resize(d->mValidEnd);
+    }
+    file.close();
+
+    if (d->mDeadBytes > d->mLiveBytes && d->mValidEnd > COMPACT_MIN_SIZE) {
+        d->compact();
+        d->mMapping.clear();
+    }
+    uncache(d->mPath);
+    return true;
+}
+
+} // namespace
@@ -0,0 +1,117 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+#ifndef THUMBNAILPACK_H
+#define THUMBNAILPACK_H
+
+#include <lib/gwenviewlib_export.h>
+
+// Local
+
+// KDE
+#include <KIO/Global>
+
+// Qt
+#include <QImage>
+#include <QSharedPointer>
+#include <QString>
+
+namespace Gwenview
+{
+
+struct ThumbnailPackPrivate;
+
+/**
+ * A file containing the thumbnails of all the images of a directory, for one
+ * thumbnail group.
+ *
+ * Thumbnails are stored as uncompressed pixels so that they can be used
+ * straight from the memory-mapped file, without opening, inflating and
+ * parsing one PNG per image. The pack complements the freedesktop.org
+ * thumbnail cache, it does not replace it.
+ *
+ * Entries are appended to the end of the file. When a thumbnail is stored
+ * again, the previous entry becomes dead; the file is rewritten when dead
+ * entries take more room than live ones.
+ *
+ * Images returned by image() refer to the mapped file, which stays mapped
+ * until all of them have been destroyed. Only the bytes following the last
+ * complete record, which no index refers to, are ever truncated in place;
+ * compacting replaces the file. These images thus remain valid even if
+ * another ThumbnailPack instance writes to it.
+ */
+class GWENVIEWLIB_EXPORT ThumbnailPack
+{
+public:
+    explicit ThumbnailPack(const QString& path);
+    ~ThumbnailPack();
+
+    /**
+     * Returns the path of the pack of the directory containing the image
+     * whose uri is @p originalUri. @p groupDir is the dir containing the
+     * thumbnails of the group, as returned by
+     * ThumbnailProvider::thumbnailBaseDir(group).
+     */
+    static QString packPath(const QString& groupDir, const QString& originalUri);
+
+    QString path() const;
+
+    /**
+     * Returns an opened pack for @p path, or a null pointer if it cannot be
+     * opened. Packs are kept open as long as their file does not change, so
+     * that lookups do not map and index the file each time.
+     */
+    static QSharedPointer<const ThumbnailPack> cached(const QString& path);
+
+    /**
+     * Drops the pack of @p path from the packs kept by cached(). Called by
+     * append().
+     */
+    static void uncache(const QString& path);
+
+    /**
+     * Maps the file in memory and reads the index. Returns false if the file
+     * does not exist or is not a valid pack.
+     */
+    bool open();
+
+    /**
+     * Returns the thumbnail of @p originalUri, or a null image if there is
+     * none or if it has been created for a different version of the file.
+     * The returned image shares its pixels with the mapped file.
+     */
+    QImage image(const QString& originalUri, time_t originalTime, KIO::filesize_t originalFileSize, QSize* originalSize) const;
+
+    /**
+     * Appends @p image as the thumbnail of @p originalUri. Safe to call while
+     * other processes use the pack.
+     */
+    bool append(const QString& originalUri, time_t originalTime, KIO::filesize_t originalFileSize, const QSize& originalSize, const QImage& image);
+
+    int count() const;
+
+private:
+    Q_DISABLE_COPY(ThumbnailPack)
+    ThumbnailPackPrivate* const d;
+};
+
+} // namespace
+
+#endif /* THUMBNAILPACK_H */
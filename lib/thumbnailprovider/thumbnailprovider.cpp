@@ -41,12 +41,18 @@
 // KDE
 #include <KIO/JobUiDelegate>
 #include <KIO/PreviewJob>
+#include <KIO/TransferJob>
 #include <KJobWidgets>
 
 // Local
+#include "gwenviewconfig.h"
+#include "jpegprefixchecker.h"
 #include "mimetypeutils.h"
+#include "thumbnailcache.h"
+#include "thumbnailpack.h"
 #include "thumbnailwriter.h"
 #include "thumbnailgenerator.h"
+#include "traceutils.h"
 #include "urlutils.h"
 
 namespace Gwenview
@@ -63,6 +69,35 @@ namespace Gwenview
 
 Q_GLOBAL_STATIC(ThumbnailWriter, sThumbnailWriter)
 
+// Preview jobs create thumbnails one item at a time: run a few of them, on
+// small batches so that prioritized items do not wait for long
+static const int MAX_PREVIEW_JOBS = 2;
+static const int PREVIEW_BATCH_SIZE = 8;
+
+// Property of the preview jobs, holding the group they create thumbnails for
+static const char* PREVIEW_GROUP_PROPERTY = "gvThumbnailGroup";
+
+/**
+ * A remote image being downloaded to a temporary file. JPEG images are
+ * checked as they arrive, the download stops as soon as the start of the
+ * file is enough to create the thumbnail.
+ */
+struct ThumbnailProvider::Download
+{
+    Download(int pixelSize, bool useEmbeddedThumbnail)
+    : mOriginalTime(0)
+    , mPrefixChecker(pixelSize, useEmbeddedThumbnail)
+    {}
+
+    KFileItem mItem;
+    QUrl mUrl;
+    time_t mOriginalTime;
+    QFile mFile;
+    // The data received so far, kept until mPrefixChecker has decided
+    QByteArray mPrefix;
+    JpegPrefixChecker mPrefixChecker;
+};
+
 static QString generateOriginalUri(const QUrl &url_)
 {
     QUrl url = url_;
@@ -77,6 +112,21 @@ static QString generateThumbnailPath(const QString& uri, ThumbnailGroup::Enum gr
     return baseDir + QFile::encodeName(md5.result().toHex()) + ".png";
 }
 
+/**
+ * Sets the modification time of @p request from @p item, which the dir
+ * lister has already read, so that the generator does not stat the original
+ * again. Only items without one are stat'ed.
+ */
+static void setOriginalTime(const KFileItem& item, ThumbnailRequest* request)
+{
+    const QDateTime time = item.time(KFileItem::ModificationTime);
+    if (time.isValid()) {
+        request->mOriginalTime = time.toTime_t();
+    } else {
+        request->mStatOriginal = true;
+    }
+}
+
 //------------------------------------------------------------------------
 //
 // ThumbnailProvider static methods
@@ -111,15 +161,29 @@ QString ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Enum group)
     case ThumbnailGroup::Large:
         dir += "large/";
         break;
+    case ThumbnailGroup::XLarge:
+        dir += "x-large/";
+        break;
+    case ThumbnailGroup::XXLarge:
+        dir += "xx-large/";
+        break;
     }
     return dir;
 }
 
+QString ThumbnailProvider::thumbnailPath(const QUrl& url, ThumbnailGroup::Enum group)
+{
+    const QString uri = generateOriginalUri(url.adjusted(QUrl::NormalizePathSegments));
+    return generateThumbnailPath(uri, group);
+}
+
 void ThumbnailProvider::deleteImageThumbnail(const QUrl &url)
 {
     QString uri = generateOriginalUri(url);
-    QFile::remove(generateThumbnailPath(uri, ThumbnailGroup::Normal));
-    QFile::remove(generateThumbnailPath(uri, ThumbnailGroup::Large));
+    for (int group = ThumbnailGroup::Normal; group <= ThumbnailGroup::XXLarge; ++group) {
+        QFile::remove(generateThumbnailPath(uri, ThumbnailGroup::Enum(group)));
+    }
+    ThumbnailCache::instance()->remove(url);
 }
 
 static void moveThumbnailHelper(const QString& oldUri, const QString& newUri, ThumbnailGroup::Enum group)
@@ -139,8 +203,9 @@ void ThumbnailProvider::moveThumbnail(const QUrl &oldUrl, const QUrl& newUrl)
 {
     QString oldUri = generateOriginalUri(oldUrl);
     QString newUri = generateOriginalUri(newUrl);
-    moveThumbnailHelper(oldUri, newUri, ThumbnailGroup::Normal);
-    moveThumbnailHelper(oldUri, newUri, ThumbnailGroup::Large);
+    for (int group = ThumbnailGroup::Normal; group <= ThumbnailGroup::XXLarge; ++group) {
+        moveThumbnailHelper(oldUri, newUri, ThumbnailGroup::Enum(group));
+    }
 }
 
 //------------------------------------------------------------------------
@@ -152,102 +217,379 @@ ThumbnailProvider::ThumbnailProvider()
 : KIO::Job()
 , mState(STATE_NEXTTHUMB)
 , mOriginalTime(0)
+, mFinishedEmitted(false)
 {
     LOG(this);
 
     // Make sure we have a place to store our thumbnails
-    QString thumbnailDirNormal = ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Normal);
-    QString thumbnailDirLarge = ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Large);
-    QDir().mkpath(thumbnailDirNormal);
-    QDir().mkpath(thumbnailDirLarge);
-    QFile::setPermissions(thumbnailDirNormal, QFileDevice::WriteOwner | QFileDevice::ReadOwner | QFileDevice::ExeOwner);
-    QFile::setPermissions(thumbnailDirLarge, QFileDevice::WriteOwner | QFileDevice::ReadOwner | QFileDevice::ExeOwner);
+    for (int group = ThumbnailGroup::Normal; group <= ThumbnailGroup::XXLarge; ++group) {
+        const QString thumbnailDir = ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Enum(group));
+        QDir().mkpath(thumbnailDir);
+        QFile::setPermissions(thumbnailDir, QFileDevice::WriteOwner | QFileDevice::ReadOwner | QFileDevice::ExeOwner);
+    }
 
     // Look for images and store the items in our todo list
     mCurrentItem = KFileItem();
     mThumbnailGroup = ThumbnailGroup::Large;
     createNewThumbnailGenerator();
+    sThumbnailWriter->setPackEnabled(GwenviewConfig::thumbnailPackEnabled());
+
+    ThumbnailCache* cache = ThumbnailCache::instance();
+    connect(cache, &ThumbnailCache::thumbnailInserted,
+            this, &ThumbnailProvider::slotCacheThumbnailInserted);
+    connect(cache, &ThumbnailCache::thumbnailLoadingFailed,
+            this, &ThumbnailProvider::slotCacheThumbnailLoadingFailed);
+    connect(cache, &ThumbnailCache::thumbnailLoadingCancelled,
+            this, &ThumbnailProvider::slotCacheThumbnailLoadingCancelled);
 }
 
 ThumbnailProvider::~ThumbnailProvider()
 {
     LOG(this);
     abortSubjob();
-    mThumbnailGenerator->cancel();
+    abortPreviewJobs();
+    abortDownloads();
     disconnect(mThumbnailGenerator, 0, this, 0);
-    disconnect(mThumbnailGenerator, 0, sThumbnailWriter, 0);
-    connect(mThumbnailGenerator, SIGNAL(finished()), mThumbnailGenerator, SLOT(deleteLater()));
-    if (mPreviousThumbnailGenerator) {
-        disconnect(mPreviousThumbnailGenerator, 0, sThumbnailWriter, 0);
-    }
-    sThumbnailWriter->wait();
+    mThumbnailGenerator->deleteWhenIdle();
+    cancelPendingThumbnails();
+    // Let other providers load the thumbnails we were loading
+    disconnect(ThumbnailCache::instance(), 0, this, 0);
+    ThumbnailCache::instance()->cancelLoading(this);
+    sThumbnailWriter->waitForDone();
 }
 
 void ThumbnailProvider::stop()
 {
-    // Clear mItems and create a new ThumbnailGenerator if mThumbnailGenerator is running,
-    // but also make sure that at most two ThumbnailGenerators are running.
-    // startCreatingThumbnail() will take care that these two threads won't work on the same item.
+    // Clear mItems and create a new ThumbnailGenerator if mThumbnailGenerator is running.
+    // Tasks already running on the old generator still store their thumbnails
+    // in the cache, so they are not lost.
     mItems.clear();
     abortSubjob();
-    if (mThumbnailGenerator->isRunning() && !mPreviousThumbnailGenerator) {
-        mPreviousThumbnailGenerator = mThumbnailGenerator;
-        mPreviousThumbnailGenerator->cancel();
-        disconnect(mPreviousThumbnailGenerator, 0, this, 0);
-        connect(mPreviousThumbnailGenerator, SIGNAL(finished()), mPreviousThumbnailGenerator, SLOT(deleteLater()));
+    abortPreviewJobs();
+    abortDownloads();
+    if (mThumbnailGenerator->isRunning()) {
+        disconnect(mThumbnailGenerator, 0, this, 0);
+        mThumbnailGenerator->deleteWhenIdle();
         createNewThumbnailGenerator();
         mCurrentItem = KFileItem();
+    } else if (mState == STATE_CHECKCACHE) {
+        // The cache lookup result has not been delivered yet, ignore it
+        mCurrentItem = KFileItem();
     }
+    cancelPendingThumbnails();
+    mWaitingItems.clear();
+    mCachedItems.clear();
+    ThumbnailCache::instance()->cancelLoading(this);
 }
 
-const KFileItemList& ThumbnailProvider::pendingItems() const
+KFileItemList ThumbnailProvider::pendingItems() const
 {
-    return mItems;
+    return mItems.items();
 }
 
 void ThumbnailProvider::setThumbnailGroup(ThumbnailGroup::Enum group)
 {
+    if (mThumbnailGroup == group) {
+        return;
+    }
+    // Thumbnails being loaded will not match what other providers wait for
+    ThumbnailCache::instance()->cancelLoading(this);
+    mWaitingItems.clear();
     mThumbnailGroup = group;
 }
 
 void ThumbnailProvider::appendItems(const KFileItemList& items)
 {
-    if (!mItems.isEmpty()) {
-        QSet<QString> itemSet;
-        Q_FOREACH(const KFileItem & item, mItems) {
-            itemSet.insert(item.url().url());
+    mFinishedEmitted = false;
+    KFileItemList newItems;
+    Q_FOREACH(const KFileItem & item, items) {
+        if (!mItems.contains(item.url())) {
+            newItems.append(item);
         }
+    }
 
-        Q_FOREACH(const KFileItem & item, items) {
-            if (!itemSet.contains(item.url().url())) {
-                mItems.append(item);
-            }
+    filterNewItems(&newItems);
+    Q_FOREACH(const KFileItem & item, newItems) {
+        mItems.append(item);
+    }
+
+    if (mCurrentItem.isNull()) {
+        determineNextIcon();
+    }
+}
+
+void ThumbnailProvider::prioritizeItems(const KFileItemList& items)
+{
+    mFinishedEmitted = false;
+    KFileItemList newItems;
+    QList<QUrl> previewUrls;
+    Q_FOREACH(const KFileItem& item, items) {
+        const QUrl url = item.url();
+        if (mPreviewItems.contains(url)) {
+            previewUrls << url;
+        } else if (!mItems.contains(url) && !mPreviewJobForUrl.contains(url)) {
+            newItems << item;
         }
-    } else {
-        mItems = items;
+    }
+    mPreviewItems.prioritize(previewUrls);
+
+    filterNewItems(&newItems);
+    QSet<QUrl> remainingUrls;
+    Q_FOREACH(const KFileItem& item, newItems) {
+        remainingUrls.insert(item.url());
     }
 
+    // Keep the order of @p items, skipping the ones which are handled
+    // elsewhere now
+    KFileItemList list;
+    Q_FOREACH(const KFileItem& item, items) {
+        const QUrl url = item.url();
+        if (mItems.contains(url) || remainingUrls.remove(url)) {
+            list << item;
+        }
+    }
+    mItems.prepend(list);
+
     if (mCurrentItem.isNull()) {
         determineNextIcon();
     }
 }
 
+void ThumbnailProvider::prioritize(const QList<QUrl>& urls)
+{
+    mItems.prioritize(urls);
+    mPreviewItems.prioritize(urls);
+}
+
+void ThumbnailProvider::filterNewItems(KFileItemList* items)
+{
+    takeCachedItems(items);
+    if (GwenviewConfig::thumbnailPackEnabled()) {
+        queuePackLookups(items);
+    }
+}
+
+void ThumbnailProvider::takeCachedItems(KFileItemList* items)
+{
+    ThumbnailCache* cache = ThumbnailCache::instance();
+    const bool emitScheduled = !mCachedItems.isEmpty();
+    KFileItemList remainingItems;
+    Q_FOREACH(const KFileItem& item, *items) {
+        if (cache->find(item, mThumbnailGroup, 0, 0)) {
+            mCachedItems << item;
+        } else if (cache->startLoading(item.url(), mThumbnailGroup, this)) {
+            remainingItems << item;
+        } else {
+            LOG("Another provider is loading" << item.url());
+            mWaitingItems.insert(item.url(), item);
+        }
+    }
+    *items = remainingItems;
+
+    // Emit asynchronously: the caller does not expect thumbnails to be
+    // loaded from appendItems()
+    if (!emitScheduled && !mCachedItems.isEmpty()) {
+        QMetaObject::invokeMethod(this, "emitCachedThumbnails", Qt::QueuedConnection);
+    }
+}
+
+void ThumbnailProvider::emitCachedThumbnails()
+{
+    ThumbnailCache* cache = ThumbnailCache::instance();
+    const KFileItemList items = mCachedItems;
+    mCachedItems.clear();
+    KFileItemList evictedItems;
+    Q_FOREACH(const KFileItem& item, items) {
+        QPixmap pixmap;
+        QSize originalSize;
+        if (cache->find(item, mThumbnailGroup, &pixmap, &originalSize)) {
+            emit thumbnailLoaded(item, pixmap, originalSize, item.size());
+        } else {
+            evictedItems << item;
+        }
+    }
+    if (!evictedItems.isEmpty()) {
+        appendItems(evictedItems);
+    } else if (mCurrentItem.isNull()) {
+        determineNextIcon();
+    }
+}
+
+void ThumbnailProvider::slotCacheThumbnailInserted(const QUrl& url, ThumbnailGroup::Enum group)
+{
+    if (group != mThumbnailGroup || !mWaitingItems.contains(url)) {
+        return;
+    }
+    const KFileItem item = mWaitingItems.take(url);
+    QPixmap pixmap;
+    QSize originalSize;
+    if (ThumbnailCache::instance()->find(item, group, &pixmap, &originalSize)) {
+        emit thumbnailLoaded(item, pixmap, originalSize, item.size());
+    } else {
+        // The thumbnail did not fit in the cache, or it is for another
+        // version of the file
+        queueAgain(item);
+    }
+    QMetaObject::invokeMethod(this, "resumeIfIdle", Qt::QueuedConnection);
+}
+
+void ThumbnailProvider::slotCacheThumbnailLoadingFailed(const QUrl& url, ThumbnailGroup::Enum group)
+{
+    if (group != mThumbnailGroup || !mWaitingItems.contains(url)) {
+        return;
+    }
+    emit thumbnailLoadingFailed(mWaitingItems.take(url));
+    QMetaObject::invokeMethod(this, "resumeIfIdle", Qt::QueuedConnection);
+}
+
+void ThumbnailProvider::slotCacheThumbnailLoadingCancelled(const QUrl& url, ThumbnailGroup::Enum group)
+{
+    if (group != mThumbnailGroup || !mWaitingItems.contains(url)) {
+        return;
+    }
+    queueAgain(mWaitingItems.take(url));
+    QMetaObject::invokeMethod(this, "resumeIfIdle", Qt::QueuedConnection);
+}
+
+void ThumbnailProvider::queueAgain(const KFileItem& item)
+{
+    mFinishedEmitted = false;
+    if (ThumbnailCache::instance()->startLoading(item.url(), mThumbnailGroup, this)) {
+        mItems.prepend(KFileItemList() << item);
+    } else {
+        // Yet another provider took over
+        mWaitingItems.insert(item.url(), item);
+    }
+}
+
+void ThumbnailProvider::queuePackLookups(KFileItemList* items)
+{
+    GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailProvider::queuePackLookups", QString::number(items->count()));
+    const QString groupDir = thumbnailBaseDir(mThumbnailGroup);
+    QHash<QString, QList<ThumbnailRequest> > requestsForPack;
+    QSet<QString> missingPacks;
+
+    KFileItemList remainingItems;
+    Q_FOREACH(const KFileItem& item, *items) {
+        const QUrl url = item.url().adjusted(QUrl::NormalizePathSegments);
+        if (!UrlUtils::urlIsFastLocalFile(url)
+                || MimeTypeUtils::fileItemKind(item) != MimeTypeUtils::KIND_RASTER_IMAGE) {
+            remainingItems << item;
+            continue;
+        }
+        ThumbnailRequest request;
+        request.mOriginalUri = generateOriginalUri(url);
+        const QString packPath = ThumbnailPack::packPath(groupDir, request.mOriginalUri);
+        if (mPendingThumbnails.contains(request.mOriginalUri) || missingPacks.contains(packPath)) {
+            remainingItems << item;
+            continue;
+        }
+        if (!requestsForPack.contains(packPath) && !QFile::exists(packPath)) {
+            missingPacks.insert(packPath);
+            remainingItems << item;
+            continue;
+        }
+        request.mPixPath = url.toLocalFile();
+        request.mOriginalFileSize = item.size();
+        setOriginalTime(item, &request);
+        request.mThumbnailGroup = mThumbnailGroup;
+        requestsForPack[packPath] << request;
+
+        PendingThumbnail pending;
+        pending.mItem = item;
+        pending.mOriginalFileSize = request.mOriginalFileSize;
+        pending.mThumbnailGroup = mThumbnailGroup;
+        mPendingThumbnails.insert(request.mOriginalUri, pending);
+    }
+    *items = remainingItems;
+
+    QHash<QString, QList<ThumbnailRequest> >::ConstIterator packIt = requestsForPack.constBegin(), end = requestsForPack.constEnd();
+    for (; packIt != end; ++packIt) {
+        LOG("Looking up" << packIt.value().count() << "thumbnails in" << packIt.key());
+        mThumbnailGenerator->loadFromPack(packIt.key(), packIt.value());
+    }
+}
+
 void ThumbnailProvider::removeItems(const KFileItemList& itemList)
 {
-    if (mItems.isEmpty()) {
+    if (!isRunning() && mItems.isEmpty()) {
         return;
     }
+    ThumbnailCache* cache = ThumbnailCache::instance();
+    QSet<QUrl> removedUrls;
     Q_FOREACH(const KFileItem & item, itemList) {
-        // If we are removing the next item, update to be the item after or the
-        // first if we removed the last item
-        mItems.removeAll(item);
+        removedUrls.insert(item.url());
+        mItems.remove(item.url());
+        mWaitingItems.remove(item.url());
+        mPreviewItems.remove(item.url());
+        mPreviewJobForUrl.remove(item.url());
+        cache->cancelLoading(item.url(), mThumbnailGroup, this);
 
         if (item == mCurrentItem) {
             abortSubjob();
+            if (mState == STATE_CHECKCACHE) {
+                // The cache lookup result will be ignored
+                mCurrentItem = KFileItem();
+            }
+        }
+    }
+
+    if (!mCachedItems.isEmpty()) {
+        KFileItemList cachedItems;
+        Q_FOREACH(const KFileItem& item, mCachedItems) {
+            if (!removedUrls.contains(item.url())) {
+                cachedItems << item;
+            }
+        }
+        mCachedItems = cachedItems;
+    }
+
+    // Kill the preview jobs which have nothing left to do. The other ones
+    // carry on, slotGotPreview() ignores the removed items.
+    Q_FOREACH(KJob* job, mPreviewJobs) {
+        if (mPreviewJobForUrl.key(job).isEmpty()) {
+            mPreviewJobs.removeOne(job);
+            job->kill();
+        }
+    }
+
+    QHash<KJob*, Download*>::Iterator downloadIt = mDownloads.begin();
+    while (downloadIt != mDownloads.end()) {
+        Download* download = downloadIt.value();
+        if (removedUrls.contains(download->mItem.url())) {
+            downloadIt.key()->kill();
+            download->mFile.remove();
+            delete download;
+            downloadIt = mDownloads.erase(downloadIt);
+        } else {
+            ++downloadIt;
         }
     }
 
-    // No more current item, carry on to the next remaining item
+    // Forget about items whose thumbnail is being generated,
+    // slotThumbnailsReady() will ignore them
+    QHash<QString, PendingThumbnail>::Iterator it = mPendingThumbnails.begin();
+    while (it != mPendingThumbnails.end()) {
+        if (removedUrls.contains(it.value().mItem.url())) {
+            if (!it.value().mTempPath.isEmpty()) {
+                QFile::remove(it.value().mTempPath);
+            }
+            it = mPendingThumbnails.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // No more current item, carry on to the next remaining item. Do it
+    // asynchronously: the caller does not expect finished() to be emitted
+    // from here.
+    if (mCurrentItem.isNull()) {
+        QMetaObject::invokeMethod(this, "resumeIfIdle", Qt::QueuedConnection);
+    }
+}
+
+void ThumbnailProvider::resumeIfIdle()
+{
     if (mCurrentItem.isNull()) {
         determineNextIcon();
     }
@@ -255,25 +597,27 @@ void ThumbnailProvider::removeItems(const KFileItemList& itemList)
 
 void ThumbnailProvider::removePendingItems()
 {
+    ThumbnailCache* cache = ThumbnailCache::instance();
+    Q_FOREACH(const KFileItem& item, mItems.items()) {
+        cache->cancelLoading(item.url(), mThumbnailGroup, this);
+    }
     mItems.clear();
 }
 
 bool ThumbnailProvider::isRunning() const
 {
-    return !mCurrentItem.isNull();
+    return !mCurrentItem.isNull() || !mPendingThumbnails.isEmpty()
+        || !mWaitingItems.isEmpty() || !mCachedItems.isEmpty()
+        || !mPreviewItems.isEmpty() || !mPreviewJobs.isEmpty()
+        || !mDownloads.isEmpty();
 }
 
 //-Internal--------------------------------------------------------------
 void ThumbnailProvider::createNewThumbnailGenerator()
 {
-    mThumbnailGenerator = new ThumbnailGenerator;
-    connect(mThumbnailGenerator, SIGNAL(done(QImage,QSize)),
-            SLOT(thumbnailReady(QImage,QSize)),
-            Qt::QueuedConnection);
-
-    connect(mThumbnailGenerator, SIGNAL(thumbnailReadyToBeCached(QString,QImage)),
-            sThumbnailWriter, SLOT(queueThumbnail(QString,QImage)),
-            Qt::QueuedConnection);
+    mThumbnailGenerator = new ThumbnailGenerator(sThumbnailWriter);
+    connect(mThumbnailGenerator, &ThumbnailGenerator::thumbnailsReady,
+            this, &ThumbnailProvider::slotThumbnailsReady);
 }
 
 void ThumbnailProvider::abortSubjob()
@@ -287,39 +631,166 @@ void ThumbnailProvider::abortSubjob()
     }
 }
 
+void ThumbnailProvider::abortPreviewJobs()
+{
+    Q_FOREACH(KJob* job, mPreviewJobs) {
+        LOG("Killing preview job");
+        job->kill();
+    }
+    mPreviewJobs.clear();
+    mPreviewJobForUrl.clear();
+    mPreviewItems.clear();
+}
+
+void ThumbnailProvider::abortDownloads()
+{
+    QHash<KJob*, Download*>::ConstIterator it = mDownloads.constBegin(), end = mDownloads.constEnd();
+    for (; it != end; ++it) {
+        LOG("Killing download of" << it.value()->mUrl);
+        it.key()->kill();
+        it.value()->mFile.remove();
+        delete it.value();
+    }
+    mDownloads.clear();
+}
+
+void ThumbnailProvider::startPreviewJobs()
+{
+    if (mPreviewPlugins.isEmpty() && !mPreviewItems.isEmpty()) {
+        mPreviewPlugins = KIO::PreviewJob::availablePlugins();
+    }
+    const int pixelSize = ThumbnailGroup::pixelSize(mThumbnailGroup);
+    while (!mPreviewItems.isEmpty() && mPreviewJobs.count() < MAX_PREVIEW_JOBS) {
+        KFileItemList list;
+        while (!mPreviewItems.isEmpty() && list.count() < PREVIEW_BATCH_SIZE) {
+            list << mPreviewItems.takeFirst();
+        }
+        LOG("Starting a KPreviewJob for" << list.count() << "items");
+        KIO::Job* job = KIO::filePreview(list, QSize(pixelSize, pixelSize), &mPreviewPlugins);
+        job->setProperty(PREVIEW_GROUP_PROPERTY, int(mThumbnailGroup));
+        //KJobWidgets::setWindow(job, qApp->activeWindow());
+        connect(job, SIGNAL(gotPreview(KFileItem,QPixmap)),
+                this, SLOT(slotGotPreview(KFileItem,QPixmap)));
+        connect(job, SIGNAL(failed(KFileItem)),
+                this, SLOT(slotPreviewFailed(KFileItem)));
+        connect(job, SIGNAL(result(KJob*)),
+                this, SLOT(slotPreviewJobResult(KJob*)));
+        Q_FOREACH(const KFileItem& item, list) {
+            mPreviewJobForUrl.insert(item.url(), job);
+        }
+        mPreviewJobs << job;
+    }
+}
+
+void ThumbnailProvider::cancelPendingThumbnails()
+{
+    Q_FOREACH(const PendingThumbnail& pending, mPendingThumbnails) {
+        if (!pending.mTempPath.isEmpty()) {
+            QFile::remove(pending.mTempPath);
+        }
+    }
+    mPendingThumbnails.clear();
+}
+
 void ThumbnailProvider::determineNextIcon()
 {
     LOG(this);
     mState = STATE_NEXTTHUMB;
 
-    // No more items ?
-    if (mItems.isEmpty()) {
-        LOG("No more items. Nothing to do");
-        mCurrentItem = KFileItem();
-        finished();
-        return;
-    }
+    while (!mItems.isEmpty()) {
+        // Keep the generator busy, but do not queue more: pending items can
+        // still be removed. slotThumbnailsReady() calls us again.
+        if (mPendingThumbnails.count() >= ThumbnailGenerator::maxThreadCount() * 2) {
+            LOG("Waiting for the generator");
+            mCurrentItem = KFileItem();
+            return;
+        }
 
-    mCurrentItem = mItems.takeFirst();
-    LOG("mCurrentItem.url=" << mCurrentItem.url());
+        KFileItem item = mItems.takeFirst();
+        if (queueLocalItem(item)) {
+            continue;
+        }
+        if (mDownloads.count() >= GwenviewConfig::thumbnailDownloadCount()) {
+            // slotDownloadResult() calls us again
+            LOG("Waiting for downloads");
+            mItems.prepend(KFileItemList() << item);
+            mCurrentItem = KFileItem();
+            return;
+        }
 
-    // First, stat the orig file
-    mState = STATE_STATORIG;
-    mCurrentUrl = mCurrentItem.url().adjusted(QUrl::NormalizePathSegments);
-    mOriginalFileSize = mCurrentItem.size();
+        // Other items go through KIO, handle them one at a time
+        mCurrentItem = item;
+        LOG("mCurrentItem.url=" << mCurrentItem.url());
+
+        // First, stat the orig file
+        mState = STATE_STATORIG;
+        mCurrentUrl = mCurrentItem.url().adjusted(QUrl::NormalizePathSegments);
+        mOriginalFileSize = mCurrentItem.size();
 
-    // Do direct stat instead of using KIO if the file is local (faster)
-    if (UrlUtils::urlIsFastLocalFile(mCurrentUrl)) {
-        QFileInfo fileInfo(mCurrentUrl.toLocalFile());
-        mOriginalTime = fileInfo.lastModified().toTime_t();
-        QMetaObject::invokeMethod(this, "checkThumbnail", Qt::QueuedConnection);
-    } else {
         KIO::Job* job = KIO::stat(mCurrentUrl, KIO::HideProgressInfo);
         KJobWidgets::setWindow(job, qApp->activeWindow());
         LOG("KIO::stat orig" << mCurrentUrl.url());
         addSubjob(job);
+        LOG("/determineNextIcon" << this);
+        return;
+    }
+
+    LOG("No more items. Nothing to do");
+    mCurrentItem = KFileItem();
+    if (!isRunning() && !mFinishedEmitted) {
+        mFinishedEmitted = true;
+        finished();
+    }
+}
+
+ThumbnailRequest ThumbnailProvider::createRequest(const KFileItem& item, const QUrl& url) const
+{
+    ThumbnailRequest request;
+    request.mOriginalUri = generateOriginalUri(url);
+    request.mOriginalFileSize = item.size();
+    request.mOriginalMimeType = item.mimetype();
+    request.mThumbnailPath = generateThumbnailPath(request.mOriginalUri, mThumbnailGroup);
+    for (int group = mThumbnailGroup + 1; group <= ThumbnailGroup::XXLarge; ++group) {
+        request.mLargerThumbnailPaths << generateThumbnailPath(request.mOriginalUri, ThumbnailGroup::Enum(group));
+    }
+    request.mThumbnailGroup = mThumbnailGroup;
+    request.mCheckCache = true;
+    request.mFillPack = GwenviewConfig::thumbnailPackEnabled();
+    return request;
+}
+
+bool ThumbnailProvider::queueLocalItem(const KFileItem& item)
+{
+    const QUrl url = item.url().adjusted(QUrl::NormalizePathSegments);
+    if (!UrlUtils::urlIsFastLocalFile(url)) {
+        return false;
+    }
+
+    ThumbnailRequest request = createRequest(item, url);
+    if (mPendingThumbnails.contains(request.mOriginalUri)
+            || mPreviewItems.contains(item.url()) || mPreviewJobForUrl.contains(item.url())) {
+        // Item has been appended again while its thumbnail is being loaded
+        return true;
+    }
+    request.mPixPath = url.toLocalFile();
+    setOriginalTime(item, &request);
+
+    PendingThumbnail pending;
+    pending.mItem = item;
+    pending.mOriginalFileSize = request.mOriginalFileSize;
+    pending.mThumbnailGroup = request.mThumbnailGroup;
+    if (MimeTypeUtils::fileItemKind(item) == MimeTypeUtils::KIND_RASTER_IMAGE) {
+        // If we are in the thumbnail dir, just load the file
+        request.mIsThumbnail = url.adjusted(QUrl::RemoveFilename|QUrl::StripTrailingSlash).path().startsWith(thumbnailBaseDir());
+        request.mGenerate = true;
+    } else {
+        // Only look in the cache, a preview job creates the thumbnail on a
+        // miss
+        pending.mPreviewOnMiss = true;
     }
-    LOG("/determineNextIcon" << this);
+    mPendingThumbnails.insert(request.mOriginalUri, pending);
+    mThumbnailGenerator->load(request);
+    return true;
 }
 
 void ThumbnailProvider::slotResult(KJob * job)
@@ -330,6 +801,7 @@ void ThumbnailProvider::slotResult(KJob * job)
 
     switch (mState) {
     case STATE_NEXTTHUMB:
+    case STATE_CHECKCACHE:
         Q_ASSERT(false);
         determineNextIcon();
         return;
@@ -348,67 +820,76 @@ void ThumbnailProvider::slotResult(KJob * job)
         checkThumbnail();
         return;
     }
-
-    case STATE_DOWNLOADORIG:
-        if (job->error()) {
-            emitThumbnailLoadingFailed();
-            LOG("Delete temp file" << mTempPath);
-            QFile::remove(mTempPath);
-            mTempPath.clear();
-            determineNextIcon();
-        } else {
-            startCreatingThumbnail(mTempPath);
-        }
-        return;
-
-    case STATE_PREVIEWJOB:
-        determineNextIcon();
-        return;
     }
 }
 
-void ThumbnailProvider::thumbnailReady(const QImage& _img, const QSize& _size)
+void ThumbnailProvider::slotThumbnailsReady(const QList<ThumbnailResult>& results)
 {
-    QImage img = _img;
-    QSize size = _size;
-    if (!img.isNull()) {
-        emitThumbnailLoaded(img, size);
-    } else {
-        emitThumbnailLoadingFailed();
-    }
-    if (!mTempPath.isEmpty()) {
-        LOG("Delete temp file" << mTempPath);
-        QFile::remove(mTempPath);
-        mTempPath.clear();
-    }
-    determineNextIcon();
-}
-
-QImage ThumbnailProvider::loadThumbnailFromCache() const
-{
-    QImage image = sThumbnailWriter->value(mThumbnailPath);
-    if (!image.isNull()) {
-        return image;
-    }
+    GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailProvider::slotThumbnailsReady", QString::number(results.count()));
+    bool currentItemDone = false;
+    bool currentItemMiss = false;
+    bool currentItemStale = false;
+    bool pendingDone = false;
+    KFileItemList packMisses;
+    Q_FOREACH(const ThumbnailResult& result, results) {
+        if (mState == STATE_CHECKCACHE && !mCurrentItem.isNull() && result.mOriginalUri == mOriginalUri) {
+            if (result.mThumbnailGroup != mThumbnailGroup) {
+                // The group changed while the cache was checked
+                currentItemStale = true;
+            } else if (result.mCacheMiss) {
+                currentItemMiss = true;
+            } else {
+                emitThumbnailLoaded(result.mImage, result.mOriginalSize);
+                currentItemDone = true;
+            }
+            continue;
+        }
 
-    image = QImage(mThumbnailPath);
-    if (image.isNull() && mThumbnailGroup == ThumbnailGroup::Normal) {
-        // If there is a large-sized thumbnail, generate the normal-sized version from it
-        QString largeThumbnailPath = generateThumbnailPath(mOriginalUri, ThumbnailGroup::Large);
-        QImage largeImage(largeThumbnailPath);
-        if (largeImage.isNull()) {
-            return image;
+        QHash<QString, PendingThumbnail>::Iterator it = mPendingThumbnails.find(result.mOriginalUri);
+        if (it == mPendingThumbnails.end()) {
+            // Item has been removed by removeItems()
+            continue;
+        }
+        const PendingThumbnail pending = it.value();
+        mPendingThumbnails.erase(it);
+        pendingDone = true;
+
+        if (pending.mThumbnailGroup != mThumbnailGroup) {
+            // The thumbnail has the size of the previous group: keep it for
+            // that group, and load the one of the current group
+            if (!result.mImage.isNull()) {
+                ThumbnailCache::instance()->insert(pending.mItem, pending.mThumbnailGroup, QPixmap::fromImage(result.mImage), result.mOriginalSize);
+            }
+            queueAgain(pending.mItem);
+        } else if (result.mCacheMiss && pending.mPreviewOnMiss) {
+            mPreviewItems.append(pending.mItem);
+        } else if (result.mCacheMiss) {
+            // Not in the pack, go through the usual path
+            packMisses << pending.mItem;
+        } else if (!result.mImage.isNull()) {
+            emitThumbnailLoaded(pending.mItem, pending.mThumbnailGroup, result.mImage, result.mOriginalSize, pending.mOriginalFileSize);
+        } else {
+            emitThumbnailLoadingFailed(pending.mItem);
         }
-        int size = ThumbnailGroup::pixelSize(ThumbnailGroup::Normal);
-        image = largeImage.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-        Q_FOREACH(const QString& key, largeImage.textKeys()) {
-            QString text = largeImage.text(key);
-            image.setText(key, text);
+        if (!pending.mTempPath.isEmpty()) {
+            LOG("Delete temp file" << pending.mTempPath);
+            QFile::remove(pending.mTempPath);
         }
-        sThumbnailWriter->queueThumbnail(mThumbnailPath, image);
     }
 
-    return image;
+    if (!packMisses.isEmpty()) {
+        mItems.prepend(packMisses);
+    }
+    startPreviewJobs();
+
+    if (currentItemStale) {
+        checkThumbnail();
+    } else if (currentItemMiss) {
+        // This moves on to the next items once the current one is handled
+        createThumbnailWithoutCache();
+    } else if (currentItemDone || (mCurrentItem.isNull() && pendingDone)) {
+        determineNextIcon();
+    }
 }
 
 void ThumbnailProvider::checkThumbnail()
@@ -419,125 +900,219 @@ void ThumbnailProvider::checkThumbnail()
         return;
     }
 
-    // If we are in the thumbnail dir, just load the file
-    if (mCurrentUrl.isLocalFile()
-            && mCurrentUrl.adjusted(QUrl::RemoveFilename|QUrl::StripTrailingSlash).path().startsWith(thumbnailBaseDir())) {
-        QImage image(mCurrentUrl.toLocalFile());
-        emitThumbnailLoaded(image, image.size());
-        determineNextIcon();
-        return;
-    }
-
     mOriginalUri = generateOriginalUri(mCurrentUrl);
     mThumbnailPath = generateThumbnailPath(mOriginalUri, mThumbnailGroup);
 
+    // Let the generator load and check the cached thumbnail, it will tell
+    // us if we need to create one
     LOG("Stat thumb" << mThumbnailPath);
+    mState = STATE_CHECKCACHE;
+    ThumbnailRequest request = createRequest(mCurrentItem, mCurrentUrl);
+    request.mOriginalTime = mOriginalTime;
+    mThumbnailGenerator->load(request);
+}
 
-    QImage thumb = loadThumbnailFromCache();
-    KIO::filesize_t fileSize = thumb.text("Thumb::Size").toULongLong();
-    if (!thumb.isNull()) {
-        if (thumb.text("Thumb::URI") == mOriginalUri &&
-                thumb.text("Thumb::MTime").toInt() == mOriginalTime &&
-                 (fileSize == 0 || fileSize == mOriginalFileSize)) {
-            int width = 0, height = 0;
-            QSize size;
-            bool ok;
-
-            width = thumb.text("Thumb::Image::Width").toInt(&ok);
-            if (ok) height = thumb.text("Thumb::Image::Height").toInt(&ok);
-            if (ok) {
-                size = QSize(width, height);
-            } else {
-                LOG("Thumbnail for" << mOriginalUri << "does not contain correct image size information");
-                // Don't try to determine the size of a video, it probably won't work and
-                // will cause high I/O usage with big files (bug #307007).
-                if (MimeTypeUtils::urlKind(mCurrentUrl) == MimeTypeUtils::KIND_VIDEO) {
-                    emitThumbnailLoaded(thumb, QSize());
-                    determineNextIcon();
-                    return;
-                }
-            }
-            emitThumbnailLoaded(thumb, size);
-            determineNextIcon();
-            return;
-        }
-    }
-
-    // Thumbnail not found or not valid
+void ThumbnailProvider::createThumbnailWithoutCache()
+{
     if (MimeTypeUtils::fileItemKind(mCurrentItem) == MimeTypeUtils::KIND_RASTER_IMAGE) {
         if (mCurrentUrl.isLocalFile()) {
             // Original is a local file, create the thumbnail
             startCreatingThumbnail(mCurrentUrl.toLocalFile());
         } else {
-            // Original is remote, download it
-            mState = STATE_DOWNLOADORIG;
-
-            QTemporaryFile tempFile;
-            tempFile.setAutoRemove(false);
-            if (!tempFile.open()) {
-                qWarning() << "Couldn't create temp file to download " << mCurrentUrl.toDisplayString();
-                emitThumbnailLoadingFailed();
-                determineNextIcon();
-                return;
-            }
-            mTempPath = tempFile.fileName();
-
-            QUrl url = QUrl::fromLocalFile(mTempPath);
-            KIO::Job* job = KIO::file_copy(mCurrentUrl, url, -1, KIO::Overwrite | KIO::HideProgressInfo);
-            KJobWidgets::setWindow(job, qApp->activeWindow());
-            LOG("Download remote file" << mCurrentUrl.toDisplayString() << "to" << url.toDisplayString());
-            addSubjob(job);
+            // Original is remote, download it while we move on to the next
+            // items
+            startDownload();
+            determineNextIcon();
         }
     } else {
-        // Not a raster image, use a KPreviewJob
-        LOG("Starting a KPreviewJob for" << mCurrentItem.url());
-        mState = STATE_PREVIEWJOB;
-        KFileItemList list;
-        list.append(mCurrentItem);
-        const int pixelSize = ThumbnailGroup::pixelSize(mThumbnailGroup);
-        if (mPreviewPlugins.isEmpty()) {
-            mPreviewPlugins = KIO::PreviewJob::availablePlugins();
-        }
-        KIO::Job* job = KIO::filePreview(list, QSize(pixelSize, pixelSize), &mPreviewPlugins);
-        //KJobWidgets::setWindow(job, qApp->activeWindow());
-        connect(job, SIGNAL(gotPreview(KFileItem,QPixmap)),
-                this, SLOT(slotGotPreview(KFileItem,QPixmap)));
-        connect(job, SIGNAL(failed(KFileItem)),
-                this, SLOT(emitThumbnailLoadingFailed()));
-        addSubjob(job);
+        // Not a raster image, let a preview job create the thumbnail while
+        // we move on to the next items
+        mPreviewItems.append(mCurrentItem);
+        startPreviewJobs();
+        determineNextIcon();
     }
 }
 
 void ThumbnailProvider::startCreatingThumbnail(const QString& pixPath)
+{
+    queueThumbnailCreation(mCurrentItem, mCurrentUrl, mOriginalTime, pixPath, QString());
+
+    // Do not wait for the thumbnail, the generator works on several items at
+    // the same time
+    determineNextIcon();
+}
+
+void ThumbnailProvider::queueThumbnailCreation(const KFileItem& item, const QUrl& url, time_t originalTime, const QString& pixPath, const QString& tempPath)
 {
     LOG("Creating thumbnail from" << pixPath);
-    // If mPreviousThumbnailGenerator is already working on our current item
-    // its thumbnail will be passed to sThumbnailWriter when ready. So we
-    // connect mPreviousThumbnailGenerator's signal "finished" to determineNextIcon
-    // which will load the thumbnail from sThumbnailWriter or from disk
-    // (because we re-add mCurrentItem to mItems).
-    if (mPreviousThumbnailGenerator && mPreviousThumbnailGenerator->isRunning() &&
-        mOriginalUri == mPreviousThumbnailGenerator->originalUri() &&
-        mOriginalTime == mPreviousThumbnailGenerator->originalTime() &&
-        mOriginalFileSize == mPreviousThumbnailGenerator->originalFileSize() &&
-        mCurrentItem.mimetype() == mPreviousThumbnailGenerator->originalMimeType()) {
-            connect(mPreviousThumbnailGenerator, SIGNAL(finished()), SLOT(determineNextIcon()));
-            mItems.prepend(mCurrentItem);
+    ThumbnailRequest request = createRequest(item, url);
+    if (mPendingThumbnails.contains(request.mOriginalUri)) {
+        // Item has been appended again while its thumbnail is being
+        // generated, no need to generate it twice
+        if (!tempPath.isEmpty()) {
+            QFile::remove(tempPath);
+        }
+        return;
+    }
+    PendingThumbnail pending;
+    pending.mItem = item;
+    pending.mOriginalFileSize = request.mOriginalFileSize;
+    pending.mThumbnailGroup = request.mThumbnailGroup;
+    pending.mTempPath = tempPath;
+    mPendingThumbnails.insert(request.mOriginalUri, pending);
+
+    request.mOriginalTime = originalTime;
+    request.mPixPath = pixPath;
+    request.mCheckCache = false;
+    request.mGenerate = true;
+    mThumbnailGenerator->load(request);
+}
+
+void ThumbnailProvider::startDownload()
+{
+    Q_FOREACH(const Download* download, mDownloads) {
+        if (download->mItem.url() == mCurrentItem.url()) {
+            // Item has been appended again while being downloaded
             return;
+        }
+    }
+
+    QTemporaryFile tempFile;
+    tempFile.setAutoRemove(false);
+    if (!tempFile.open()) {
+        qWarning() << "Couldn't create temp file to download " << mCurrentUrl.toDisplayString();
+        emitThumbnailLoadingFailed();
+        return;
+    }
+
+    Download* download = new Download(ThumbnailGroup::pixelSize(mThumbnailGroup), GwenviewConfig::applyExifOrientation());
+    download->mItem = mCurrentItem;
+    download->mUrl = mCurrentUrl;
+    download->mOriginalTime = mOriginalTime;
+    download->mFile.setFileName(tempFile.fileName());
+    tempFile.close();
+    if (!download->mFile.open(QIODevice::WriteOnly)) {
+        qWarning() << "Couldn't open temp file to download " << mCurrentUrl.toDisplayString();
+        download->mFile.remove();
+        delete download;
+        emitThumbnailLoadingFailed();
+        return;
     }
-    mThumbnailGenerator->load(mOriginalUri, mOriginalTime, mOriginalFileSize,
-                          mCurrentItem.mimetype(), pixPath, mThumbnailPath, mThumbnailGroup);
+
+    KIO::TransferJob* job = KIO::get(mCurrentUrl, KIO::NoReload, KIO::HideProgressInfo);
+    KJobWidgets::setWindow(job, qApp->activeWindow());
+    connect(job, &KIO::TransferJob::data, this, &ThumbnailProvider::slotDownloadData);
+    connect(job, &KJob::result, this, &ThumbnailProvider::slotDownloadResult);
+    LOG("Download remote file" << mCurrentUrl.toDisplayString() << "to" << download->mFile.fileName());
+    mDownloads.insert(job, download);
 }
 
-void ThumbnailProvider::slotGotPreview(const KFileItem& item, const QPixmap& pixmap)
+void ThumbnailProvider::slotDownloadData(KIO::Job* job, const QByteArray& data)
 {
+    Download* download = mDownloads.value(job);
+    if (!download || data.isEmpty()) {
+        return;
+    }
+    if (download->mFile.write(data) != data.size()) {
+        qWarning() << "Couldn't write temp file to download " << download->mUrl.toDisplayString();
+        job->kill(KJob::EmitResult);
+        return;
+    }
+    if (download->mPrefixChecker.status() != JpegPrefixChecker::NeedMoreData) {
+        return;
+    }
+
+    download->mPrefix += data;
+    const JpegPrefixChecker::Status status = download->mPrefixChecker.check(download->mPrefix);
+    if (status == JpegPrefixChecker::NeedMoreData) {
+        return;
+    }
+    download->mPrefix.clear();
+    if (status == JpegPrefixChecker::PrefixIsEnough) {
+        LOG("Got enough of" << download->mUrl.toDisplayString() << "after" << download->mFile.size() << "bytes");
+        mDownloads.remove(job);
+        job->kill();
+        finishDownload(download);
+        if (mCurrentItem.isNull()) {
+            determineNextIcon();
+        }
+    }
+}
+
+void ThumbnailProvider::slotDownloadResult(KJob* job)
+{
+    Download* download = mDownloads.take(job);
+    if (!download) {
+        return;
+    }
+    if (job->error()) {
+        emitThumbnailLoadingFailed(download->mItem);
+        LOG("Delete temp file" << download->mFile.fileName());
+        download->mFile.remove();
+        delete download;
+    } else {
+        finishDownload(download);
+    }
     if (mCurrentItem.isNull()) {
-        // This can happen if current item has been removed by removeItems()
+        determineNextIcon();
+    }
+}
+
+void ThumbnailProvider::finishDownload(Download* download)
+{
+    download->mFile.close();
+    const QString tempPath = download->mFile.fileName();
+    queueThumbnailCreation(download->mItem, download->mUrl, download->mOriginalTime, tempPath, tempPath);
+    delete download;
+}
+
+void ThumbnailProvider::slotGotPreview(const KFileItem& item, const QPixmap& pixmap)
+{
+    KJob* job = mPreviewJobForUrl.take(item.url());
+    if (!job) {
+        // This can happen if the item has been removed by removeItems()
         return;
     }
-    LOG(mCurrentItem.url());
+    LOG(item.url());
+    const ThumbnailGroup::Enum group = ThumbnailGroup::Enum(job->property(PREVIEW_GROUP_PROPERTY).toInt());
     QSize size;
-    emit thumbnailLoaded(item, pixmap, size, mOriginalFileSize);
+    ThumbnailCache::instance()->insert(item, group, pixmap, size);
+    if (group != mThumbnailGroup) {
+        queueAgain(item);
+        QMetaObject::invokeMethod(this, "resumeIfIdle", Qt::QueuedConnection);
+        return;
+    }
+    emit thumbnailLoaded(item, pixmap, size, item.size());
+}
+
+void ThumbnailProvider::slotPreviewFailed(const KFileItem& item)
+{
+    if (!mPreviewJobForUrl.remove(item.url())) {
+        // This can happen if the item has been removed by removeItems()
+        return;
+    }
+    emitThumbnailLoadingFailed(item);
+}
+
+void ThumbnailProvider::slotPreviewJobResult(KJob* job)
+{
+    if (!mPreviewJobs.removeOne(job)) {
+        return;
+    }
+    // In case the job neither produced a preview nor failed for some items
+    QHash<QUrl, KJob*>::Iterator it = mPreviewJobForUrl.begin();
+    while (it != mPreviewJobForUrl.end()) {
+        if (it.value() == job) {
+            ThumbnailCache::instance()->cancelLoading(it.key(), mThumbnailGroup, this);
+            it = mPreviewJobForUrl.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    startPreviewJobs();
+    if (mCurrentItem.isNull()) {
+        determineNextIcon();
+    }
 }
 
 void ThumbnailProvider::emitThumbnailLoaded(const QImage& img, const QSize& size)
@@ -546,9 +1121,15 @@ void ThumbnailProvider::emitThumbnailLoaded(const QImage& img, const QSize& size
         // This can happen if current item has been removed by removeItems()
         return;
     }
-    LOG(mCurrentItem.url());
+    emitThumbnailLoaded(mCurrentItem, mThumbnailGroup, img, size, mOriginalFileSize);
+}
+
+void ThumbnailProvider::emitThumbnailLoaded(const KFileItem& item, ThumbnailGroup::Enum group, const QImage& img, const QSize& size, KIO::filesize_t fileSize)
+{
+    LOG(item.url());
     QPixmap thumb = QPixmap::fromImage(img);
-    emit thumbnailLoaded(mCurrentItem, thumb, size, mOriginalFileSize);
+    ThumbnailCache::instance()->insert(item, group, thumb, size);
+    emit thumbnailLoaded(item, thumb, size, fileSize);
 }
 
 void ThumbnailProvider::emitThumbnailLoadingFailed()
@@ -557,8 +1138,14 @@ void ThumbnailProvider::emitThumbnailLoadingFailed()
         // This can happen if current item has been removed by removeItems()
         return;
     }
-    LOG(mCurrentItem.url());
-    emit thumbnailLoadingFailed(mCurrentItem);
+    emitThumbnailLoadingFailed(mCurrentItem);
+}
+
+void ThumbnailProvider::emitThumbnailLoadingFailed(const KFileItem& item)
+{
+    LOG(item.url());
+    ThumbnailCache::instance()->loadingFailed(item.url(), mThumbnailGroup, this);
+    emit thumbnailLoadingFailed(item);
 }
 
 bool ThumbnailProvider::isThumbnailWriterEmpty()
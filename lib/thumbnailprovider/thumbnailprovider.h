@@ -28,8 +28,8 @@
 
 // Qt
 #include <QImage>
+#include <QHash>
 #include <QPixmap>
-#include <QPointer>
 
 // KDE
 #include <KIO/Job>
@@ -37,12 +37,15 @@
 
 // Local
 #include <lib/thumbnailgroup.h>
+#include <lib/thumbnailprovider/thumbnailitemqueue.h>
 
 namespace Gwenview
 {
 
 class ThumbnailGenerator;
 class ThumbnailWriter;
+struct ThumbnailRequest;
+struct ThumbnailResult;
 
 /**
  * A job that determines the thumbnails for the images in the current directory
@@ -69,13 +72,26 @@ public:
     /**
      * Returns the list of items waiting for a thumbnail
      */
-    const KFileItemList& pendingItems() const;
+    KFileItemList pendingItems() const;
 
     /**
      * Add items to the job
      */
     void appendItems(const KFileItemList& items);
 
+    /**
+     * Moves @p items before the other pending items, in this order, adding
+     * the ones which are not pending yet. Items already being loaded are not
+     * loaded again.
+     */
+    void prioritizeItems(const KFileItemList& items);
+
+    /**
+     * Moves the pending items of @p urls before the other pending items, in
+     * this order. Urls which are not pending are ignored.
+     */
+    void prioritize(const QList<QUrl>& urls);
+
     /**
      * Defines size of thumbnails to generate
      */
@@ -98,6 +114,12 @@ public:
      */
     static QString thumbnailBaseDir(ThumbnailGroup::Enum group);
 
+    /**
+     * Returns the path of the thumbnail of @p url for @p group, whether it
+     * exists or not
+     */
+    static QString thumbnailPath(const QUrl& url, ThumbnailGroup::Enum group);
+
     /**
      * Delete the thumbnail for the @p url
      */
@@ -132,15 +154,24 @@ protected:
 
 private Q_SLOTS:
     void determineNextIcon();
+    void resumeIfIdle();
     void slotGotPreview(const KFileItem&, const QPixmap&);
+    void slotPreviewFailed(const KFileItem&);
+    void slotPreviewJobResult(KJob*);
+    void slotDownloadData(KIO::Job*, const QByteArray&);
+    void slotDownloadResult(KJob*);
     void checkThumbnail();
-    void thumbnailReady(const QImage&, const QSize&);
     void emitThumbnailLoadingFailed();
+    void emitCachedThumbnails();
 
 private:
-    enum { STATE_STATORIG, STATE_DOWNLOADORIG, STATE_PREVIEWJOB, STATE_NEXTTHUMB } mState;
+    enum { STATE_STATORIG, STATE_CHECKCACHE, STATE_NEXTTHUMB } mState;
 
-    KFileItemList mItems;
+    ThumbnailItemQueue mItems;
+
+    // The item being stat'ed and looked up in the cache through KIO. Local
+    // items are entirely handled by mThumbnailGenerator and the preview jobs
+    // and never become the current item.
     KFileItem mCurrentItem;
 
     // The Url of the current item (always equivalent to m_items.first()->item()->url())
@@ -158,24 +189,81 @@ private:
     // The thumbnail path
     QString mThumbnailPath;
 
-    // The temporary path for remote urls
-    QString mTempPath;
-
     // Thumbnail group
     ThumbnailGroup::Enum mThumbnailGroup;
 
     ThumbnailGenerator* mThumbnailGenerator;
-    QPointer<ThumbnailGenerator> mPreviousThumbnailGenerator;
+
+    struct PendingThumbnail
+    {
+        PendingThumbnail()
+        : mOriginalFileSize(0)
+        , mThumbnailGroup(ThumbnailGroup::Normal)
+        , mPreviewOnMiss(false)
+        {}
+
+        KFileItem mItem;
+        KIO::filesize_t mOriginalFileSize;
+        // The group the thumbnail has been requested for
+        ThumbnailGroup::Enum mThumbnailGroup;
+        QString mTempPath;
+        // Not a raster image: a preview job creates the thumbnail if the
+        // cache does not have it
+        bool mPreviewOnMiss;
+    };
+
+    // Items whose thumbnail is being loaded or generated, indexed by original uri
+    QHash<QString, PendingThumbnail> mPendingThumbnails;
+
+    // Non-raster items waiting for a preview job
+    ThumbnailItemQueue mPreviewItems;
+
+    // Items handled by a running preview job, and the job handling them
+    QHash<QUrl, KJob*> mPreviewJobForUrl;
+
+    QList<KJob*> mPreviewJobs;
+
+    struct Download;
+
+    // Remote images being downloaded, indexed by their KIO::get job
+    QHash<KJob*, Download*> mDownloads;
+
+    // Items whose thumbnail is in ThumbnailCache, emitted asynchronously
+    KFileItemList mCachedItems;
+
+    // Items whose thumbnail is being loaded by another provider
+    QHash<QUrl, KFileItem> mWaitingItems;
+
+    // Avoid emitting finished() twice when several events end the work
+    bool mFinishedEmitted;
 
     QStringList mPreviewPlugins;
 
     void createNewThumbnailGenerator();
     void abortSubjob();
+    void abortPreviewJobs();
+    void startPreviewJobs();
     void startCreatingThumbnail(const QString& path);
+    void queueThumbnailCreation(const KFileItem& item, const QUrl& url, time_t originalTime, const QString& pixPath, const QString& tempPath);
+    void startDownload();
+    void finishDownload(Download* download);
+    void abortDownloads();
+    void createThumbnailWithoutCache();
+    void cancelPendingThumbnails();
+    ThumbnailRequest createRequest(const KFileItem& item, const QUrl& url) const;
+    bool queueLocalItem(const KFileItem& item);
+    void queuePackLookups(KFileItemList* items);
+    void filterNewItems(KFileItemList* items);
+    void takeCachedItems(KFileItemList* items);
+    void queueAgain(const KFileItem& item);
+    void slotThumbnailsReady(const QList<ThumbnailResult>& results);
+    void slotCacheThumbnailInserted(const QUrl& url, ThumbnailGroup::Enum group);
+    void slotCacheThumbnailLoadingFailed(const QUrl& url, ThumbnailGroup::Enum group);
+    void slotCacheThumbnailLoadingCancelled(const QUrl& url, ThumbnailGroup::Enum group);
 
     void emitThumbnailLoaded(const QImage& img, const QSize& size);
-
-    QImage loadThumbnailFromCache() const;
+    void emitThumbnailLoaded(const KFileItem& item, ThumbnailGroup::Enum group, const QImage& img, const QSize& size, KIO::filesize_t fileSize);
+    void emitThumbnailLoadingFailed(const KFileItem& item);
 };
 
 } // namespace
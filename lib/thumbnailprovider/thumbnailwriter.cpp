@@ -22,11 +22,17 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 #include "thumbnailwriter.h"
 
 // Local
+#include "gwenviewconfig.h"
+#include "thumbnailpack.h"
+#include "traceutils.h"
 
 // Qt
 #include <QImage>
+#include <QImageWriter>
 #include <QDebug>
-#include <QTemporaryFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
 
 namespace Gwenview
 {
@@ -40,60 +46,223 @@ namespace Gwenview
 #define LOG(x) ;
 #endif
 
-static void storeThumbnailToDiskCache(const QString& path, const QImage& image)
+/** How many packs are kept open */
+static const int MAX_OPEN_PACKS = 16;
+
+/**
+ * How many thumbnails can wait to be written. At 256x256 pixels, this is
+ * about 16 MB.
+ */
+static const int MAX_QUEUED_THUMBNAILS = 64;
+
+class ThumbnailWriterTask : public QRunnable
 {
-    LOG(path);
-    QTemporaryFile tmp(path + QStringLiteral(".gwenview.tmpXXXXXX.png"));
-    if (!tmp.open()) {
-        qWarning() << "Could not create a temporary file.";
-        return;
-    }
+public:
+    ThumbnailWriterTask(ThumbnailWriter* writer)
+    : mWriter(writer)
+    {}
 
-    if (!image.save(tmp.fileName(), "png")) {
-        qWarning() << "Could not save thumbnail";
-        return;
+    void run() Q_DECL_OVERRIDE
+    {
+        mWriter->processQueue();
     }
 
-    QFile::rename(tmp.fileName(), path);
+private:
+    ThumbnailWriter* mWriter;
+};
+
+ThumbnailWriter::ThumbnailWriter()
+: mCount(0)
+, mSerial(0)
+, mWorkerCount(0)
+, mMaxWorkerCount(qMax(1, GwenviewConfig::thumbnailWriterThreadCount()))
+, mCompressionLevel(GwenviewConfig::thumbnailCompressionLevel())
+, mPackEnabled(false)
+{
+    mThreadPool.setMaxThreadCount(mMaxWorkerCount);
+}
+
+ThumbnailWriter::~ThumbnailWriter()
+{
+    waitForDone();
+    qDeleteAll(mPacks);
+}
+
+void ThumbnailWriter::setPackEnabled(bool enabled)
+{
+    QWriteLocker locker(&mLock);
+    mPackEnabled = enabled;
 }
 
 void ThumbnailWriter::queueThumbnail(const QString& path, const QImage& image)
+{
+    queue(path, image, true);
+}
+
+void ThumbnailWriter::queuePackEntry(const QString& path, const QImage& image)
+{
+    queue(path, image, false);
+}
+
+void ThumbnailWriter::queue(const QString& path, const QImage& image, bool writePng)
 {
     LOG(path);
-    QMutexLocker locker(&mMutex);
-    mCache.insert(path, image);
-    start();
+    QWriteLocker locker(&mLock);
+    Cache::Iterator it = mCache.find(path);
+    if (it == mCache.end()) {
+        while (mCache.count() >= MAX_QUEUED_THUMBNAILS) {
+            GV_TRACE_SPAN("thumbnail", "ThumbnailWriter::waitForSpace");
+            mSpaceAvailable.wait(&mLock);
+        }
+        // The entry may have been queued while we were waiting
+        it = mCache.find(path);
+    }
+    if (it != mCache.end()) {
+        // Do not forget to write the PNG if it was requested before
+        Entry& entry = it.value();
+        entry.mImage = image;
+        entry.mWritePng = entry.mWritePng || writePng;
+        entry.mSerial = ++mSerial;
+        if (!entry.mQueued) {
+            // Being written, write it again
+            entry.mQueued = true;
+            mQueue.enqueue(path);
+        }
+    } else {
+        Entry entry;
+        entry.mImage = image;
+        entry.mWritePng = writePng;
+        entry.mSerial = ++mSerial;
+        entry.mQueued = true;
+        mCache.insert(path, entry);
+        mQueue.enqueue(path);
+        mCount.storeRelease(mCache.count());
+    }
+    publishSnapshot();
+    if (mWorkerCount < mMaxWorkerCount && mWorkerCount < mQueue.count()) {
+        ++mWorkerCount;
+        mThreadPool.start(new ThumbnailWriterTask(this));
+    }
 }
 
-void ThumbnailWriter::run()
+void ThumbnailWriter::processQueue()
 {
-    QMutexLocker locker(&mMutex);
-    while (!mCache.isEmpty()) {
-        Cache::ConstIterator it = mCache.constBegin();
-        const QString path = it.key();
-        const QImage image = it.value();
-
-        // This part of the thread is the most time consuming but it does not
-        // depend on mCache so we can unlock here. This way other thumbnails
-        // can be added or queried
+    QWriteLocker locker(&mLock);
+    while (!mQueue.isEmpty()) {
+        const QString path = mQueue.dequeue();
+        Entry& entry = mCache[path];
+        entry.mQueued = false;
+        const QImage image = entry.mImage;
+        const bool writePng = entry.mWritePng;
+        const int serial = entry.mSerial;
+        const bool packEnabled = mPackEnabled;
+
+        // Writing does not depend on mCache so we can unlock here. This way
+        // other thumbnails can be added or queried, and other workers can
+        // write at the same time
         locker.unlock();
-        storeThumbnailToDiskCache(path, image);
+        if (writePng) {
+            store(path, image);
+        }
+        if (packEnabled) {
+            appendToPack(path, image);
+        }
         locker.relock();
 
-        mCache.remove(path);
+        Cache::Iterator it = mCache.find(path);
+        if (it != mCache.end() && it.value().mSerial == serial) {
+            mCache.erase(it);
+            mCount.storeRelease(mCache.count());
+            publishSnapshot();
+            mSpaceAvailable.wakeOne();
+        }
     }
+    --mWorkerCount;
+}
+
+void ThumbnailWriter::store(const QString& path, const QImage& image)
+{
+    GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailWriter::store", path);
+    LOG(path);
+    // QSaveFile writes to a temporary file and renames it, so that readers
+    // never see incomplete thumbnails
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not create a temporary file.";
+        return;
+    }
+
+    QImageWriter writer(&file, "png");
+    if (mCompressionLevel >= 0) {
+        // The PNG handler turns quality into zlib compression levels:
+        // level = (100 - quality) * 9 / 91
+        writer.setQuality(100 - (mCompressionLevel * 91 + 8) / 9);
+    }
+    if (!writer.write(image)) {
+        qWarning() << "Could not save thumbnail";
+        file.cancelWriting();
+        return;
+    }
+    file.commit();
+}
+
+void ThumbnailWriter::appendToPack(const QString& path, const QImage& image)
+{
+    const QString uri = image.text("Thumb::URI");
+    if (uri.isEmpty()) {
+        return;
+    }
+    const QString packPath = ThumbnailPack::packPath(QFileInfo(path).path(), uri);
+    QMutexLocker locker(&mPackMutex);
+    ThumbnailPack* pack = mPacks.value(packPath);
+    if (!pack) {
+        if (mPacks.count() >= MAX_OPEN_PACKS) {
+            qDeleteAll(mPacks);
+            mPacks.clear();
+        }
+        pack = new ThumbnailPack(packPath);
+        mPacks.insert(packPath, pack);
+    }
+    const QSize originalSize(image.text("Thumb::Image::Width").toInt(),
+                             image.text("Thumb::Image::Height").toInt());
+    pack->append(uri,
+                 image.text("Thumb::MTime").toLongLong(),
+                 image.text("Thumb::Size").toULongLong(),
+                 originalSize,
+                 image);
+}
+
+void ThumbnailWriter::publishSnapshot()
+{
+    // At most MAX_QUEUED_THUMBNAILS entries, and the images are implicitly
+    // shared: this is cheap compared to writing a thumbnail
+    Snapshot* snapshot = new Snapshot;
+    snapshot->reserve(mCache.count());
+    for (Cache::ConstIterator it = mCache.constBegin(), end = mCache.constEnd(); it != end; ++it) {
+        snapshot->insert(it.key(), it.value().mImage);
+    }
+    std::atomic_store(&mSnapshot, std::shared_ptr<const Snapshot>(snapshot));
 }
 
 QImage ThumbnailWriter::value(const QString& path) const
 {
-    QMutexLocker locker(&mMutex);
-    return mCache.value(path);
+    // This is called for every thumbnail lookup, from all generator threads,
+    // while workers hold mLock: read the last published snapshot instead
+    if (mCount.loadAcquire() == 0) {
+        return QImage();
+    }
+    const std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&mSnapshot);
+    return snapshot ? snapshot->value(path) : QImage();
 }
 
 bool ThumbnailWriter::isEmpty() const
 {
-    QMutexLocker locker(&mMutex);
-    return mCache.isEmpty();
+    return mCount.loadAcquire() == 0;
+}
+
+void ThumbnailWriter::waitForDone()
+{
+    mThreadPool.waitForDone();
 }
 
 } // namespace
@@ -26,37 +26,109 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 // KDE
 
 // Qt
+#include <QAtomicInt>
 #include <QHash>
+#include <QImage>
 #include <QMutex>
-#include <QThread>
+#include <QQueue>
+#include <QReadWriteLock>
+#include <QThreadPool>
+#include <QWaitCondition>
 
-class QImage;
+// std
+#include <memory>
 
 namespace Gwenview
 {
 
+class ThumbnailPack;
+class ThumbnailWriterTask;
+
 /**
- * Store thumbnails to disk when done generating them
+ * Store thumbnails to disk when done generating them.
+ *
+ * Thumbnails are written by a few worker threads, as defined by the
+ * ThumbnailWriterThreadCount config entry: on network file systems, writing
+ * is mostly waiting. The number of thumbnails waiting to be written is
+ * bounded, queueThumbnail() blocks when the queue is full, slowing down the
+ * threads generating thumbnails instead of piling up images in memory.
  */
-class ThumbnailWriter : public QThread
+class ThumbnailWriter
 {
-    Q_OBJECT
 public:
+    ThumbnailWriter();
+    ~ThumbnailWriter();
+
     // Return thumbnail if it has still not been stored
     QImage value(const QString&) const;
 
     bool isEmpty() const;
 
-public Q_SLOTS:
-    void queueThumbnail(const QString&, const QImage&);
-
-protected:
-    void run() Q_DECL_OVERRIDE;
+    /**
+     * If enabled, thumbnails are also appended to the ThumbnailPack of their
+     * directory
+     */
+    void setPackEnabled(bool enabled);
+
+    /**
+     * Queues @p image to be stored at @p path. Blocks if the queue is full,
+     * so it should not be called from the GUI thread.
+     */
+    void queueThumbnail(const QString& path, const QImage& image);
+
+    /**
+     * Only adds @p image to the pack, for thumbnails which already exist as
+     * PNG files
+     */
+    void queuePackEntry(const QString& path, const QImage& image);
+
+    /**
+     * Blocks until all queued thumbnails have been stored
+     */
+    void waitForDone();
 
 private:
-    typedef QHash<QString, QImage> Cache;
+    Q_DISABLE_COPY(ThumbnailWriter)
+    friend class ThumbnailWriterTask;
+
+    struct Entry
+    {
+        QImage mImage;
+        bool mWritePng;
+        /// Changes each time the entry is queued again
+        int mSerial;
+        /// False while the entry is being written
+        bool mQueued;
+    };
+    typedef QHash<QString, Entry> Cache;
     Cache mCache;
-    mutable QMutex mMutex;
+    QQueue<QString> mQueue;
+    /// Number of entries in mCache, readable without locking
+    QAtomicInt mCount;
+    typedef QHash<QString, QImage> Snapshot;
+    /// Immutable copy of the images of mCache, replaced each time mCache
+    /// changes, so that value() never takes mLock. Only accessed through
+    /// std::atomic_load() and std::atomic_store().
+    std::shared_ptr<const Snapshot> mSnapshot;
+    mutable QReadWriteLock mLock;
+    QWaitCondition mSpaceAvailable;
+    int mSerial;
+    int mWorkerCount;
+    int mMaxWorkerCount;
+    int mCompressionLevel;
+    bool mPackEnabled;
+    QThreadPool mThreadPool;
+
+    // Packs are not thread-safe
+    QMutex mPackMutex;
+    QHash<QString, ThumbnailPack*> mPacks;
+
+    void queue(const QString& path, const QImage& image, bool writePng);
+    /// Must be called with mLock locked for writing
+    void publishSnapshot();
+    void processQueue();
+    void store(const QString& path, const QImage& image);
+    void appendToPack(const QString& path, const QImage& image);
 };
 
 } // namespace
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 
 // Qt
 #include <QApplication>
+#include <QCache>
 #include <QHash>
 #include <QHBoxLayout>
 #include <QPainter>
@@ -93,6 +94,18 @@ const int SHADOW_STRENGTH = 128;
 /** How many pixels around the thumbnail are shadowed */
 const int SHADOW_SIZE = 4;
 
+/** How many elided texts are kept */
+const int ELIDED_TEXT_CACHE_SIZE = 2000;
+
+/** Size of the shadow cache, in kilobytes */
+const int SHADOW_CACHE_SIZE = 4 * 1024;
+
+/**
+ * Minimum size of the item frame cache, in kilobytes. The cache grows to hold
+ * the frames of twice the number of items which fit in the viewport.
+ */
+const int MIN_FRAME_CACHE_SIZE = 32 * 1024;
+
 static KFileItem fileItemForIndex(const QModelIndex& index)
 {
     Q_ASSERT(index.isValid());
@@ -106,17 +119,77 @@ static QUrl urlForIndex(const QModelIndex& index)
     return item.url();
 }
 
+static int pixmapCost(const QPixmap& pixmap)
+{
+    return qMax(1, pixmap.width() * pixmap.height() * 4 / 1024);
+}
+
+/**
+ * Describes what paint() draws for an item, except the busy and modified
+ * indicators, which are drawn over it. Also used as the key of the frame
+ * cache: items which look the same share their frame.
+ */
+struct ItemFrame
+{
+    qint64 mThumbnailKey;
+    QSize mSize;
+    qreal mDevicePixelRatio;
+    bool mSelected;
+    bool mUnderMouse;
+    QRgb mBgColor;
+    QRgb mBorderColor;
+    QRgb mFgColor;
+    QStringList mTextLines;
+    /// -1 if the rating is not shown
+    int mRating;
+
+    bool operator==(const ItemFrame& other) const
+    {
+        return mThumbnailKey == other.mThumbnailKey
+            && mSize == other.mSize
+            && mDevicePixelRatio == other.mDevicePixelRatio
+            && mSelected == other.mSelected
+            && mUnderMouse == other.mUnderMouse
+            && mBgColor == other.mBgColor
+            && mBorderColor == other.mBorderColor
+            && mFgColor == other.mFgColor
+            && mRating == other.mRating
+            && mTextLines == other.mTextLines;
+    }
+};
+
+inline uint qHash(const ItemFrame& frame, uint seed = 0)
+{
+    uint hash = qHash(frame.mThumbnailKey, seed)
+        ^ qHash(frame.mSize.width(), seed) * 31
+        ^ qHash(frame.mSize.height(), seed) * 17
+        ^ uint(frame.mSelected)
+        ^ (uint(frame.mUnderMouse) << 1)
+        ^ (uint(frame.mRating + 1) << 2);
+    Q_FOREACH(const QString& line, frame.mTextLines) {
+        hash = hash * 31 ^ qHash(line, seed);
+    }
+    return hash;
+}
+
 struct PreviewItemDelegatePrivate
 {
     /**
      * Maps full text to elided text.
      */
-    mutable QHash<QString, QString> mElidedTextCache;
+    mutable QCache<QString, QString> mElidedTextCache;
 
     // Key is height * 1000 + width
-    typedef QHash<int, QPixmap> ShadowCache;
+    typedef QCache<int, QPixmap> ShadowCache;
     mutable ShadowCache mShadowCache;
 
+    /**
+     * Items ready to be drawn with one pixmap. Since selection, hover and
+     * thumbnail changes produce new keys, outdated frames are just left to
+     * be evicted.
+     */
+    mutable QCache<ItemFrame, QPixmap> mFrameCache;
+
     PreviewItemDelegate* q;
     ThumbnailView* mView;
     QWidget* mContextBar;
@@ -153,7 +226,7 @@ struct PreviewItemDelegatePrivate
         mSaveButton->render(&mSaveButtonPixmap, QPoint(), QRegion(), QWidget::DrawChildren);
     }
 
-    void showContextBar(const QRect& rect, const QPixmap& thumbnailPix)
+    void showContextBar(const QRect& rect, const AtlasPixmap& thumbnailPix)
     {
         if (mContextBarActions == PreviewItemDelegate::NoAction) {
             return;
@@ -203,7 +276,7 @@ struct PreviewItemDelegatePrivate
             updateImageButtons();
 
             const QRect rect = mView->visualRect(mIndexUnderCursor);
-            const QPixmap thumbnailPix = mView->thumbnailForIndex(index);
+            const AtlasPixmap thumbnailPix = mView->thumbnailForIndex(index);
             showContextBar(rect, thumbnailPix);
             if (mView->isModified(mIndexUnderCursor)) {
                 showSaveButton(rect);
@@ -318,29 +391,34 @@ struct PreviewItemDelegatePrivate
 
         int key = rect.height() * 1000 + rect.width();
 
-        ShadowCache::Iterator it = mShadowCache.find(key);
-        if (it == mShadowCache.end()) {
-            QSize size = QSize(rect.width() + 2 * SHADOW_SIZE, rect.height() + 2 * SHADOW_SIZE);
-            QColor color(0, 0, 0, SHADOW_STRENGTH);
-            QPixmap shadow = PaintUtils::generateFuzzyRect(size, color, SHADOW_SIZE);
-            it = mShadowCache.insert(key, shadow);
+        const QPixmap* cachedShadow = mShadowCache.object(key);
+        if (cachedShadow) {
+            painter->drawPixmap(rect.topLeft() + shadowOffset, *cachedShadow);
+            return;
+        }
+        QSize size = QSize(rect.width() + 2 * SHADOW_SIZE, rect.height() + 2 * SHADOW_SIZE);
+        QColor color(0, 0, 0, SHADOW_STRENGTH);
+        QPixmap shadow = PaintUtils::generateFuzzyRect(size, color, SHADOW_SIZE);
+        painter->drawPixmap(rect.topLeft() + shadowOffset, shadow);
+        mShadowCache.insert(key, new QPixmap(shadow), pixmapCost(shadow));
+    }
+
+    QString elidedText(const QString& fullText, int width) const
+    {
+        const QString* cachedText = mElidedTextCache.object(fullText);
+        if (cachedText) {
+            return *cachedText;
         }
-        painter->drawPixmap(rect.topLeft() + shadowOffset, it.value());
+        const QString text = mView->fontMetrics().elidedText(fullText, mTextElideMode, width);
+        mElidedTextCache.insert(fullText, new QString(text));
+        return text;
     }
 
     void drawText(QPainter* painter, const QRect& rect, const QColor& fgColor, const QString& fullText) const
     {
         QFontMetrics fm = mView->fontMetrics();
 
-        // Elide text
-        QString text;
-        QHash<QString, QString>::const_iterator it = mElidedTextCache.constFind(fullText);
-        if (it == mElidedTextCache.constEnd()) {
-            text = fm.elidedText(fullText, mTextElideMode, rect.width());
-            mElidedTextCache[fullText] = text;
-        } else {
-            text = it.value();
-        }
+        const QString text = elidedText(fullText, rect.width());
 
         // Compute x pos
         int posX;
@@ -357,23 +435,111 @@ struct PreviewItemDelegatePrivate
         painter->drawText(rect.left() + posX, rect.top() + fm.ascent(), text);
     }
 
-    void drawRating(QPainter* painter, const QRect& rect, const QVariant& value)
+    void drawRating(QPainter* painter, const QRect& rect, int rating, int hoverRating)
     {
 #ifndef GWENVIEW_SEMANTICINFO_BACKEND_NONE
-        const int rating = value.toInt();
-        const QRect ratingRect = ratingRectFromIndexRect(rect);
-        const int hoverRating = ratingFromCursorPosition(ratingRect);
-        mRatingPainter.paint(painter, ratingRect, rating, hoverRating);
+        mRatingPainter.paint(painter, ratingRectFromIndexRect(rect), rating, hoverRating);
 #endif
     }
 
-    bool isTextElided(const QString& text) const
+    /**
+     * Returns the rating under the cursor for the item in @p rect, -1 if
+     * there is none
+     */
+    int hoverRatingForIndexRect(const QRect& rect) const
     {
-        QHash<QString, QString>::const_iterator it = mElidedTextCache.constFind(text);
-        if (it == mElidedTextCache.constEnd()) {
-            return false;
+#ifndef GWENVIEW_SEMANTICINFO_BACKEND_NONE
+        return ratingFromCursorPosition(ratingRectFromIndexRect(rect));
+#else
+        return -1;
+#endif
+    }
+
+    QRect thumbnailRectFromIndexRect(const QRect& rect, const AtlasPixmap& thumbnailPix) const
+    {
+        return QRect(
+                   rect.left() + (rect.width() - thumbnailPix.width()) / 2,
+                   rect.top() + (mThumbnailSize.height() - thumbnailPix.height()) + ITEM_MARGIN,
+                   thumbnailPix.width(),
+                   thumbnailPix.height());
+    }
+
+    void drawItemFrame(QPainter* painter, const QRect& rect, const AtlasPixmap& thumbnailPix, const ItemFrame& frame, int hoverRating)
+    {
+        const bool opaque = !thumbnailPix.hasAlphaChannel();
+        const QColor bgColor = QColor::fromRgba(frame.mBgColor);
+        const QColor borderColor = QColor::fromRgba(frame.mBorderColor);
+        const QColor fgColor = QColor::fromRgba(frame.mFgColor);
+        const QRect thumbnailRect = thumbnailRectFromIndexRect(rect, thumbnailPix);
+
+        // Draw background
+        const QRect backgroundRect = thumbnailRect.adjusted(-ITEM_MARGIN, -ITEM_MARGIN, ITEM_MARGIN, ITEM_MARGIN);
+        if (frame.mSelected) {
+            drawBackground(painter, backgroundRect, bgColor, borderColor);
+        } else if (frame.mUnderMouse) {
+            painter->setOpacity(0.2);
+            drawBackground(painter, backgroundRect, bgColor, borderColor);
+            painter->setOpacity(1.);
+        } else if (opaque) {
+            drawShadow(painter, thumbnailRect);
+        }
+
+        // Draw thumbnail
+        if (opaque) {
+            painter->setPen(borderColor);
+            painter->setRenderHint(QPainter::Antialiasing, false);
+            QRect borderRect = thumbnailRect.adjusted(-1, -1, 0, 0);
+            painter->drawRect(borderRect);
+        }
+        thumbnailPix.draw(painter, thumbnailRect.topLeft());
+
+        QRect textRect(
+            rect.left() + ITEM_MARGIN,
+            rect.top() + 2 * ITEM_MARGIN + mThumbnailSize.height(),
+            rect.width() - 2 * ITEM_MARGIN,
+            mView->fontMetrics().height());
+        Q_FOREACH(const QString& text, frame.mTextLines) {
+            drawText(painter, textRect, fgColor, text);
+            textRect.moveTop(textRect.bottom());
+        }
+
+        if (frame.mRating >= 0) {
+            drawRating(painter, rect, frame.mRating, hoverRating);
         }
-        return it.value().length() < text.length();
+    }
+
+    /**
+     * Draws the frame of the item in @p rect from the frame cache, creating
+     * the frame if it is not there
+     */
+    void drawCachedItemFrame(QPainter* painter, const QRect& rect, const AtlasPixmap& thumbnailPix, const ItemFrame& frame)
+    {
+        const QPixmap* cachedFrame = mFrameCache.object(frame);
+        if (cachedFrame) {
+            painter->drawPixmap(rect.topLeft(), *cachedFrame);
+            return;
+        }
+        QPixmap pixmap(rect.size() * frame.mDevicePixelRatio);
+        pixmap.setDevicePixelRatio(frame.mDevicePixelRatio);
+        pixmap.fill(Qt::transparent);
+        {
+            QPainter framePainter(&pixmap);
+            drawItemFrame(&framePainter, QRect(QPoint(0, 0), rect.size()), thumbnailPix, frame, -1);
+        }
+        painter->drawPixmap(rect.topLeft(), pixmap);
+        mFrameCache.insert(frame, new QPixmap(pixmap), pixmapCost(pixmap));
+    }
+
+    void clearPaintCaches()
+    {
+        mElidedTextCache.clear();
+        mShadowCache.clear();
+        mFrameCache.clear();
+    }
+
+    bool isTextElided(const QString& text) const
+    {
+        return elidedText(text, mThumbnailSize.width()).length() < text.length();
     }
 
     /**
@@ -410,7 +576,7 @@ struct PreviewItemDelegatePrivate
 
         if (!isDirOrArchive && (mDetails & PreviewItemDelegate::ImageSizeDetail)) {
             QSize fullSize;
-            QPixmap thumbnailPix = mView->thumbnailForIndex(index, &fullSize);
+            mView->thumbnailForIndex(index, &fullSize);
             if (fullSize.isValid()) {
                 const QString text = QString("%1x%2").arg(fullSize.width()).arg(fullSize.height());
                 elided |= isTextElided(text);
@@ -571,6 +737,23 @@ struct PreviewItemDelegatePrivate
     void updateViewGridSize()
     {
         mView->setGridSize(QSize(itemWidth(), itemHeight()));
+        updateFrameCacheSize();
+    }
+
+    /**
+     * Makes sure the frame cache can hold the frames of all visible items,
+     * otherwise each repaint would create them all again
+     */
+    void updateFrameCacheSize()
+    {
+        const QSize viewportSize = mView->viewport()->size();
+        const int columns = viewportSize.width() / itemWidth() + 2;
+        const int rows = viewportSize.height() / itemHeight() + 2;
+        const qreal dpr = mView->viewport()->devicePixelRatioF();
+        const qreal frameCost = itemWidth() * itemHeight() * dpr * dpr * 4 / 1024;
+        // Do not go over 1 GB on huge screens, even if it means missing
+        const qreal cost = qMin(2 * columns * rows * frameCost, qreal(1024 * 1024));
+        mFrameCache.setMaxCost(qMax(MIN_FRAME_CACHE_SIZE, int(cost)));
     }
 };
 
@@ -580,6 +763,9 @@ PreviewItemDelegate::PreviewItemDelegate(ThumbnailView* view)
 {
     d->q = this;
     d->mView = view;
+    d->mElidedTextCache.setMaxCost(ELIDED_TEXT_CACHE_SIZE);
+    d->mShadowCache.setMaxCost(SHADOW_CACHE_SIZE);
+    d->mFrameCache.setMaxCost(MIN_FRAME_CACHE_SIZE);
     view->viewport()->installEventFilter(this);
 
     // Set this attribute so that the viewport receives QEvent::HoverMove and
@@ -668,6 +854,16 @@ bool PreviewItemDelegate::eventFilter(QObject* object, QEvent* event)
         case QEvent::MouseButtonRelease:
             return d->mouseButtonEventFilter(event->type());
 
+        case QEvent::FontChange:
+        case QEvent::PaletteChange:
+        case QEvent::StyleChange:
+            d->clearPaintCaches();
+            return false;
+
+        case QEvent::Resize:
+            d->updateFrameCacheSize();
+            return false;
+
         default:
             return false;
         }
@@ -680,11 +876,9 @@ bool PreviewItemDelegate::eventFilter(QObject* object, QEvent* event)
 
 void PreviewItemDelegate::paint(QPainter * painter, const QStyleOptionViewItem & option, const QModelIndex & index) const
 {
-    int thumbnailHeight = d->mThumbnailSize.height();
     QSize fullSize;
-    QPixmap thumbnailPix = d->mView->thumbnailForIndex(index, &fullSize);
+    const AtlasPixmap thumbnailPix = d->mView->thumbnailForIndex(index, &fullSize);
     const KFileItem fileItem = fileItemForIndex(index);
-    const bool opaque = !thumbnailPix.hasAlphaChannel();
     const bool isDirOrArchive = ArchiveUtils::fileItemIsDirOrArchive(fileItem);
     QRect rect = option.rect;
     const bool selected = option.state & QStyle::State_Selected;
@@ -719,33 +913,51 @@ void PreviewItemDelegate::paint(QPainter * painter, const QStyleOptionViewItem &
     }
     fgColor = viewport->palette().color(viewport->foregroundRole());
 
-    // Compute thumbnailRect
-    QRect thumbnailRect = QRect(
-                              rect.left() + (rect.width() - thumbnailPix.width()) / 2,
-                              rect.top() + (thumbnailHeight - thumbnailPix.height()) + ITEM_MARGIN,
-                              thumbnailPix.width(),
-                              thumbnailPix.height());
-
-    // Draw background
-    const QRect backgroundRect = thumbnailRect.adjusted(-ITEM_MARGIN, -ITEM_MARGIN, ITEM_MARGIN, ITEM_MARGIN);
-    if (selected) {
-        d->drawBackground(painter, backgroundRect, bgColor, borderColor);
-    } else if (underMouse) {
-        painter->setOpacity(0.2);
-        d->drawBackground(painter, backgroundRect, bgColor, borderColor);
-        painter->setOpacity(1.);
-    } else if (opaque) {
-        d->drawShadow(painter, thumbnailRect);
-    }
-
-    // Draw thumbnail
-    if (opaque) {
-        painter->setPen(borderColor);
-        painter->setRenderHint(QPainter::Antialiasing, false);
-        QRect borderRect = thumbnailRect.adjusted(-1, -1, 0, 0);
-        painter->drawRect(borderRect);
+    ItemFrame frame;
+    frame.mThumbnailKey = thumbnailPix.cacheKey();
+    frame.mSize = rect.size();
+    frame.mDevicePixelRatio = painter->device()->devicePixelRatioF();
+    frame.mSelected = selected;
+    frame.mUnderMouse = underMouse;
+    frame.mBgColor = bgColor.rgba();
+    frame.mBorderColor = borderColor.rgba();
+    frame.mFgColor = fgColor.rgba();
+    frame.mRating = -1;
+
+    if (isDirOrArchive || (d->mDetails & PreviewItemDelegate::FileNameDetail)) {
+        frame.mTextLines << index.data().toString();
+    }
+
+    if (!isDirOrArchive && (d->mDetails & PreviewItemDelegate::DateDetail)) {
+        const QDateTime dt = TimeUtils::dateTimeForFileItem(fileItem);
+        frame.mTextLines << QLocale().toString(dt, QLocale::ShortFormat);
+    }
+
+    if (!isDirOrArchive && (d->mDetails & PreviewItemDelegate::ImageSizeDetail)) {
+        if (fullSize.isValid()) {
+            frame.mTextLines << QString("%1x%2").arg(fullSize.width()).arg(fullSize.height());
+        }
+    }
+
+    if (!isDirOrArchive && (d->mDetails & PreviewItemDelegate::FileSizeDetail)) {
+        const KIO::filesize_t size = fileItem.size();
+        if (size > 0) {
+            frame.mTextLines << KIO::convertSize(size);
+        }
+    }
+
+    if (!isDirOrArchive && (d->mDetails & PreviewItemDelegate::RatingDetail)) {
+#ifndef GWENVIEW_SEMANTICINFO_BACKEND_NONE
+        frame.mRating = index.data(SemanticInfoDirModel::RatingRole).toInt();
+#endif
+    }
+
+    if (frame.mRating >= 0 && index == d->mIndexUnderCursor) {
+        // The hovered rating follows the cursor, do not cache it
+        d->drawItemFrame(painter, rect, thumbnailPix, frame, d->hoverRatingForIndexRect(rect));
+    } else {
+        d->drawCachedItemFrame(painter, rect, thumbnailPix, frame);
     }
-    painter->drawPixmap(thumbnailRect.left(), thumbnailRect.top(), thumbnailPix);
 
     // Draw modified indicator
     bool isModified = d->mView->isModified(index);
@@ -759,6 +971,7 @@ void PreviewItemDelegate::paint(QPainter * painter, const QStyleOptionViewItem &
 
     // Draw busy indicator
     if (d->mView->isBusy(index)) {
+        const QRect thumbnailRect = d->thumbnailRectFromIndexRect(rect, thumbnailPix);
         QPixmap pix = d->mView->busySequenceCurrentPixmap();
         painter->drawPixmap(
             thumbnailRect.left() + (thumbnailRect.width() - pix.width()) / 2,
@@ -784,45 +997,6 @@ void PreviewItemDelegate::paint(QPainter * painter, const QStyleOptionViewItem &
         }
     }
 
-    QRect textRect(
-        rect.left() + ITEM_MARGIN,
-        rect.top() + 2 * ITEM_MARGIN + thumbnailHeight,
-        rect.width() - 2 * ITEM_MARGIN,
-        d->mView->fontMetrics().height());
-    if (isDirOrArchive || (d->mDetails & PreviewItemDelegate::FileNameDetail)) {
-        d->drawText(painter, textRect, fgColor, index.data().toString());
-        textRect.moveTop(textRect.bottom());
-    }
-
-    if (!isDirOrArchive && (d->mDetails & PreviewItemDelegate::DateDetail)) {
-        const QDateTime dt = TimeUtils::dateTimeForFileItem(fileItem);
-        d->drawText(painter, textRect, fgColor, QLocale().toString(dt, QLocale::ShortFormat));
-        textRect.moveTop(textRect.bottom());
-    }
-
-    if (!isDirOrArchive && (d->mDetails & PreviewItemDelegate::ImageSizeDetail)) {
-        if (fullSize.isValid()) {
-            const QString text = QString("%1x%2").arg(fullSize.width()).arg(fullSize.height());
-            d->drawText(painter, textRect, fgColor, text);
-            textRect.moveTop(textRect.bottom());
-        }
-    }
-
-    if (!isDirOrArchive && (d->mDetails & PreviewItemDelegate::FileSizeDetail)) {
-        const KIO::filesize_t size = fileItem.size();
-        if (size > 0) {
-            const QString st = KIO::convertSize(size);
-            d->drawText(painter, textRect, fgColor, st);
-            textRect.moveTop(textRect.bottom());
-        }
-    }
-
-    if (!isDirOrArchive && (d->mDetails & PreviewItemDelegate::RatingDetail)) {
-#ifndef GWENVIEW_SEMANTICINFO_BACKEND_NONE
-        d->drawRating(painter, rect, index.data(SemanticInfoDirModel::RatingRole));
-#endif
-    }
-
 #ifdef DEBUG_DRAW_CURRENT
     if (d->mView->currentIndex() == index) {
         painter->fillRect(rect.left(), rect.top(), 12, 12, Qt::red);
@@ -835,7 +1009,7 @@ void PreviewItemDelegate::setThumbnailSize(const QSize& value)
     d->mThumbnailSize = value;
     d->updateViewGridSize();
     d->updateContextBar();
-    d->mElidedTextCache.clear();
+    d->clearPaintCaches();
 }
 
 void PreviewItemDelegate::slotSaveClicked()
@@ -900,7 +1074,7 @@ void PreviewItemDelegate::setTextElideMode(Qt::TextElideMode mode)
         return;
     }
     d->mTextElideMode = mode;
-    d->mElidedTextCache.clear();
+    d->clearPaintCaches();
     d->mView->viewport()->update();
 }
 
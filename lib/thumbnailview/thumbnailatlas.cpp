@@ -0,0 +1,330 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+// Self
+#include "thumbnailatlas.h"
+
+// Qt
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QVector>
+
+namespace Gwenview
+{
+
+/**
+ * Shelf heights are rounded up to a multiple of this, so that pixmaps whose
+ * heights differ a little share shelves
+ */
+static const int SHELF_HEIGHT_STEP = 8;
+
+struct AtlasSpan
+{
+    int mX;
+    int mWidth;
+};
+
+struct AtlasShelf
+{
+    int mY;
+    int mHeight;
+    /// Where the never used part of the shelf starts
+    int mX;
+    /// Parts freed by remove()
+    QVector<AtlasSpan> mFreeSpans;
+    int mEntryCount;
+};
+
+struct AtlasPage
+{
+    QPixmap mPixmap;
+    QVector<AtlasShelf> mShelves;
+    /// Bottom of the last shelf
+    int mUsedHeight;
+    QSet<int> mIds;
+    uint mLastPaint;
+};
+
+struct AtlasEntry
+{
+    AtlasPage* mPage;
+    int mShelf;
+    QRect mRect;
+    bool mHasAlphaChannel;
+};
+
+struct ThumbnailAtlasPrivate
+{
+    QSize mPageSize;
+    int mMaxPageCount;
+    QList<AtlasPage*> mPages;
+    QHash<int, AtlasEntry> mEntries;
+    int mNextId;
+    uint mPaint;
+
+    AtlasPage* createPage(const QSize& size)
+    {
+        AtlasPage* page = new AtlasPage;
+        page->mPixmap = QPixmap(size);
+        page->mPixmap.fill(Qt::transparent);
+        page->mUsedHeight = 0;
+        page->mLastPaint = mPaint;
+        mPages << page;
+        return page;
+    }
+
+    void deletePage(AtlasPage* page)
+    {
+        Q_FOREACH(int id, page->mIds) {
+            mEntries.remove(id);
+        }
+        mPages.removeOne(page);
+        delete page;
+    }
+
+    void recyclePage(AtlasPage* page)
+    {
+        Q_FOREACH(int id, page->mIds) {
+            mEntries.remove(id);
+        }
+        page->mIds.clear();
+        page->mShelves.clear();
+        page->mUsedHeight = 0;
+    }
+
+    bool isStandardPage(const AtlasPage* page) const
+    {
+        return page->mPixmap.size() == mPageSize;
+    }
+
+    /**
+     * Finds room for @p size in @p page. Returns false if there is none.
+     */
+    bool allocate(AtlasPage* page, const QSize& size, int* shelfIndex, QPoint* pos)
+    {
+        for (int index = 0; index < page->mShelves.count(); ++index) {
+            AtlasShelf& shelf = page->mShelves[index];
+            // Do not waste more than a quarter of a shelf
+            if (size.height() > shelf.mHeight || size.height() * 4 < shelf.mHeight * 3) {
+                continue;
+            }
+            for (int spanIndex = 0; spanIndex < shelf.mFreeSpans.count(); ++spanIndex) {
+                AtlasSpan& span = shelf.mFreeSpans[spanIndex];
+                if (span.mWidth < size.width()) {
+                    continue;
+                }
+                *pos = QPoint(span.mX, shelf.mY);
+                span.mX += size.width();
+                span.mWidth -= size.width();
+                if (span.mWidth == 0) {
+                    shelf.mFreeSpans.remove(spanIndex);
+                }
+                *shelfIndex = index;
+                return true;
+            }
+            if (shelf.mX + size.width() <= page->mPixmap.width()) {
+                *pos = QPoint(shelf.mX, shelf.mY);
+                shelf.mX += size.width();
+                *shelfIndex = index;
+                return true;
+            }
+        }
+
+        // Open a new shelf
+        const int remainingHeight = page->mPixmap.height() - page->mUsedHeight;
+        if (size.height() > remainingHeight || size.width() > page->mPixmap.width()) {
+            return false;
+        }
+        const int roundedHeight = (size.height() + SHELF_HEIGHT_STEP - 1) / SHELF_HEIGHT_STEP * SHELF_HEIGHT_STEP;
+        AtlasShelf shelf;
+        shelf.mY = page->mUsedHeight;
+        shelf.mHeight = qMin(roundedHeight, remainingHeight);
+        shelf.mX = size.width();
+        shelf.mEntryCount = 0;
+        page->mShelves << shelf;
+        page->mUsedHeight += shelf.mHeight;
+        *shelfIndex = page->mShelves.count() - 1;
+        *pos = QPoint(0, shelf.mY);
+        return true;
+    }
+
+    AtlasPage* findRoom(const QSize& size, int* shelfIndex, QPoint* pos)
+    {
+        Q_FOREACH(AtlasPage* page, mPages) {
+            if (isStandardPage(page) && allocate(page, size, shelfIndex, pos)) {
+                return page;
+            }
+        }
+
+        AtlasPage* page = 0;
+        if (mPages.count() >= mMaxPageCount) {
+            // Recycle the least recently used page, unless the current paint
+            // needs all of them
+            AtlasPage* oldest = 0;
+            Q_FOREACH(AtlasPage* candidate, mPages) {
+                if (candidate->mLastPaint != mPaint
+                        && (!oldest || candidate->mLastPaint < oldest->mLastPaint)) {
+                    oldest = candidate;
+                }
+            }
+            if (oldest && isStandardPage(oldest)) {
+                recyclePage(oldest);
+                page = oldest;
+            } else if (oldest) {
+                deletePage(oldest);
+            }
+        }
+        if (!page) {
+            page = createPage(mPageSize);
+        }
+        const bool ok = allocate(page, size, shelfIndex, pos);
+        Q_ASSERT(ok);
+        Q_UNUSED(ok);
+        return page;
+    }
+
+    void release(const AtlasEntry& entry)
+    {
+        AtlasPage* page = entry.mPage;
+        AtlasShelf& shelf = page->mShelves[entry.mShelf];
+        --shelf.mEntryCount;
+        if (shelf.mEntryCount > 0) {
+            if (entry.mRect.right() + 1 == shelf.mX) {
+                shelf.mX = entry.mRect.left();
+            } else {
+                AtlasSpan span;
+                span.mX = entry.mRect.left();
+                span.mWidth = entry.mRect.width();
+                shelf.mFreeSpans << span;
+            }
+            return;
+        }
+        shelf.mX = 0;
+        shelf.mFreeSpans.clear();
+        // Give the height of empty shelves at the bottom back to the page
+        while (!page->mShelves.isEmpty() && page->mShelves.last().mEntryCount == 0) {
+            page->mUsedHeight = page->mShelves.last().mY;
+            page->mShelves.removeLast();
+        }
+    }
+};
+
+ThumbnailAtlas::ThumbnailAtlas(const QSize& pageSize, int maxPageCount)
+: d(new ThumbnailAtlasPrivate)
+{
+    d->mPageSize = pageSize;
+    d->mMaxPageCount = qMax(1, maxPageCount);
+    d->mNextId = 0;
+    d->mPaint = 0;
+}
+
+ThumbnailAtlas::~ThumbnailAtlas()
+{
+    qDeleteAll(d->mPages);
+    delete d;
+}
+
+int ThumbnailAtlas::insert(const QPixmap& pixmap)
+{
+    if (pixmap.isNull()) {
+        return -1;
+    }
+    const QSize size = pixmap.size();
+    int shelfIndex;
+    QPoint pos;
+    AtlasPage* page;
+    if (size.width() > d->mPageSize.width() || size.height() > d->mPageSize.height()) {
+        page = d->createPage(size);
+        d->allocate(page, size, &shelfIndex, &pos);
+    } else {
+        page = d->findRoom(size, &shelfIndex, &pos);
+    }
+
+    QPainter painter(&page->mPixmap);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawPixmap(pos, pixmap);
+    painter.end();
+
+    AtlasEntry entry;
+    entry.mPage = page;
+    entry.mShelf = shelfIndex;
+    entry.mRect = QRect(pos, size);
+    entry.mHasAlphaChannel = pixmap.hasAlphaChannel();
+    ++page->mShelves[shelfIndex].mEntryCount;
+    page->mLastPaint = d->mPaint;
+
+    const int id = d->mNextId++;
+    d->mEntries.insert(id, entry);
+    page->mIds << id;
+    return id;
+}
+
+AtlasPixmap ThumbnailAtlas::pixmap(int id)
+{
+    QHash<int, AtlasEntry>::ConstIterator it = d->mEntries.constFind(id);
+    if (it == d->mEntries.constEnd()) {
+        return AtlasPixmap();
+    }
+    const AtlasEntry& entry = it.value();
+    entry.mPage->mLastPaint = d->mPaint;
+    // Negative keys cannot collide with QPixmap::cacheKey()
+    return AtlasPixmap(entry.mPage->mPixmap, entry.mRect, -qint64(id) - 1, entry.mHasAlphaChannel);
+}
+
+void ThumbnailAtlas::remove(int id)
+{
+    QHash<int, AtlasEntry>::Iterator it = d->mEntries.find(id);
+    if (it == d->mEntries.end()) {
+        return;
+    }
+    const AtlasEntry entry = it.value();
+    d->mEntries.erase(it);
+    AtlasPage* page = entry.mPage;
+    page->mIds.remove(id);
+    d->release(entry);
+    if (page->mIds.isEmpty() && (!d->isStandardPage(page) || d->mPages.count() > d->mMaxPageCount)) {
+        d->deletePage(page);
+    }
+}
+
+void ThumbnailAtlas::clear()
+{
+    qDeleteAll(d->mPages);
+    d->mPages.clear();
+    d->mEntries.clear();
+}
+
+void ThumbnailAtlas::startPaint()
+{
+    ++d->mPaint;
+}
+
+int ThumbnailAtlas::pageCount() const
+{
+    return d->mPages.count();
+}
+
+int ThumbnailAtlas::count() const
+{
+    return d->mEntries.count();
+}
+
+} // namespace
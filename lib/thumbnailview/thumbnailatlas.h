@@ -0,0 +1,174 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#ifndef THUMBNAILATLAS_H
+#define THUMBNAILATLAS_H
+
+#include <lib/gwenviewlib_export.h>
+
+// Qt
+#include <QPainter>
+#include <QPixmap>
+#include <QRect>
+
+namespace Gwenview
+{
+
+/**
+ * A part of a pixmap, usually a thumbnail stored in a ThumbnailAtlas page
+ */
+class GWENVIEWLIB_EXPORT AtlasPixmap
+{
+public:
+    AtlasPixmap()
+    : mKey(0)
+    , mHasAlphaChannel(false)
+    {}
+
+    /**
+     * Wraps the whole of @p pixmap
+     */
+    AtlasPixmap(const QPixmap& pixmap)
+    : mPixmap(pixmap)
+    , mRect(pixmap.rect())
+    , mKey(pixmap.cacheKey())
+    , mHasAlphaChannel(pixmap.hasAlphaChannel())
+    {}
+
+    AtlasPixmap(const QPixmap& page, const QRect& rect, qint64 key, bool hasAlphaChannel)
+    : mPixmap(page)
+    , mRect(rect)
+    , mKey(key)
+    , mHasAlphaChannel(hasAlphaChannel)
+    {}
+
+    bool isNull() const
+    {
+        return mPixmap.isNull();
+    }
+
+    QSize size() const
+    {
+        return mRect.size();
+    }
+
+    int width() const
+    {
+        return mRect.width();
+    }
+
+    int height() const
+    {
+        return mRect.height();
+    }
+
+    /**
+     * Whether the thumbnail has an alpha channel. The atlas pages always
+     * have one.
+     */
+    bool hasAlphaChannel() const
+    {
+        return mHasAlphaChannel;
+    }
+
+    /**
+     * Identifies the content, like QPixmap::cacheKey()
+     */
+    qint64 cacheKey() const
+    {
+        return mKey;
+    }
+
+    void draw(QPainter* painter, const QPoint& pos) const
+    {
+        painter->drawPixmap(pos, mPixmap, mRect);
+    }
+
+    /**
+     * Returns a standalone copy of the thumbnail
+     */
+    QPixmap toPixmap() const
+    {
+        return mPixmap.rect() == mRect ? mPixmap : mPixmap.copy(mRect);
+    }
+
+private:
+    QPixmap mPixmap;
+    QRect mRect;
+    qint64 mKey;
+    bool mHasAlphaChannel;
+};
+
+struct ThumbnailAtlasPrivate;
+/**
+ * Stores many small pixmaps in a few large pages, so that thumbnail views
+ * do not need one pixmap per item.
+ *
+ * Pages are filled with shelves: rows of pixmaps of similar heights. Space
+ * freed by remove() is reused by pixmaps of the same shelf. When all the
+ * pages are full, the page which has been used the least recently is
+ * recycled, and the pixmaps it contained are dropped: pixmap() returns a
+ * null AtlasPixmap for them, and the caller must insert them again.
+ *
+ * Pages used since the last call to startPaint() are never recycled, so
+ * that a paint does not evict what it has just drawn. If they are all in
+ * use, a page is added over the limit, and removed once it is empty.
+ */
+class GWENVIEWLIB_EXPORT ThumbnailAtlas
+{
+public:
+    explicit ThumbnailAtlas(const QSize& pageSize = QSize(1024, 1024), int maxPageCount = 16);
+    ~ThumbnailAtlas();
+
+    /**
+     * Copies @p pixmap in a page and returns the id of the copy. Pixmaps
+     * bigger than a page get a page for themselves.
+     */
+    int insert(const QPixmap& pixmap);
+
+    /**
+     * Returns the pixmap with id @p id, or a null one if it has been removed
+     * or evicted. Do not keep the result: as long as it exists, inserting a
+     * pixmap in its page copies the whole page.
+     */
+    AtlasPixmap pixmap(int id);
+
+    void remove(int id);
+
+    void clear();
+
+    /**
+     * Tells the atlas a new paint starts: pages only used by previous paints
+     * can be recycled
+     */
+    void startPaint();
+
+    int pageCount() const;
+
+    int count() const;
+
+private:
+    ThumbnailAtlasPrivate* const d;
+    Q_DISABLE_COPY(ThumbnailAtlas)
+};
+
+} // namespace
+
+#endif /* THUMBNAILATLAS_H */
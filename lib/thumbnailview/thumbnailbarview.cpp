@@ -170,7 +170,7 @@ QSize ThumbnailBarItemDelegate::sizeHint(const QStyleOptionViewItem & /*option*/
     if (d->mView->thumbnailScaleMode() == ThumbnailView::ScaleToFit) {
         size = d->mView->gridSize();
     } else {
-        QPixmap thumbnailPix = d->mView->thumbnailForIndex(index);
+        const AtlasPixmap thumbnailPix = d->mView->thumbnailForIndex(index);
         size = thumbnailPix.size();
         size.rwidth() += ITEM_MARGIN * 2;
         size.rheight() += ITEM_MARGIN * 2;
@@ -198,7 +198,7 @@ void ThumbnailBarItemDelegate::paint(QPainter * painter, const QStyleOptionViewI
 {
     bool isSelected = option.state & QStyle::State_Selected;
     bool isCurrent = d->mView->selectionModel()->currentIndex() == index;
-    QPixmap thumbnailPix = d->mView->thumbnailForIndex(index);
+    const AtlasPixmap thumbnailPix = d->mView->thumbnailForIndex(index);
     QRect rect = option.rect;
 
     QStyleOptionViewItem opt = option;
@@ -227,7 +227,7 @@ void ThumbnailBarItemDelegate::paint(QPainter * painter, const QStyleOptionViewI
             QRect borderRect = thumbnailRect.adjusted(-1, -1, 0, 0);
             painter->drawRect(borderRect);
         }
-        painter->drawPixmap(thumbnailRect.left(), thumbnailRect.top(), thumbnailPix);
+        thumbnailPix.draw(painter, thumbnailRect.topLeft());
 
         // Draw busy indicator
         if (d->mView->isBusy(index)) {
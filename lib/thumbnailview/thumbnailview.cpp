@@ -36,6 +36,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QMimeData>
 #include <QDebug>
 #include <QDateTime>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 
 // KDE
 #include <KDirModel>
@@ -49,6 +51,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "archiveutils.h"
 #include "dragpixmapgenerator.h"
 #include "mimetypeutils.h"
+#include "traceutils.h"
 #include "urlutils.h"
 #include <lib/gvdebug.h>
 #include <lib/thumbnailprovider/thumbnailprovider.h>
@@ -68,8 +71,83 @@ namespace Gwenview
 /** How many msec to wait before starting to smooth thumbnails */
 const int SMOOTH_DELAY = 500;
 
+/** How many thumbnails are smoothed by one batch of tasks */
+const int SMOOTH_BATCH_SIZE = 64;
+
+/**
+ * Smooth thumbnails are created for thumbnail widths rounded up to a
+ * multiple of this, and scaled down with a fast transformation. This way
+ * small zoom changes do not require smoothing thumbnails again.
+ */
+const int SMOOTH_SIZE_STEP = 16;
+
+/** How many smooth thumbnail sizes are kept for each item */
+const int MAX_SMOOTH_VARIANTS = 2;
+
 const int WHEEL_ZOOM_MULTIPLIER = 4;
 
+/** How many pages of thumbnails to prefetch before and after the visible ones */
+const int PREFETCH_PAGES = 1;
+
+/**
+ * Scales @p pix, which can be a QPixmap or a QImage, to fit @p size according
+ * to @p scaleMode
+ */
+template <class Image>
+static Image scaleThumbnail(const Image& pix, const QSize& size, ThumbnailView::ThumbnailScaleMode scaleMode, Qt::TransformationMode transformationMode)
+{
+    switch (scaleMode) {
+    case ThumbnailView::ScaleToFit:
+        return pix.scaled(size.width(), size.height(), Qt::KeepAspectRatio, transformationMode);
+        break;
+    case ThumbnailView::ScaleToSquare: {
+        int minSize = qMin(pix.width(), pix.height());
+        Image pix2 = pix.copy((pix.width() - minSize) / 2, (pix.height() - minSize) / 2, minSize, minSize);
+        return pix2.scaled(size.width(), size.height(), Qt::KeepAspectRatio, transformationMode);
+    }
+    case ThumbnailView::ScaleToHeight:
+        return pix.scaledToHeight(size.height(), transformationMode);
+        break;
+    case ThumbnailView::ScaleToWidth:
+        return pix.scaledToWidth(size.width(), transformationMode);
+        break;
+    }
+    // Keep compiler happy
+    Q_ASSERT(0);
+    return Image();
+}
+
+/**
+ * A thumbnail to smooth on a worker thread. QPixmap cannot be used outside
+ * the GUI thread, so this works on a QImage.
+ */
+struct SmoothScaleJob
+{
+    QUrl mUrl;
+    /// cacheKey() of the group pix mImage has been created from
+    qint64 mGroupPixKey;
+    QImage mImage;
+    QSize mSize;
+    ThumbnailView::ThumbnailScaleMode mScaleMode;
+};
+
+static SmoothScaleJob smoothScale(const SmoothScaleJob& job)
+{
+    SmoothScaleJob result = job;
+    result.mImage = scaleThumbnail(job.mImage, job.mSize, job.mScaleMode, Qt::SmoothTransformation);
+    return result;
+}
+
+/**
+ * A smooth version of a group pix, for one thumbnail size
+ */
+struct SmoothVariant
+{
+    QSize mSize;
+    qint64 mGroupPixKey;
+    QPixmap mPix;
+};
+
 static KFileItem fileItemForIndex(const QModelIndex& index)
 {
     if (!index.isValid()) {
@@ -91,12 +169,14 @@ struct Thumbnail
     Thumbnail(const QPersistentModelIndex& index_, const QDateTime& mtime)
         : mIndex(index_)
         , mModificationTime(mtime)
+        , mAtlasId(-1)
         , mFileSize(0)
         , mRough(true)
         , mWaitingForThumbnail(true) {}
 
     Thumbnail()
-        : mFileSize(0)
+        : mAtlasId(-1)
+        , mFileSize(0)
         , mRough(true)
         , mWaitingForThumbnail(true) {}
 
@@ -128,12 +208,39 @@ struct Thumbnail
         return groupSize == qMax(mFullSize.width(), mFullSize.height());
     }
 
+    /**
+     * Returns the smooth version of mGroupPix for thumbnails of @p size, or a
+     * null pixmap if there is none
+     */
+    QPixmap smoothVariant(const QSize& size) const
+    {
+        const qint64 key = mGroupPix.cacheKey();
+        Q_FOREACH(const SmoothVariant& variant, mSmoothVariants) {
+            if (variant.mSize == size && variant.mGroupPixKey == key) {
+                return variant.mPix;
+            }
+        }
+        return QPixmap();
+    }
+
+    void addSmoothVariant(const QSize& size, qint64 groupPixKey, const QPixmap& pix)
+    {
+        SmoothVariant variant;
+        variant.mSize = size;
+        variant.mGroupPixKey = groupPixKey;
+        variant.mPix = pix;
+        mSmoothVariants.prepend(variant);
+        while (mSmoothVariants.count() > MAX_SMOOTH_VARIANTS) {
+            mSmoothVariants.removeLast();
+        }
+    }
+
     void prepareForRefresh(const QDateTime& mtime)
     {
         mModificationTime = mtime;
         mFileSize = 0;
         mGroupPix = QPixmap();
-        mAdjustedPix = QPixmap();
+        mSmoothVariants.clear();
         mFullSize = QSize();
         mRealFullSize = QSize();
         mRough = true;
@@ -144,8 +251,12 @@ struct Thumbnail
     QDateTime mModificationTime;
     /// The pix loaded from .thumbnails/{large,normal}
     QPixmap mGroupPix;
-    /// Scaled version of mGroupPix, adjusted to ThumbnailView::thumbnailSize
-    QPixmap mAdjustedPix;
+    /// Id of the scaled version of mGroupPix, adjusted to
+    /// ThumbnailView::thumbnailSize, in ThumbnailViewPrivate::mAtlas. -1 if
+    /// there is none.
+    int mAtlasId;
+    /// Smooth versions of mGroupPix, most recent first
+    QList<SmoothVariant> mSmoothVariants;
     /// Size of the full image
     QSize mFullSize;
     /// Real size of the full image, invalid unless the thumbnail
@@ -153,7 +264,7 @@ struct Thumbnail
     QSize mRealFullSize;
     /// File size of the full image
     KIO::filesize_t mFileSize;
-    /// Whether mAdjustedPix represents has been scaled using fast or smooth
+    /// Whether the adjusted pix has been scaled using fast or smooth
     /// transformation
     bool mRough;
     /// Set to true if mGroupPix should be replaced with a real thumbnail
@@ -173,10 +284,14 @@ struct ThumbnailViewPrivate
     AbstractDocumentInfoProvider* mDocumentInfoProvider;
     AbstractThumbnailViewHelper* mThumbnailViewHelper;
     ThumbnailForUrl mThumbnailForUrl;
+    /// Stores the adjusted pixes, which are created again when they are
+    /// evicted
+    ThumbnailAtlas mAtlas;
     QTimer mScheduledThumbnailGenerationTimer;
 
     UrlQueue mSmoothThumbnailQueue;
     QTimer mSmoothThumbnailTimer;
+    QFutureWatcher<SmoothScaleJob> mSmoothThumbnailWatcher;
 
     QPixmap mWaitingThumbnail;
     QPointer<ThumbnailProvider> mThumbnailProvider;
@@ -197,8 +312,25 @@ struct ThumbnailViewPrivate
         QObject::connect(mBusyAnimationTimeLine, &QTimeLine::frameChanged, q, &ThumbnailView::updateBusyIndexes);
     }
 
+    qreal devicePixelRatio() const
+    {
+        return q->viewport()->devicePixelRatioF();
+    }
+
+    /**
+     * The group of the thumbnails to generate: on HiDPI screens, thumbnails
+     * are drawn with more device pixels than mThumbnailSize
+     */
+    ThumbnailGroup::Enum thumbnailGroup() const
+    {
+        return ThumbnailGroup::fromPixelSize(mThumbnailSize.width(), devicePixelRatio());
+    }
+
     void scheduleThumbnailGeneration()
     {
+        // Drop the items which have not been started yet: they may have
+        // scrolled out of view. generateThumbnailsForItems() queues the
+        // visible ones again, while requests in flight are kept.
         if (mThumbnailProvider) {
             mThumbnailProvider->removePendingItems();
         }
@@ -211,35 +343,142 @@ struct ThumbnailViewPrivate
         Q_ASSERT(mDocumentInfoProvider);
         KFileItem item = fileItemForIndex(index);
         QUrl url = item.url();
-        ThumbnailGroup::Enum group = ThumbnailGroup::fromPixelSize(mThumbnailSize.width());
+        ThumbnailGroup::Enum group = thumbnailGroup();
         QPixmap pix;
         QSize fullSize;
         mDocumentInfoProvider->thumbnailForDocument(url, group, &pix, &fullSize);
+        ThumbnailForUrl::Iterator it = mThumbnailForUrl.find(url);
+        if (it != mThumbnailForUrl.end()) {
+            releaseAdjustedPix(&it.value());
+        }
         mThumbnailForUrl[url] = Thumbnail(QPersistentModelIndex(index), QDateTime::currentDateTime());
         q->setThumbnail(item, pix, fullSize, 0);
     }
 
+    /**
+     * Returns true if the view scrolls vertically to show more items
+     */
+    bool linesAdvanceVertically() const
+    {
+        return (q->flow() == QListView::LeftToRight) == q->isWrapping();
+    }
+
+    /**
+     * Returns the first row whose item starts at @p pos or after, along the
+     * scrolling axis, or rowCount() if there is none. Items are laid out in
+     * row order, so this is a binary search.
+     */
+    int firstRowAtOrAfter(int pos, bool vertical) const
+    {
+        int low = 0;
+        int high = q->model()->rowCount();
+        while (low < high) {
+            const int mid = (low + high) / 2;
+            const QRect rect = q->visualRect(q->model()->index(mid, 0));
+            if ((vertical ? rect.top() : rect.left()) < pos) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    /**
+     * Adds the item at @p row to @p list, or to @p dirList for directories,
+     * if it needs a thumbnail
+     */
+    void collectItemForRow(int row, KFileItemList* list, KFileItemList* dirList)
+    {
+        const QModelIndex index = q->model()->index(row, 0);
+        const KFileItem item = fileItemForIndex(index);
+        const QUrl url = item.url();
+
+        // Filter out remote items if necessary
+        if (!mCreateThumbnailsForRemoteUrls && !url.isLocalFile()) {
+            return;
+        }
+
+        // Filter out archives
+        MimeTypeUtils::Kind kind = MimeTypeUtils::fileItemKind(item);
+        if (kind == MimeTypeUtils::KIND_ARCHIVE) {
+            return;
+        }
+
+        // Immediately update modified items
+        if (mDocumentInfoProvider && mDocumentInfoProvider->isModified(url)) {
+            updateThumbnailForModifiedDocument(index);
+            return;
+        }
+
+        // Filter out items which already have a thumbnail
+        ThumbnailForUrl::ConstIterator it = mThumbnailForUrl.constFind(url);
+        if (it != mThumbnailForUrl.constEnd() && it.value().isGroupPixAdaptedForSize(qRound(mThumbnailSize.height() * devicePixelRatio()))) {
+            return;
+        }
+
+        if (kind == MimeTypeUtils::KIND_DIR) {
+            *dirList << item;
+        } else {
+            *list << item;
+        }
+
+        // Insert the thumbnail in mThumbnailForUrl, so that
+        // setThumbnail() can find the item to update
+        if (it == mThumbnailForUrl.constEnd()) {
+            Thumbnail thumbnail = Thumbnail(QPersistentModelIndex(index), item.time(KFileItem::ModificationTime));
+            mThumbnailForUrl.insert(url, thumbnail);
+        }
+    }
+
     void appendItemsToThumbnailProvider(const KFileItemList& list)
     {
         if (mThumbnailProvider) {
-            ThumbnailGroup::Enum group = ThumbnailGroup::fromPixelSize(mThumbnailSize.width());
+            ThumbnailGroup::Enum group = thumbnailGroup();
             mThumbnailProvider->setThumbnailGroup(group);
             mThumbnailProvider->appendItems(list);
         }
     }
 
+    /**
+     * The size smooth thumbnails are created for
+     */
+    QSize smoothThumbnailSize() const
+    {
+        const int width = (mThumbnailSize.width() + SMOOTH_SIZE_STEP - 1) / SMOOTH_SIZE_STEP * SMOOTH_SIZE_STEP;
+        return QSize(width, qRound(width / mThumbnailAspectRatio));
+    }
+
+    void releaseAdjustedPix(Thumbnail* thumbnail)
+    {
+        mAtlas.remove(thumbnail->mAtlasId);
+        thumbnail->mAtlasId = -1;
+    }
+
     void roughAdjustThumbnail(Thumbnail* thumbnail)
     {
+        releaseAdjustedPix(thumbnail);
         const QPixmap& mGroupPix = thumbnail->mGroupPix;
         const int groupSize = qMax(mGroupPix.width(), mGroupPix.height());
         const int fullSize = qMax(thumbnail->mFullSize.width(), thumbnail->mFullSize.height());
+        QPixmap adjustedPix;
         if (fullSize == groupSize && mGroupPix.height() <= mThumbnailSize.height() && mGroupPix.width() <= mThumbnailSize.width()) {
-            thumbnail->mAdjustedPix = mGroupPix;
+            adjustedPix = mGroupPix;
             thumbnail->mRough = false;
         } else {
-            thumbnail->mAdjustedPix = scale(mGroupPix, Qt::FastTransformation);
-            thumbnail->mRough = true;
+            const QPixmap smoothPix = thumbnail->smoothVariant(smoothThumbnailSize());
+            if (!smoothPix.isNull()) {
+                // smoothPix is at most SMOOTH_SIZE_STEP pixels bigger: scaling
+                // it down smoothly is much cheaper than smoothing mGroupPix
+                // again, and unlike a fast scale, keeps every row and column
+                adjustedPix = scale(smoothPix, Qt::SmoothTransformation);
+                thumbnail->mRough = false;
+            } else {
+                adjustedPix = scale(mGroupPix, Qt::FastTransformation);
+                thumbnail->mRough = true;
+            }
         }
+        thumbnail->mAtlasId = mAtlas.insert(adjustedPix);
     }
 
     void initDragPixmap(QDrag* drag, const QModelIndexList& indexes)
@@ -247,8 +486,7 @@ struct ThumbnailViewPrivate
         const int thumbCount = qMin(indexes.count(), int(DragPixmapGenerator::MaxCount));
         QList<QPixmap> lst;
         for (int row = 0; row < thumbCount; ++row) {
-            const QUrl url = urlForIndex(indexes[row]);
-            lst << mThumbnailForUrl.value(url).mAdjustedPix;
+            lst << q->thumbnailForIndex(indexes[row]).toPixmap();
         }
         DragPixmapGenerator::DragPixmap dragPixmap = DragPixmapGenerator::generate(lst, indexes.count());
         drag->setPixmap(dragPixmap.pix);
@@ -257,25 +495,7 @@ struct ThumbnailViewPrivate
 
     QPixmap scale(const QPixmap& pix, Qt::TransformationMode transformationMode)
     {
-        switch (mScaleMode) {
-        case ThumbnailView::ScaleToFit:
-            return pix.scaled(mThumbnailSize.width(), mThumbnailSize.height(), Qt::KeepAspectRatio, transformationMode);
-            break;
-        case ThumbnailView::ScaleToSquare: {
-            int minSize = qMin(pix.width(), pix.height());
-            QPixmap pix2 = pix.copy((pix.width() - minSize) / 2, (pix.height() - minSize) / 2, minSize, minSize);
-            return pix2.scaled(mThumbnailSize.width(), mThumbnailSize.height(), Qt::KeepAspectRatio, transformationMode);
-        }
-        case ThumbnailView::ScaleToHeight:
-            return pix.scaledToHeight(mThumbnailSize.height(), transformationMode);
-            break;
-        case ThumbnailView::ScaleToWidth:
-            return pix.scaledToWidth(mThumbnailSize.width(), transformationMode);
-            break;
-        }
-        // Keep compiler happy
-        Q_ASSERT(0);
-        return QPixmap();
+        return scaleThumbnail(pix, mThumbnailSize, mScaleMode, transformationMode);
     }
 };
 
@@ -314,7 +534,9 @@ ThumbnailView::ThumbnailView(QWidget* parent)
     connect(&d->mScheduledThumbnailGenerationTimer, &QTimer::timeout, this, &ThumbnailView::generateThumbnailsForItems);
 
     d->mSmoothThumbnailTimer.setSingleShot(true);
-    connect(&d->mSmoothThumbnailTimer, &QTimer::timeout, this, &ThumbnailView::smoothNextThumbnail);
+    connect(&d->mSmoothThumbnailTimer, &QTimer::timeout, this, &ThumbnailView::smoothThumbnails);
+    connect(&d->mSmoothThumbnailWatcher, &QFutureWatcherBase::resultReadyAt, this, &ThumbnailView::setSmoothThumbnail);
+    connect(&d->mSmoothThumbnailWatcher, &QFutureWatcherBase::finished, this, &ThumbnailView::smoothThumbnails);
 
     setContextMenuPolicy(Qt::CustomContextMenu);
     connect(this, &ThumbnailView::customContextMenuRequested, this, &ThumbnailView::showContextMenu);
@@ -324,6 +546,7 @@ ThumbnailView::ThumbnailView(QWidget* parent)
 
 ThumbnailView::~ThumbnailView()
 {
+    d->mSmoothThumbnailWatcher.cancel();
     delete d;
 }
 
@@ -381,17 +604,21 @@ void ThumbnailView::updateThumbnailSize()
     painter.end();
     d->mWaitingThumbnail = pix;
 
-    // Stop smoothing
+    // Stop smoothing. Results of running tasks are ignored if their size does
+    // not match anymore.
     d->mSmoothThumbnailTimer.stop();
     d->mSmoothThumbnailQueue.clear();
+    d->mSmoothThumbnailWatcher.cancel();
 
-    // Clear adjustedPixes
+    // Clear adjustedPixes, they are created again from the smooth variants
+    // if there is one for the new size
     ThumbnailForUrl::iterator
     it = d->mThumbnailForUrl.begin(),
     end = d->mThumbnailForUrl.end();
     for (; it != end; ++it) {
-        it.value().mAdjustedPix = QPixmap();
+        it.value().mAtlasId = -1;
     }
+    d->mAtlas.clear();
 
     thumbnailSizeChanged(value);
     thumbnailWidthChanged(value.width());
@@ -474,7 +701,11 @@ void ThumbnailView::rowsAboutToBeRemoved(const QModelIndex& parent, int start, i
         }
 
         QUrl url = item.url();
-        d->mThumbnailForUrl.remove(url);
+        ThumbnailForUrl::Iterator it = d->mThumbnailForUrl.find(url);
+        if (it != d->mThumbnailForUrl.end()) {
+            d->releaseAdjustedPix(&it.value());
+            d->mThumbnailForUrl.erase(it);
+        }
         d->mSmoothThumbnailQueue.removeAll(url);
 
         itemList.append(item);
@@ -523,6 +754,7 @@ void ThumbnailView::dataChanged(const QModelIndex& topLeft, const QModelIndex& b
                 // avoid needless refreshes, we only trigger a refresh if the
                 // modification time changes.
                 thumbnailsNeedRefresh = true;
+                d->releaseAdjustedPix(&it.value());
                 it->prepareForRefresh(mtime);
             }
         }
@@ -552,7 +784,7 @@ void ThumbnailView::setThumbnail(const KFileItem& item, const QPixmap& pixmap, c
     }
     Thumbnail& thumbnail = it.value();
     thumbnail.mGroupPix = pixmap;
-    thumbnail.mAdjustedPix = QPixmap();
+    d->releaseAdjustedPix(&thumbnail);
     int largeGroupSize = ThumbnailGroup::pixelSize(ThumbnailGroup::Large);
     thumbnail.mFullSize = size.isValid() ? size : QSize(largeGroupSize, largeGroupSize);
     thumbnail.mRealFullSize = size;
@@ -591,7 +823,7 @@ void ThumbnailView::setBrokenThumbnail(const KFileItem& item)
     update(thumbnail.mIndex);
 }
 
-QPixmap ThumbnailView::thumbnailForIndex(const QModelIndex& index, QSize* fullSize)
+AtlasPixmap ThumbnailView::thumbnailForIndex(const QModelIndex& index, QSize* fullSize)
 {
     KFileItem item = fileItemForIndex(index);
     if (item.isNull()) {
@@ -599,7 +831,7 @@ QPixmap ThumbnailView::thumbnailForIndex(const QModelIndex& index, QSize* fullSi
         if (fullSize) {
             *fullSize = QSize();
         }
-        return QPixmap();
+        return AtlasPixmap();
     }
     QUrl url = item.url();
 
@@ -644,9 +876,12 @@ QPixmap ThumbnailView::thumbnailForIndex(const QModelIndex& index, QSize* fullSi
         return d->mWaitingThumbnail;
     }
 
-    // Adjust thumbnail
-    if (thumbnail.mAdjustedPix.isNull()) {
+    // Adjust thumbnail. The atlas may have evicted the adjusted pix since
+    // the last paint.
+    AtlasPixmap adjustedPix = d->mAtlas.pixmap(thumbnail.mAtlasId);
+    if (adjustedPix.isNull()) {
         d->roughAdjustThumbnail(&thumbnail);
+        adjustedPix = d->mAtlas.pixmap(thumbnail.mAtlasId);
     }
     if (thumbnail.mRough && !d->mSmoothThumbnailQueue.contains(url)) {
         d->mSmoothThumbnailQueue.enqueue(url);
@@ -657,7 +892,7 @@ QPixmap ThumbnailView::thumbnailForIndex(const QModelIndex& index, QSize* fullSi
     if (fullSize) {
         *fullSize = thumbnail.mRealFullSize;
     }
-    return thumbnail.mAdjustedPix;
+    return adjustedPix;
 }
 
 bool ThumbnailView::isModified(const QModelIndex& index) const
@@ -738,6 +973,12 @@ void ThumbnailView::keyPressEvent(QKeyEvent* event)
     }
 }
 
+void ThumbnailView::paintEvent(QPaintEvent* event)
+{
+    d->mAtlas.startPaint();
+    QListView::paintEvent(event);
+}
+
 void ThumbnailView::resizeEvent(QResizeEvent* event)
 {
     QListView::resizeEvent(event);
@@ -790,82 +1031,50 @@ void ThumbnailView::scrollContentsBy(int dx, int dy)
 
 void ThumbnailView::generateThumbnailsForItems()
 {
-    if (!isVisible() || !model()) {
+    if (!isVisible() || !model() || model()->rowCount() == 0) {
         return;
     }
+    GV_TRACE_SPAN("thumbnail", "ThumbnailView::generateThumbnailsForItems");
+    const int rowCount = model()->rowCount();
     const QRect visibleRect = viewport()->rect();
-    const int visibleSurface = visibleRect.width() * visibleRect.height();
-    const QPoint origin = visibleRect.center();
-
-    // distance => item
-    QMultiMap<int, KFileItem> itemMap;
-
-    for (int row = 0; row < model()->rowCount(); ++row) {
-        QModelIndex index = model()->index(row, 0);
-        KFileItem item = fileItemForIndex(index);
-        QUrl url = item.url();
-
-        // Filter out remote items if necessary
-        if (!d->mCreateThumbnailsForRemoteUrls && !url.isLocalFile()) {
-            continue;
-        }
-
-        // Filter out archives
-        MimeTypeUtils::Kind kind = MimeTypeUtils::fileItemKind(item);
-        if (kind == MimeTypeUtils::KIND_ARCHIVE) {
-            continue;
-        }
-
-        // Immediately update modified items
-        if (d->mDocumentInfoProvider && d->mDocumentInfoProvider->isModified(url)) {
-            d->updateThumbnailForModifiedDocument(index);
-            continue;
-        }
-
-        // Filter out items which already have a thumbnail
-        ThumbnailForUrl::ConstIterator it = d->mThumbnailForUrl.constFind(url);
-        if (it != d->mThumbnailForUrl.constEnd() && it.value().isGroupPixAdaptedForSize(d->mThumbnailSize.height())) {
-            continue;
-        }
-
-        // Compute distance
-        int distance;
-        const QRect itemRect = visualRect(index);
-        const qreal itemSurface = itemRect.width() * itemRect.height();
-        const QRect visibleItemRect = visibleRect.intersected(itemRect);
-        qreal visibleItemFract = 0;
-        if (itemSurface > 0) {
-            visibleItemFract = visibleItemRect.width() * visibleItemRect.height() / itemSurface;
-        }
-        if (visibleItemFract > 0.7) {
-            // Item is visible, order thumbnails from left to right, top to bottom
-            // Distance is computed so that it is between 0 and visibleSurface
-            distance = itemRect.top() * visibleRect.width() + itemRect.left();
-            // Make sure directory thumbnails are generated after image thumbnails:
-            // Distance is between visibleSurface and 2 * visibleSurface
-            if (kind == MimeTypeUtils::KIND_DIR) {
-                distance = distance + visibleSurface;
-            }
-        } else {
-            // Item is not visible, order thumbnails according to distance
-            // Start at 2 * visibleSurface to ensure invisible thumbnails are
-            // generated *after* visible thumbnails
-            distance = 2 * visibleSurface + (itemRect.center() - origin).manhattanLength();
+    const bool vertical = d->linesAdvanceVertically();
+    const int start = vertical ? visibleRect.top() : visibleRect.left();
+    const int end = vertical ? visibleRect.bottom() : visibleRect.right();
+
+    // Items are laid out in row order, so the visible items are a range of
+    // rows. Include items which are partially visible on the first line.
+    const QRect firstRect = visualRect(model()->index(0, 0));
+    const int itemLength = vertical ? firstRect.height() : firstRect.width();
+    const int firstVisible = qMin(d->firstRowAtOrAfter(start - itemLength + 1, vertical), rowCount - 1);
+    const int lastVisible = qMax(firstVisible, d->firstRowAtOrAfter(end + 1, vertical) - 1);
+
+    // Prefetch the thumbnails of the items which would become visible when
+    // scrolling one page in each direction
+    const int margin = (lastVisible - firstVisible + 1) * PREFETCH_PAGES;
+
+    KFileItemList visibleItems;
+    KFileItemList visibleDirItems;
+    KFileItemList prefetchItems;
+    for (int row = firstVisible; row <= lastVisible; ++row) {
+        d->collectItemForRow(row, &visibleItems, &visibleDirItems);
+    }
+    // Alternate between items after and before the visible range, so that
+    // the nearest ones come first
+    for (int offset = 1; offset <= margin; ++offset) {
+        if (lastVisible + offset < rowCount) {
+            d->collectItemForRow(lastVisible + offset, &prefetchItems, &prefetchItems);
         }
-
-        // Add the item to our map
-        itemMap.insert(distance, item);
-
-        // Insert the thumbnail in mThumbnailForUrl, so that
-        // setThumbnail() can find the item to update
-        if (it == d->mThumbnailForUrl.constEnd()) {
-            Thumbnail thumbnail = Thumbnail(QPersistentModelIndex(index), item.time(KFileItem::ModificationTime));
-            d->mThumbnailForUrl.insert(url, thumbnail);
+        if (firstVisible - offset >= 0) {
+            d->collectItemForRow(firstVisible - offset, &prefetchItems, &prefetchItems);
         }
     }
 
-    if (!itemMap.isEmpty()) {
-        d->appendItemsToThumbnailProvider(itemMap.values());
+    // Make sure directory thumbnails are generated after image thumbnails
+    const KFileItemList list = visibleItems + visibleDirItems + prefetchItems;
+    if (!list.isEmpty() && d->mThumbnailProvider) {
+        ThumbnailGroup::Enum group = d->thumbnailGroup();
+        d->mThumbnailProvider->setThumbnailGroup(group);
+        d->mThumbnailProvider->prioritizeItems(list);
     }
 }
 
@@ -911,32 +1120,63 @@ QPixmap ThumbnailView::busySequenceCurrentPixmap() const
     return d->mBusySequence.frameAt(d->mBusyAnimationTimeLine->currentFrame());
 }
 
-void ThumbnailView::smoothNextThumbnail()
+void ThumbnailView::smoothThumbnails()
 {
-    if (d->mSmoothThumbnailQueue.isEmpty()) {
+    if (d->mSmoothThumbnailWatcher.isRunning()) {
+        // finished() calls us again
         return;
     }
 
-    if (d->mThumbnailProvider && d->mThumbnailProvider->isRunning()) {
-        // give mThumbnailProvider priority over smoothing
-        d->mSmoothThumbnailTimer.start(SMOOTH_DELAY);
+    // Smooth a whole batch in parallel: the queue only contains thumbnails
+    // which have been painted, so they are probably still visible
+    const QSize size = d->smoothThumbnailSize();
+    QList<SmoothScaleJob> jobs;
+    while (!d->mSmoothThumbnailQueue.isEmpty() && jobs.count() < SMOOTH_BATCH_SIZE) {
+        const QUrl url = d->mSmoothThumbnailQueue.dequeue();
+        ThumbnailForUrl::ConstIterator it = d->mThumbnailForUrl.constFind(url);
+        if (it == d->mThumbnailForUrl.constEnd()) {
+            continue;
+        }
+        const Thumbnail& thumbnail = it.value();
+        if (!thumbnail.mRough || thumbnail.mGroupPix.isNull()) {
+            continue;
+        }
+        SmoothScaleJob job;
+        job.mUrl = url;
+        job.mGroupPixKey = thumbnail.mGroupPix.cacheKey();
+        job.mImage = thumbnail.mGroupPix.toImage();
+        job.mSize = size;
+        job.mScaleMode = d->mScaleMode;
+        jobs << job;
+    }
+    if (jobs.isEmpty()) {
         return;
     }
+    GV_TRACE_SPAN_DETAIL("thumbnail", "ThumbnailView::smoothThumbnails", QString::number(jobs.count()));
+    d->mSmoothThumbnailWatcher.setFuture(QtConcurrent::mapped(jobs, smoothScale));
+}
 
-    QUrl url = d->mSmoothThumbnailQueue.dequeue();
-    ThumbnailForUrl::Iterator it = d->mThumbnailForUrl.find(url);
-    GV_RETURN_IF_FAIL2(it != d->mThumbnailForUrl.end(), url << "not in mThumbnailForUrl.");
-
+void ThumbnailView::setSmoothThumbnail(int resultIndex)
+{
+    const SmoothScaleJob job = d->mSmoothThumbnailWatcher.resultAt(resultIndex);
+    if (job.mSize != d->smoothThumbnailSize() || job.mScaleMode != d->mScaleMode) {
+        // Thumbnail size changed while we were smoothing
+        return;
+    }
+    ThumbnailForUrl::Iterator it = d->mThumbnailForUrl.find(job.mUrl);
+    if (it == d->mThumbnailForUrl.end()) {
+        return;
+    }
     Thumbnail& thumbnail = it.value();
-    thumbnail.mAdjustedPix = d->scale(thumbnail.mGroupPix, Qt::SmoothTransformation);
-    thumbnail.mRough = false;
+    if (thumbnail.mGroupPix.cacheKey() != job.mGroupPixKey) {
+        // A new thumbnail arrived while we were smoothing
+        return;
+    }
+    thumbnail.addSmoothVariant(job.mSize, job.mGroupPixKey, QPixmap::fromImage(job.mImage));
+    d->roughAdjustThumbnail(&thumbnail);
 
-    GV_RETURN_IF_FAIL2(thumbnail.mIndex.isValid(), "index for" << url << "is invalid.");
+    GV_RETURN_IF_FAIL2(thumbnail.mIndex.isValid(), "index for" << job.mUrl << "is invalid.");
     update(thumbnail.mIndex);
-
-    if (!d->mSmoothThumbnailQueue.isEmpty()) {
-        d->mSmoothThumbnailTimer.start(0);
-    }
 }
 
 void ThumbnailView::reloadThumbnail(const QModelIndex& index)
@@ -951,6 +1191,7 @@ void ThumbnailView::reloadThumbnail(const QModelIndex& index)
     if (it == d->mThumbnailForUrl.end()) {
         return;
     }
+    d->releaseAdjustedPix(&it.value());
     d->mThumbnailForUrl.erase(it);
     generateThumbnailsForItems();
 }
@@ -28,6 +28,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 // KDE
 #include <QUrl>
 
+// Local
+#include <lib/thumbnailview/thumbnailatlas.h>
+
 class KFileItem;
 class QDragEnterEvent;
 class QDragMoveEvent;
@@ -82,7 +85,11 @@ public:
      */
     qreal thumbnailAspectRatio() const;
 
-    QPixmap thumbnailForIndex(const QModelIndex&, QSize* fullSize = 0);
+    /**
+     * Returns the thumbnail to draw for the index. It is usually a part of
+     * an atlas page, so it must not be kept.
+     */
+    AtlasPixmap thumbnailForIndex(const QModelIndex&, QSize* fullSize = 0);
 
     /**
      * Returns true if the document pointed by the index has been modified
@@ -166,6 +173,8 @@ protected:
 
     virtual void keyPressEvent(QKeyEvent*) Q_DECL_OVERRIDE;
 
+    virtual void paintEvent(QPaintEvent*) Q_DECL_OVERRIDE;
+
     virtual void resizeEvent(QResizeEvent*) Q_DECL_OVERRIDE;
 
     virtual void scrollContentsBy(int dx, int dy) Q_DECL_OVERRIDE;
@@ -204,7 +213,8 @@ private Q_SLOTS:
      */
     void updateBusyIndexes();
 
-    void smoothNextThumbnail();
+    void smoothThumbnails();
+    void setSmoothThumbnail(int resultIndex);
 
 private:
     friend struct ThumbnailViewPrivate;
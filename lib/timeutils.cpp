@@ -25,6 +25,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA
 #include <QFile>
 #include <QDateTime>
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
 
 // KDE
 #include <KFileItem>
@@ -125,6 +127,12 @@ struct CacheItem
 
 typedef QHash<QUrl, CacheItem> Cache;
 
+// The cache is shared by all threads. The mutex is not held while reading
+// Exif data, so two threads may read the same file at the same time, which
+// is harmless.
+Q_GLOBAL_STATIC(Cache, sCache)
+Q_GLOBAL_STATIC(QMutex, sCacheMutex)
+
 QDateTime dateTimeForFileItem(const KFileItem& fileItem, CachePolicy cachePolicy)
 {
     if (cachePolicy == SkipCache) {
@@ -133,16 +141,27 @@ QDateTime dateTimeForFileItem(const KFileItem& fileItem, CachePolicy cachePolicy
         return item.realTime;
     }
 
-    static Cache cache;
     const QUrl url = fileItem.targetUrl();
+    QMutexLocker locker(sCacheMutex());
+    CacheItem item = sCache->value(url);
+    locker.unlock();
 
-    Cache::iterator it = cache.find(url);
-    if (it == cache.end()) {
-        it = cache.insert(url, CacheItem());
-    }
+    item.update(fileItem);
+
+    locker.relock();
+    sCache->insert(url, item);
+    return item.realTime;
+}
 
-    it.value().update(fileItem);
-    return it.value().realTime;
+bool cachedDateTimeForFileItem(const KFileItem& fileItem, QDateTime* dateTime)
+{
+    QMutexLocker locker(sCacheMutex());
+    Cache::const_iterator it = sCache->constFind(fileItem.targetUrl());
+    if (it == sCache->constEnd() || it.value().fileMTime != fileItem.time(KFileItem::ModificationTime)) {
+        return false;
+    }
+    *dateTime = it.value().realTime;
+    return true;
 }
 
 } // namespace
@@ -39,8 +39,19 @@ enum CachePolicy
     UseCache
 };
 
+/**
+ * Returns the date of @p fileItem: the date from its Exif data if it has
+ * some, its modification time otherwise. Reading the Exif data can be slow,
+ * but this function can be called from any thread.
+ */
 QDateTime GWENVIEWLIB_EXPORT dateTimeForFileItem(const KFileItem& fileItem, Gwenview::TimeUtils::CachePolicy cachePolicy = UseCache);
 
+/**
+ * Sets @p dateTime to the date of @p fileItem and returns true if it is in
+ * the cache, returns false without reading anything otherwise
+ */
+bool GWENVIEWLIB_EXPORT cachedDateTimeForFileItem(const KFileItem& fileItem, QDateTime* dateTime);
+
 } // namespace
 
 } // namespace
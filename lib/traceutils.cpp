@@ -0,0 +1,201 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+// Self
+#include "traceutils.h"
+
+// Qt
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+
+namespace Gwenview
+{
+
+namespace TraceUtils
+{
+
+/** Flush recorded events to disk when the buffer gets bigger than this */
+static const int FLUSH_THRESHOLD = 256 * 1024;
+
+/**
+ * Owns the trace file. Events are accumulated in memory and appended to the
+ * file from time to time, the file is closed when the application exits.
+ */
+class TraceRecorder
+{
+public:
+    TraceRecorder()
+    : mFirstEvent(true)
+    {
+        const QByteArray path = qgetenv("GV_TRACE_FILE");
+        if (path.isEmpty()) {
+            return;
+        }
+        mFile.setFileName(QFile::decodeName(path));
+        if (!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Could not open trace file" << mFile.fileName();
+            return;
+        }
+        mFile.write("[\n");
+        mTimer.start();
+    }
+
+    ~TraceRecorder()
+    {
+        if (!mFile.isOpen()) {
+            return;
+        }
+        QMutexLocker locker(&mMutex);
+        mBuffer.append("\n]\n");
+        flush();
+        mFile.close();
+    }
+
+    bool isEnabled() const
+    {
+        return mFile.isOpen();
+    }
+
+    qint64 timestamp() const
+    {
+        return mTimer.nsecsElapsed() / 1000;
+    }
+
+    void record(QJsonObject event)
+    {
+        event.insert(QStringLiteral("pid"), QCoreApplication::applicationPid());
+        event.insert(QStringLiteral("tid"), QString::number(quintptr(QThread::currentThreadId())));
+        const QByteArray json = QJsonDocument(event).toJson(QJsonDocument::Compact);
+
+        QMutexLocker locker(&mMutex);
+        if (mFirstEvent) {
+            mFirstEvent = false;
+        } else {
+            mBuffer.append(",\n");
+        }
+        mBuffer.append(json);
+        if (mBuffer.size() > FLUSH_THRESHOLD) {
+            flush();
+        }
+    }
+
+private:
+    QFile mFile;
+    QElapsedTimer mTimer;
+    QMutex mMutex;
+    QByteArray mBuffer;
+    bool mFirstEvent;
+
+    // Must be called with mMutex locked
+    void flush()
+    {
+        mFile.write(mBuffer);
+        mFile.flush();
+        mBuffer.clear();
+    }
+};
+
+Q_GLOBAL_STATIC(TraceRecorder, sTraceRecorder)
+
+static QJsonObject createEvent(const char* category, const char* name, const char* phase, qint64 ts)
+{
+    QJsonObject event;
+    event.insert(QStringLiteral("cat"), QLatin1String(category));
+    event.insert(QStringLiteral("name"), QLatin1String(name));
+    event.insert(QStringLiteral("ph"), QLatin1String(phase));
+    event.insert(QStringLiteral("ts"), ts);
+    return event;
+}
+
+static QString idString(const void* id)
+{
+    return QStringLiteral("0x") + QString::number(quintptr(id), 16);
+}
+
+static void setDetail(QJsonObject* event, const QString& detail)
+{
+    if (detail.isEmpty()) {
+        return;
+    }
+    QJsonObject args;
+    args.insert(QStringLiteral("detail"), detail);
+    event->insert(QStringLiteral("args"), args);
+}
+
+bool isEnabled()
+{
+    static const bool enabled = !sTraceRecorder.isDestroyed() && sTraceRecorder->isEnabled();
+    // Spans of global objects can end after the recorder has been destroyed
+    return enabled && !sTraceRecorder.isDestroyed();
+}
+
+qint64 timestamp()
+{
+    if (sTraceRecorder.isDestroyed()) {
+        return -1;
+    }
+    return sTraceRecorder->timestamp();
+}
+
+void recordSpan(const char* category, const char* name, qint64 start, const QString& detail)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    const qint64 end = timestamp();
+    if (end < 0) {
+        return;
+    }
+    QJsonObject event = createEvent(category, name, "X", start);
+    event.insert(QStringLiteral("dur"), end - start);
+    setDetail(&event, detail);
+    sTraceRecorder->record(event);
+}
+
+void recordAsyncBegin(const char* category, const char* name, const void* id, const QString& detail)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QJsonObject event = createEvent(category, name, "b", timestamp());
+    event.insert(QStringLiteral("id"), idString(id));
+    setDetail(&event, detail);
+    sTraceRecorder->record(event);
+}
+
+void recordAsyncEnd(const char* category, const char* name, const void* id)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QJsonObject event = createEvent(category, name, "e", timestamp());
+    event.insert(QStringLiteral("id"), idString(id));
+    sTraceRecorder->record(event);
+}
+
+} // namespace TraceUtils
+
+} // namespace Gwenview
@@ -0,0 +1,122 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+#ifndef TRACEUTILS_H
+#define TRACEUTILS_H
+
+// Local
+#include <lib/gwenviewlib_export.h>
+
+// Qt
+#include <QString>
+
+namespace Gwenview
+{
+
+/**
+ * A lightweight trace recorder.
+ *
+ * Recording is enabled by setting the GV_TRACE_FILE environment variable to
+ * the path of the file to write. Events are written in the Chrome trace event
+ * format, so the file can be loaded in chrome://tracing or any compatible
+ * trace viewer.
+ *
+ * When recording is disabled, each trace point costs a boolean check.
+ */
+namespace TraceUtils
+{
+
+/**
+ * Returns true if recording is enabled. Returns false once the recorder has
+ * been destroyed, so that trace points are safe in global objects destroyed
+ * after it.
+ */
+GWENVIEWLIB_EXPORT bool isEnabled();
+
+/**
+ * Record an event which started at @p start (as returned by timestamp()) and
+ * ends now
+ */
+GWENVIEWLIB_EXPORT void recordSpan(const char* category, const char* name, qint64 start, const QString& detail = QString());
+
+/**
+ * Record the beginning of an operation which can end in another function or
+ * another thread. @p id must be the same when calling recordAsyncEnd().
+ */
+GWENVIEWLIB_EXPORT void recordAsyncBegin(const char* category, const char* name, const void* id, const QString& detail = QString());
+
+GWENVIEWLIB_EXPORT void recordAsyncEnd(const char* category, const char* name, const void* id);
+
+/**
+ * Microseconds since recording started, -1 if the recorder has been
+ * destroyed
+ */
+GWENVIEWLIB_EXPORT qint64 timestamp();
+
+/**
+ * Records the time spent between its construction and its destruction
+ */
+class Span
+{
+public:
+    Span(const char* category, const char* name, const QString& detail = QString())
+    : mCategory(category)
+    , mName(name)
+    , mStart(TraceUtils::isEnabled() ? timestamp() : -1)
+    , mDetail(detail)
+    {}
+
+    ~Span()
+    {
+        if (mStart >= 0) {
+            recordSpan(mCategory, mName, mStart, mDetail);
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(Span)
+    const char* mCategory;
+    const char* mName;
+    qint64 mStart;
+    QString mDetail;
+};
+
+} // namespace TraceUtils
+
+} // namespace Gwenview
+
+#define GV_TRACE_CONCAT2(a, b) a##b
+#define GV_TRACE_CONCAT(a, b) GV_TRACE_CONCAT2(a, b)
+
+/**
+ * Records the time spent until the end of the current scope
+ */
+#define GV_TRACE_SPAN(category, name) \
+    Gwenview::TraceUtils::Span GV_TRACE_CONCAT(gvTraceSpan, __LINE__)(category, name)
+
+/**
+ * Same as GV_TRACE_SPAN(), but attaches @p detail to the event. @p detail is
+ * only evaluated if recording is enabled.
+ */
+#define GV_TRACE_SPAN_DETAIL(category, name, detail) \
+    Gwenview::TraceUtils::Span GV_TRACE_CONCAT(gvTraceSpan, __LINE__)(category, name, \
+        Gwenview::TraceUtils::isEnabled() ? QString(detail) : QString())
+
+#endif /* TRACEUTILS_H */
@@ -65,6 +65,45 @@ void ImageScalerTest::testScaleFullImage()
     QVERIFY(TestUtils::imageCompare(scaledImage, expectedImage));
 }
 
+/**
+ * Tiles must be aligned on the zoomed image and clipped to its boundaries
+ */
+void ImageScalerTest::testTilesForRegion()
+{
+    const qreal zoom = 2;
+    const int tileSize = 16;
+    QUrl url = urlForTestFile("test.png");
+    Document::Ptr doc = DocumentFactory::instance()->load(url);
+
+    while (doc->loadingState() < Document::MetaInfoLoaded) {
+        QTest::qWait(500);
+    }
+
+    ImageScaler scaler;
+    scaler.setDocument(doc);
+    scaler.setZoom(zoom);
+    scaler.setTileSize(tileSize);
+
+    const QRect imageRect(QPoint(0, 0), doc->size() * zoom);
+    const QVector<QRect> tiles = scaler.tilesForRegion(QRect(imageRect.center(), QSize(20, 20)));
+    QVERIFY(!tiles.isEmpty());
+    Q_FOREACH(const QRect& tile, tiles) {
+        QCOMPARE(tile.left() % tileSize, 0);
+        QCOMPARE(tile.top() % tileSize, 0);
+        QVERIFY(imageRect.contains(tile));
+    }
+
+    // Asking for the whole image must return tiles covering it exactly
+    QRegion covered;
+    int area = 0;
+    Q_FOREACH(const QRect& tile, scaler.tilesForRegion(imageRect)) {
+        covered += tile;
+        area += tile.width() * tile.height();
+    }
+    QCOMPARE(covered, QRegion(imageRect));
+    QCOMPARE(area, imageRect.width() * imageRect.height());
+}
+
 #if 0
 /**
  * Scale parts of an image
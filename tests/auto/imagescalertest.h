@@ -88,6 +88,7 @@ class ImageScalerTest : public QObject
 
 private Q_SLOTS:
     void testScaleFullImage();
+    void testTilesForRegion();
 
     // FIXME Disabled for now, does not compile since ImageScaler::setImage() has
     // been replaced with ImageScaler::setDocument()
@@ -213,6 +213,27 @@ void JpegContentTest::testReadInfo()
     QCOMPARE(content.size() , QSize(ORIENT6_WIDTH, ORIENT6_HEIGHT));
 }
 
+void JpegContentTest::testLoadHeader()
+{
+    Gwenview::JpegContent content;
+    bool result = content.load(pathForTestFile(ORIENT6_FILE));
+    QVERIFY(result);
+
+    Gwenview::JpegContent headerContent;
+    result = headerContent.loadHeader(pathForTestFile(ORIENT6_FILE));
+    QVERIFY(result);
+    QCOMPARE(int(headerContent.orientation()), 6);
+    QCOMPARE(headerContent.size(), QSize(ORIENT6_WIDTH, ORIENT6_HEIGHT));
+    QVERIFY(headerContent.rawData().isEmpty());
+
+    const QImage thumbnail = headerContent.thumbnail();
+    QVERIFY(!thumbnail.isNull());
+    QCOMPARE(thumbnail, content.thumbnail());
+
+    // Not a JPEG
+    QVERIFY(!headerContent.loadHeader(pathForTestFile("test.png")));
+}
+
 void JpegContentTest::testThumbnail()
 {
     Gwenview::JpegContent content;
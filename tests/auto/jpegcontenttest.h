@@ -31,6 +31,7 @@ private Q_SLOTS:
     void initTestCase();
     void cleanupTestCase();
     void testReadInfo();
+    void testLoadHeader();
     void testThumbnail();
     void testResetOrientation();
     void testTransform();
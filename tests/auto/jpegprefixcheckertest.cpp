@@ -0,0 +1,153 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#include "jpegprefixcheckertest.h"
+
+// Qt
+#include <QBuffer>
+#include <QFile>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QLinearGradient>
+#include <QPainter>
+#include <QTest>
+
+// Local
+#include "../lib/thumbnailprovider/jpegprefixchecker.h"
+#include "testutils.h"
+
+QTEST_MAIN(JpegPrefixCheckerTest)
+
+using namespace Gwenview;
+
+/**
+ * Feeds @p data to @p checker in chunks, as a download would, until it
+ * decides. @p prefixSize is set to how much data it needed.
+ */
+static JpegPrefixChecker::Status feed(JpegPrefixChecker* checker, const QByteArray& data, int* prefixSize)
+{
+    const int chunkSize = 256;
+    JpegPrefixChecker::Status status = JpegPrefixChecker::NeedMoreData;
+    for (int size = qMin(chunkSize, data.size());; size = qMin(size + chunkSize, data.size())) {
+        status = checker->check(data.left(size));
+        *prefixSize = size;
+        if (status != JpegPrefixChecker::NeedMoreData || size == data.size()) {
+            break;
+        }
+    }
+    return status;
+}
+
+static QByteArray readTestFile(const QString& name)
+{
+    QFile file(pathForTestFile(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+static QByteArray createJpeg(int width, int height, bool progressive)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    QPainter painter(&image);
+    QLinearGradient gradient(0, 0, width, height);
+    gradient.setColorAt(0, Qt::red);
+    gradient.setColorAt(1, Qt::blue);
+    painter.fillRect(image.rect(), gradient);
+    painter.end();
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "jpeg");
+    writer.setProgressiveScanWrite(progressive);
+    writer.write(image);
+    return data;
+}
+
+void JpegPrefixCheckerTest::testEmbeddedThumbnail()
+{
+    // This image is 256x128 and contains a 128x64 thumbnail
+    const QByteArray data = readTestFile("embedded-thumbnail.jpg");
+    QVERIFY(!data.isEmpty());
+    int prefixSize;
+
+    {
+        JpegPrefixChecker checker(128, true);
+        QCOMPARE(feed(&checker, data, &prefixSize), JpegPrefixChecker::PrefixIsEnough);
+        QVERIFY(prefixSize < data.size());
+    }
+    {
+        // Thumbnail is too small
+        JpegPrefixChecker checker(256, true);
+        QCOMPARE(feed(&checker, data, &prefixSize), JpegPrefixChecker::NeedWholeFile);
+    }
+    {
+        JpegPrefixChecker checker(128, false);
+        QCOMPARE(feed(&checker, data, &prefixSize), JpegPrefixChecker::NeedWholeFile);
+    }
+}
+
+void JpegPrefixCheckerTest::testProgressive()
+{
+    const QByteArray data = createJpeg(2048, 1024, true);
+    int prefixSize;
+
+    {
+        JpegPrefixChecker checker(256, true);
+        QCOMPARE(feed(&checker, data, &prefixSize), JpegPrefixChecker::PrefixIsEnough);
+        QVERIFY(prefixSize < data.size());
+
+        // The prefix must decode to an image of the thumbnail size
+        QByteArray prefix = data.left(prefixSize);
+        QBuffer buffer(&prefix);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer, "jpeg");
+        reader.setScaledSize(QSize(256, 128));
+        const QImage image = reader.read();
+        QCOMPARE(image.size(), QSize(256, 128));
+    }
+    {
+        // DC coefficients are not enough for this size
+        JpegPrefixChecker checker(512, true);
+        QCOMPARE(feed(&checker, data, &prefixSize), JpegPrefixChecker::NeedWholeFile);
+    }
+}
+
+void JpegPrefixCheckerTest::testBaseline()
+{
+    const QByteArray data = createJpeg(2048, 1024, false);
+    JpegPrefixChecker checker(256, true);
+    int prefixSize;
+    QCOMPARE(feed(&checker, data, &prefixSize), JpegPrefixChecker::NeedWholeFile);
+    // Decided as soon as the header has been received
+    QVERIFY(prefixSize < data.size());
+}
+
+void JpegPrefixCheckerTest::testNotJpeg()
+{
+    const QByteArray data = readTestFile("test.png");
+    QVERIFY(!data.isEmpty());
+    JpegPrefixChecker checker(128, true);
+    int prefixSize;
+    QCOMPARE(feed(&checker, data, &prefixSize), JpegPrefixChecker::NeedWholeFile);
+    QCOMPARE(checker.status(), JpegPrefixChecker::NeedWholeFile);
+}
@@ -0,0 +1,138 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#include "localdircrawlertest.h"
+
+// Qt
+#include <QSignalSpy>
+#include <QTest>
+
+// Local
+#include <testutils.h>
+#include "../lib/localdircrawler.h"
+
+QTEST_MAIN(LocalDirCrawlerTest)
+
+using namespace Gwenview;
+
+void LocalDirCrawlerTest::initTestCase()
+{
+    qRegisterMetaType<KFileItemList>("KFileItemList");
+}
+
+void LocalDirCrawlerTest::testList()
+{
+    TestUtils::SandBoxDir sandBoxDir;
+    sandBoxDir.fill(QStringList()
+        << "a.jpg"
+        << "d1/b.png"
+        << "d1/d2/c.jpg"
+        << "notes.txt"
+        << ".hidden.jpg"
+        << ".hidden_dir/d.jpg"
+        );
+
+    LocalDirCrawler crawler;
+    QSignalSpy addedSpy(&crawler, SIGNAL(itemsAdded(QUrl,KFileItemList)));
+    QSignalSpy completedSpy(&crawler, SIGNAL(completed()));
+    crawler.start(sandBoxDir.absolutePath());
+    QVERIFY(crawler.isRunning());
+    QVERIFY(completedSpy.wait());
+    QVERIFY(!crawler.isRunning());
+
+    QList<QUrl> urls;
+    QHash<QString, QString> mimeTypes;
+    Q_FOREACH(const QList<QVariant>& arguments, addedSpy) {
+        Q_FOREACH(const KFileItem& item, arguments.at(1).value<KFileItemList>()) {
+            QVERIFY(item.isFile());
+            urls << item.url();
+            mimeTypes[item.name()] = item.mimetype();
+        }
+    }
+    qSort(urls);
+
+    QList<QUrl> expected;
+    expected
+        << QUrl::fromLocalFile(sandBoxDir.absoluteFilePath("a.jpg"))
+        << QUrl::fromLocalFile(sandBoxDir.absoluteFilePath("d1/b.png"))
+        << QUrl::fromLocalFile(sandBoxDir.absoluteFilePath("d1/d2/c.jpg"))
+        << QUrl::fromLocalFile(sandBoxDir.absoluteFilePath("notes.txt"));
+    qSort(expected);
+    QCOMPARE(urls, expected);
+
+    QCOMPARE(mimeTypes.value("a.jpg"), QString("image/jpeg"));
+    QCOMPARE(mimeTypes.value("b.png"), QString("image/png"));
+}
+
+void LocalDirCrawlerTest::testStop()
+{
+    TestUtils::SandBoxDir sandBoxDir;
+    sandBoxDir.fill(QStringList() << "a.jpg" << "d1/b.jpg");
+
+    LocalDirCrawler crawler;
+    QSignalSpy addedSpy(&crawler, SIGNAL(itemsAdded(QUrl,KFileItemList)));
+    QSignalSpy completedSpy(&crawler, SIGNAL(completed()));
+    crawler.start(sandBoxDir.absolutePath());
+    crawler.stop();
+    QVERIFY(!crawler.isRunning());
+
+    // Results of the stopped listing must not show up
+    QTest::qWait(100);
+    QCOMPARE(addedSpy.count(), 0);
+    QCOMPARE(completedSpy.count(), 0);
+}
+
+void LocalDirCrawlerTest::testWatch()
+{
+    TestUtils::SandBoxDir sandBoxDir;
+    sandBoxDir.fill(QStringList() << "a.jpg" << "b.jpg");
+
+    LocalDirCrawler crawler;
+    QSignalSpy addedSpy(&crawler, SIGNAL(itemsAdded(QUrl,KFileItemList)));
+    QSignalSpy deletedSpy(&crawler, SIGNAL(itemsDeleted(KFileItemList)));
+    QSignalSpy completedSpy(&crawler, SIGNAL(completed()));
+    crawler.start(sandBoxDir.absolutePath());
+    QVERIFY(completedSpy.wait());
+    addedSpy.clear();
+
+    // Several changes in a row are reported together
+    QVERIFY(sandBoxDir.remove("a.jpg"));
+    sandBoxDir.fill(QStringList() << "c.jpg" << "d.jpg");
+    QVERIFY(deletedSpy.wait(10000));
+    if (addedSpy.isEmpty()) {
+        QVERIFY(addedSpy.wait(10000));
+    }
+
+    QList<QUrl> addedUrls;
+    Q_FOREACH(const QList<QVariant>& arguments, addedSpy) {
+        Q_FOREACH(const KFileItem& item, arguments.at(1).value<KFileItemList>()) {
+            addedUrls << item.url();
+        }
+    }
+    qSort(addedUrls);
+    QCOMPARE(addedUrls, QList<QUrl>()
+        << QUrl::fromLocalFile(sandBoxDir.absoluteFilePath("c.jpg"))
+        << QUrl::fromLocalFile(sandBoxDir.absoluteFilePath("d.jpg")));
+
+    QCOMPARE(deletedSpy.count(), 1);
+    const KFileItemList deletedItems = deletedSpy.at(0).at(0).value<KFileItemList>();
+    QCOMPARE(deletedItems.count(), 1);
+    QCOMPARE(deletedItems.first().url(), QUrl::fromLocalFile(sandBoxDir.absoluteFilePath("a.jpg")));
+}
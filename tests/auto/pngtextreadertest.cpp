@@ -0,0 +1,106 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#include "pngtextreadertest.h"
+
+// Qt
+#include <QBuffer>
+#include <QImage>
+#include <QImageWriter>
+#include <QTest>
+
+// Local
+#include "../lib/thumbnailprovider/pngtextreader.h"
+#include "testutils.h"
+
+QTEST_MAIN(PngTextReaderTest)
+
+using namespace Gwenview;
+
+static QHash<QString, QString> createTexts()
+{
+    QHash<QString, QString> texts;
+    texts.insert("Thumb::MTime", "1234567890");
+    // Long values are compressed
+    texts.insert("Thumb::URI", "file:///home/user/Pictures/Holidays/2017/Some rather long name.jpg");
+    // Non Latin-1 values are stored as international text
+    texts.insert("Thumb::Mimetype", QString::fromUtf8("image/\xc3\xa9t\xc3\xa9"));
+    return texts;
+}
+
+static QByteArray createPng(const QHash<QString, QString>& texts)
+{
+    QImage image(64, 64, QImage::Format_RGB32);
+    image.fill(Qt::red);
+    QHash<QString, QString>::ConstIterator it = texts.constBegin(), end = texts.constEnd();
+    for (; it != end; ++it) {
+        image.setText(it.key(), it.value());
+    }
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "png");
+    writer.write(image);
+    return data;
+}
+
+static QHash<QString, QString> readTexts(QByteArray data, bool* ok)
+{
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+    QHash<QString, QString> texts;
+    *ok = PngTextReader::read(&buffer, &texts);
+    return texts;
+}
+
+void PngTextReaderTest::testRead()
+{
+    const QHash<QString, QString> expected = createTexts();
+    bool ok;
+    const QHash<QString, QString> texts = readTexts(createPng(expected), &ok);
+    QVERIFY(ok);
+    QHash<QString, QString>::ConstIterator it = expected.constBegin(), end = expected.constEnd();
+    for (; it != end; ++it) {
+        QCOMPARE(texts.value(it.key()), it.value());
+    }
+}
+
+void PngTextReaderTest::testTruncatedImageData()
+{
+    // Text chunks come first, the image data is not needed
+    const QHash<QString, QString> expected = createTexts();
+    QByteArray data = createPng(expected);
+    const int imageDataPos = data.indexOf("IDAT");
+    QVERIFY(imageDataPos > 0);
+    data.truncate(imageDataPos + 8);
+
+    bool ok;
+    const QHash<QString, QString> texts = readTexts(data, &ok);
+    QVERIFY(ok);
+    QCOMPARE(texts.value("Thumb::URI"), expected.value("Thumb::URI"));
+}
+
+void PngTextReaderTest::testNotPng()
+{
+    QHash<QString, QString> texts;
+    QVERIFY(!PngTextReader::read(pathForTestFile("orient6.jpg"), &texts));
+    QVERIFY(!PngTextReader::read(pathForTestFile("does-not-exist.png"), &texts));
+    QVERIFY(texts.isEmpty());
+}
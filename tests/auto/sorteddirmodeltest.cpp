@@ -26,12 +26,18 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <lib/semanticinfo/sorteddirmodel.h>
 
 // Qt
+#include <QDateTime>
+#include <QFile>
 
 // KDE
 #include <qtest.h>
 #include <KDirLister>
+#include <KDirModel>
 #include <QTemporaryDir>
 
+// libc
+#include <utime.h>
+
 using namespace Gwenview;
 
 QTEST_MAIN(SortedDirModelTest)
@@ -47,6 +53,28 @@ void SortedDirModelTest::initTestCase()
     createEmptyFile(mSandBoxDir.absoluteFilePath("dirs_and_docs/file.png"));
     mSandBoxDir.mkdir("docs_only");
     createEmptyFile(mSandBoxDir.absoluteFilePath("docs_only/file.png"));
+    mSandBoxDir.mkdir("numbered");
+    mSandBoxDir.mkdir("numbered/dir");
+    createEmptyFile(mSandBoxDir.absoluteFilePath("numbered/file10.png"));
+    createEmptyFile(mSandBoxDir.absoluteFilePath("numbered/file2.png"));
+    createEmptyFile(mSandBoxDir.absoluteFilePath("numbered/File3.png"));
+}
+
+static void setModificationTime(const QString& path, const QDateTime& dateTime)
+{
+    utimbuf times;
+    times.actime = dateTime.toTime_t();
+    times.modtime = times.actime;
+    utime(QFile::encodeName(path).constData(), &times);
+}
+
+static QStringList names(const SortedDirModel& model)
+{
+    QStringList list;
+    for (int row = 0; row < model.rowCount(); ++row) {
+        list << model.itemForIndex(model.index(row, 0)).name();
+    }
+    return list;
 }
 
 void SortedDirModelTest::testHasDocuments_data()
@@ -75,3 +103,85 @@ void SortedDirModelTest::testHasDocuments()
     loop.exec();
     QCOMPARE(model.hasDocuments(), hasDocuments);
 }
+
+void SortedDirModelTest::testSortByName()
+{
+    QUrl url = QUrl::fromLocalFile(mSandBoxDir.absoluteFilePath("numbered"));
+
+    SortedDirModel model;
+    model.sort(KDirModel::Name);
+    QEventLoop loop;
+    connect(model.dirLister(), SIGNAL(completed()), &loop, SLOT(quit()));
+    model.dirLister()->openUrl(url);
+    loop.exec();
+
+    QStringList names;
+    for (int row = 0; row < model.rowCount(); ++row) {
+        names << model.itemForIndex(model.index(row, 0)).name();
+    }
+    QCOMPARE(names, QStringList() << "dir" << "file2.png" << "File3.png" << "file10.png");
+}
+
+void SortedDirModelTest::testSortLargeFolder()
+{
+    // More than LARGE_FOLDER_ROW_COUNT, so that the model stops sorting
+    // while listing and sorts once done
+    const int count = 5100;
+    mSandBoxDir.mkdir("large");
+    for (int idx = 0; idx < count; ++idx) {
+        createEmptyFile(mSandBoxDir.absoluteFilePath(QString("large/file%1.png").arg(idx)));
+    }
+    QUrl url = QUrl::fromLocalFile(mSandBoxDir.absoluteFilePath("large"));
+
+    SortedDirModel model;
+    model.sort(KDirModel::Name);
+    bool sortingTurnedOff = false;
+    connect(&model, &QAbstractItemModel::rowsInserted, [&model, &sortingTurnedOff]() {
+        if (!model.dynamicSortFilter()) {
+            sortingTurnedOff = true;
+        }
+    });
+    QEventLoop loop;
+    connect(model.dirLister(), SIGNAL(completed()), &loop, SLOT(quit()));
+    model.dirLister()->openUrl(url);
+    loop.exec();
+
+    QVERIFY(sortingTurnedOff);
+    QVERIFY(model.dynamicSortFilter());
+    QCOMPARE(model.rowCount(), count);
+    for (int row = 0; row < count; ++row) {
+        QCOMPARE(model.itemForIndex(model.index(row, 0)).name(), QString("file%1.png").arg(row));
+    }
+}
+
+void SortedDirModelTest::testSortByDate()
+{
+    // The Exif date of "older" is 2003-03-10, the one of "newer" is
+    // 2003-03-25. Give them modification times in the opposite order.
+    mSandBoxDir.mkdir("dates");
+    const QString olderPath = mSandBoxDir.absoluteFilePath("dates/older.jpg");
+    const QString newerPath = mSandBoxDir.absoluteFilePath("dates/newer.jpg");
+    QVERIFY(QFile::copy(pathForTestFile("date/exif-datetimeoriginal.jpg"), olderPath));
+    QVERIFY(QFile::copy(pathForTestFile("date/exif-datetime-only.jpg"), newerPath));
+    setModificationTime(olderPath, QDateTime::fromString("2010-01-02T00:00:00", Qt::ISODate));
+    setModificationTime(newerPath, QDateTime::fromString("2010-01-01T00:00:00", Qt::ISODate));
+    QUrl url = QUrl::fromLocalFile(mSandBoxDir.absoluteFilePath("dates"));
+
+    SortedDirModel model;
+    model.sort(KDirModel::ModifiedTime);
+    // Exif dates are read in worker threads once the event loop runs again,
+    // so rows are first sorted by modification time
+    QStringList namesOnInsert;
+    connect(&model, &QAbstractItemModel::rowsInserted, [&model, &namesOnInsert]() {
+        if (model.rowCount() == 2) {
+            namesOnInsert = names(model);
+        }
+    });
+    QEventLoop loop;
+    connect(model.dirLister(), SIGNAL(completed()), &loop, SLOT(quit()));
+    model.dirLister()->openUrl(url);
+    loop.exec();
+
+    QCOMPARE(namesOnInsert, QStringList() << "newer.jpg" << "older.jpg");
+    QTRY_COMPARE(names(model), QStringList() << "older.jpg" << "newer.jpg");
+}
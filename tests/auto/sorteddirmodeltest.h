@@ -37,6 +37,9 @@ private Q_SLOTS:
     void initTestCase();
     void testHasDocuments_data();
     void testHasDocuments();
+    void testSortByName();
+    void testSortLargeFolder();
+    void testSortByDate();
 
 private:
     TestUtils::SandBoxDir mSandBoxDir;
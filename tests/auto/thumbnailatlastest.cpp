@@ -0,0 +1,144 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#include "thumbnailatlastest.h"
+
+// Qt
+#include <QTest>
+
+// Local
+#include "../lib/thumbnailview/thumbnailatlas.h"
+
+QTEST_MAIN(ThumbnailAtlasTest)
+
+using namespace Gwenview;
+
+static QPixmap createPixmap(int width, int height, const QColor& color)
+{
+    QPixmap pixmap(width, height);
+    pixmap.fill(color);
+    return pixmap;
+}
+
+static QRgb centerPixel(const AtlasPixmap& pixmap)
+{
+    const QImage image = pixmap.toPixmap().toImage();
+    return image.pixel(image.width() / 2, image.height() / 2);
+}
+
+void ThumbnailAtlasTest::testInsert()
+{
+    ThumbnailAtlas atlas(QSize(64, 64), 4);
+    const int red = atlas.insert(createPixmap(20, 16, Qt::red));
+    const int blue = atlas.insert(createPixmap(10, 30, Qt::blue));
+    QVERIFY(red != blue);
+    QCOMPARE(atlas.count(), 2);
+    QCOMPARE(atlas.pageCount(), 1);
+
+    const AtlasPixmap redPixmap = atlas.pixmap(red);
+    QCOMPARE(redPixmap.size(), QSize(20, 16));
+    QVERIFY(!redPixmap.hasAlphaChannel());
+    QCOMPARE(centerPixel(redPixmap), QColor(Qt::red).rgb());
+
+    const AtlasPixmap bluePixmap = atlas.pixmap(blue);
+    QCOMPARE(bluePixmap.size(), QSize(10, 30));
+    QCOMPARE(centerPixel(bluePixmap), QColor(Qt::blue).rgb());
+    QVERIFY(redPixmap.cacheKey() != bluePixmap.cacheKey());
+
+    QVERIFY(atlas.pixmap(-1).isNull());
+    QVERIFY(atlas.pixmap(blue + 1).isNull());
+}
+
+void ThumbnailAtlasTest::testReuseFreedSpace()
+{
+    // One page holds exactly four 16x16 pixmaps per shelf, on four shelves
+    ThumbnailAtlas atlas(QSize(64, 64), 1);
+    QList<int> ids;
+    for (int i = 0; i < 16; ++i) {
+        ids << atlas.insert(createPixmap(16, 16, Qt::red));
+    }
+    QCOMPARE(atlas.pageCount(), 1);
+
+    atlas.remove(ids.at(5));
+    QCOMPARE(atlas.count(), 15);
+    const int green = atlas.insert(createPixmap(16, 16, Qt::green));
+    QCOMPARE(atlas.pageCount(), 1);
+    QCOMPARE(atlas.count(), 16);
+    QCOMPARE(centerPixel(atlas.pixmap(green)), QColor(Qt::green).rgb());
+    // Neighbours are untouched
+    QCOMPARE(centerPixel(atlas.pixmap(ids.at(4))), QColor(Qt::red).rgb());
+    QCOMPARE(centerPixel(atlas.pixmap(ids.at(6))), QColor(Qt::red).rgb());
+}
+
+void ThumbnailAtlasTest::testRecycleLeastRecentlyUsedPage()
+{
+    ThumbnailAtlas atlas(QSize(32, 32), 2);
+    const int first = atlas.insert(createPixmap(32, 32, Qt::red));
+    atlas.startPaint();
+    const int second = atlas.insert(createPixmap(32, 32, Qt::green));
+    QCOMPARE(atlas.pageCount(), 2);
+
+    // first has not been used since the previous paint, its page is recycled
+    atlas.startPaint();
+    atlas.pixmap(second);
+    const int third = atlas.insert(createPixmap(32, 32, Qt::blue));
+    QCOMPARE(atlas.pageCount(), 2);
+    QVERIFY(atlas.pixmap(first).isNull());
+    QCOMPARE(centerPixel(atlas.pixmap(second)), QColor(Qt::green).rgb());
+    QCOMPARE(centerPixel(atlas.pixmap(third)), QColor(Qt::blue).rgb());
+}
+
+void ThumbnailAtlasTest::testKeepPagesOfCurrentPaint()
+{
+    ThumbnailAtlas atlas(QSize(32, 32), 1);
+    const int first = atlas.insert(createPixmap(32, 32, Qt::red));
+    const int second = atlas.insert(createPixmap(32, 32, Qt::green));
+    QCOMPARE(atlas.pageCount(), 2);
+    QVERIFY(!atlas.pixmap(first).isNull());
+    QVERIFY(!atlas.pixmap(second).isNull());
+
+    // The extra page goes away once it is empty
+    atlas.remove(first);
+    QCOMPARE(atlas.pageCount(), 1);
+    QCOMPARE(centerPixel(atlas.pixmap(second)), QColor(Qt::green).rgb());
+}
+
+void ThumbnailAtlasTest::testOversizedPixmap()
+{
+    ThumbnailAtlas atlas(QSize(16, 16), 4);
+    const int id = atlas.insert(createPixmap(40, 20, Qt::red));
+    QCOMPARE(atlas.pageCount(), 1);
+    QCOMPARE(atlas.pixmap(id).size(), QSize(40, 20));
+    QCOMPARE(centerPixel(atlas.pixmap(id)), QColor(Qt::red).rgb());
+    atlas.remove(id);
+    QCOMPARE(atlas.pageCount(), 0);
+}
+
+void ThumbnailAtlasTest::testClear()
+{
+    ThumbnailAtlas atlas(QSize(64, 64), 4);
+    const int id = atlas.insert(createPixmap(16, 16, Qt::red));
+    atlas.clear();
+    QCOMPARE(atlas.count(), 0);
+    QCOMPARE(atlas.pageCount(), 0);
+    QVERIFY(atlas.pixmap(id).isNull());
+    // Ids are not reused
+    QVERIFY(atlas.insert(createPixmap(16, 16, Qt::red)) != id);
+}
@@ -0,0 +1,137 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#include "thumbnailcachecleanertest.h"
+
+#include <utime.h>
+
+// Qt
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QSignalSpy>
+#include <QTest>
+#include <QUrl>
+
+// Local
+#include "../lib/thumbnailprovider/thumbnailcachecleaner.h"
+#include "../lib/thumbnailprovider/thumbnailprovider.h"
+
+QTEST_MAIN(ThumbnailCacheCleanerTest)
+
+using namespace Gwenview;
+
+static void createFile(const QString& path)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("x");
+}
+
+/**
+ * Creates the thumbnail of @p originalPath, last used @p age seconds ago.
+ * Returns its path.
+ */
+static QString createThumbnail(const QString& originalPath, int age)
+{
+    QImage image(64, 64, QImage::Format_RGB32);
+    image.fill(Qt::red);
+    image.setText("Thumb::URI", QUrl::fromLocalFile(originalPath).url());
+    const QString path = ThumbnailProvider::thumbnailPath(QUrl::fromLocalFile(originalPath), ThumbnailGroup::Normal);
+    image.save(path, "png");
+
+    utimbuf times;
+    times.actime = QDateTime::currentDateTime().addSecs(-age).toTime_t();
+    times.modtime = times.actime;
+    utime(QFile::encodeName(path).constData(), &times);
+    return path;
+}
+
+void ThumbnailCacheCleanerTest::init()
+{
+    mDir.reset(new QTemporaryDir);
+    mImageDir = mDir->path() + "/images/";
+    QDir().mkpath(mImageDir);
+    ThumbnailProvider::setThumbnailBaseDir(mDir->path() + "/thumbnails/");
+    mThumbnailDir = ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Normal);
+    QDir().mkpath(mThumbnailDir);
+}
+
+void ThumbnailCacheCleanerTest::testRemoveOrphans()
+{
+    createFile(mImageDir + "kept.png");
+    const QString keptThumbnail = createThumbnail(mImageDir + "kept.png", 0);
+    const QString orphanThumbnail = createThumbnail(mImageDir + "deleted.png", 0);
+    // May be on an unmounted device
+    const QString unmountedThumbnail = createThumbnail(mDir->path() + "/unmounted/image.png", 0);
+
+    ThumbnailCacheCleaner cleaner;
+    const ThumbnailCacheCleaner::Report report = cleaner.clean();
+
+    QCOMPARE(report.mScannedCount, 3);
+    QCOMPARE(report.mOrphanCount, 1);
+    QCOMPARE(report.mEvictedCount, 0);
+    QVERIFY(QFile::exists(keptThumbnail));
+    QVERIFY(!QFile::exists(orphanThumbnail));
+    QVERIFY(QFile::exists(unmountedThumbnail));
+}
+
+void ThumbnailCacheCleanerTest::testEvictLeastRecentlyUsed()
+{
+    const int count = 10;
+    QStringList thumbnails;
+    qint64 totalSize = 0;
+    for (int i = 0; i < count; ++i) {
+        const QString originalPath = mImageDir + QStringLiteral("image%1.png").arg(i);
+        createFile(originalPath);
+        // The first ones are the oldest
+        thumbnails << createThumbnail(originalPath, (count - i) * 3600);
+        totalSize += QFileInfo(thumbnails.last()).size();
+    }
+
+    ThumbnailCacheCleaner cleaner;
+    const qint64 sizeLimit = totalSize / 2;
+    cleaner.setSizeLimit(sizeLimit);
+    const ThumbnailCacheCleaner::Report report = cleaner.clean();
+
+    QCOMPARE(report.mOrphanCount, 0);
+    QVERIFY(report.mEvictedCount > 0);
+    QVERIFY(report.mRemainingBytes <= sizeLimit);
+    QCOMPARE(report.mRemovedBytes + report.mRemainingBytes, totalSize);
+    QVERIFY(!QFile::exists(thumbnails.first()));
+    QVERIFY(QFile::exists(thumbnails.last()));
+    for (int i = 0; i < count; ++i) {
+        QCOMPARE(QFile::exists(thumbnails.at(i)), i >= report.mEvictedCount);
+    }
+}
+
+void ThumbnailCacheCleanerTest::testStart()
+{
+    const QString orphanThumbnail = createThumbnail(mImageDir + "deleted.png", 0);
+
+    ThumbnailCacheCleaner cleaner;
+    QSignalSpy spy(&cleaner, SIGNAL(finished(Gwenview::ThumbnailCacheCleaner::Report)));
+    cleaner.start();
+    QVERIFY(spy.wait());
+    QVERIFY(!cleaner.isRunning());
+    QVERIFY(!QFile::exists(orphanThumbnail));
+}
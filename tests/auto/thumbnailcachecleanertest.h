@@ -0,0 +1,45 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#ifndef THUMBNAILCACHECLEANERTEST_H
+#define THUMBNAILCACHECLEANERTEST_H
+
+// Qt
+#include <QObject>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+
+class ThumbnailCacheCleanerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void testRemoveOrphans();
+    void testEvictLeastRecentlyUsed();
+    void testStart();
+
+private:
+    QScopedPointer<QTemporaryDir> mDir;
+    QString mImageDir;
+    QString mThumbnailDir;
+};
+
+#endif /* THUMBNAILCACHECLEANERTEST_H */
@@ -0,0 +1,123 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#include "thumbnailitemqueuetest.h"
+
+// Qt
+#include <QTest>
+
+// Local
+#include "../lib/thumbnailprovider/thumbnailitemqueue.h"
+
+QTEST_MAIN(ThumbnailItemQueueTest)
+
+using namespace Gwenview;
+
+static KFileItem createItem(const QString& name)
+{
+    return KFileItem(QUrl::fromLocalFile("/tmp/" + name), QStringLiteral("image/png"), KFileItem::Unknown);
+}
+
+static QStringList namesForQueue(const ThumbnailItemQueue& queue)
+{
+    QStringList names;
+    Q_FOREACH(const KFileItem& item, queue.items()) {
+        names << item.url().fileName();
+    }
+    return names;
+}
+
+static void fillQueue(ThumbnailItemQueue* queue, const QStringList& names)
+{
+    Q_FOREACH(const QString& name, names) {
+        queue->append(createItem(name));
+    }
+}
+
+void ThumbnailItemQueueTest::testAppend()
+{
+    ThumbnailItemQueue queue;
+    QVERIFY(queue.isEmpty());
+    QVERIFY(queue.append(createItem("a")));
+    QVERIFY(queue.append(createItem("b")));
+    QVERIFY(!queue.append(createItem("a")));
+    QCOMPARE(queue.count(), 2);
+    QCOMPARE(namesForQueue(queue), QStringList() << "a" << "b");
+
+    QCOMPARE(queue.takeFirst().url().fileName(), QString("a"));
+    QVERIFY(!queue.contains(QUrl::fromLocalFile("/tmp/a")));
+    QCOMPARE(queue.takeFirst().url().fileName(), QString("b"));
+    QVERIFY(queue.isEmpty());
+}
+
+void ThumbnailItemQueueTest::testPrepend()
+{
+    ThumbnailItemQueue queue;
+    fillQueue(&queue, QStringList() << "a" << "b" << "c");
+
+    // "c" is moved, "d" is added
+    queue.prepend(KFileItemList() << createItem("c") << createItem("d"));
+    QCOMPARE(namesForQueue(queue), QStringList() << "c" << "d" << "a" << "b");
+    QCOMPARE(queue.count(), 4);
+
+    queue.append(createItem("e"));
+    QCOMPARE(namesForQueue(queue), QStringList() << "c" << "d" << "a" << "b" << "e");
+}
+
+void ThumbnailItemQueueTest::testPrioritize()
+{
+    ThumbnailItemQueue queue;
+    fillQueue(&queue, QStringList() << "a" << "b" << "c" << "d");
+
+    // Unknown urls are ignored
+    queue.prioritize(QList<QUrl>()
+                     << QUrl::fromLocalFile("/tmp/d")
+                     << QUrl::fromLocalFile("/tmp/x")
+                     << QUrl::fromLocalFile("/tmp/b"));
+    QCOMPARE(namesForQueue(queue), QStringList() << "d" << "b" << "a" << "c");
+    QCOMPARE(queue.count(), 4);
+}
+
+void ThumbnailItemQueueTest::testRemove()
+{
+    ThumbnailItemQueue queue;
+    fillQueue(&queue, QStringList() << "a" << "b" << "c");
+
+    QVERIFY(queue.remove(QUrl::fromLocalFile("/tmp/b")));
+    QVERIFY(!queue.remove(QUrl::fromLocalFile("/tmp/b")));
+    QCOMPARE(namesForQueue(queue), QStringList() << "a" << "c");
+
+    // A removed item can be queued again
+    QVERIFY(queue.append(createItem("b")));
+    QCOMPARE(namesForQueue(queue), QStringList() << "a" << "c" << "b");
+}
+
+void ThumbnailItemQueueTest::testClear()
+{
+    ThumbnailItemQueue queue;
+    fillQueue(&queue, QStringList() << "a" << "b");
+    queue.clear();
+    QVERIFY(queue.isEmpty());
+    QVERIFY(queue.items().isEmpty());
+
+    fillQueue(&queue, QStringList() << "c");
+    queue.prepend(KFileItemList() << createItem("d"));
+    QCOMPARE(namesForQueue(queue), QStringList() << "d" << "c");
+}
@@ -0,0 +1,279 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#include "thumbnailpacktest.h"
+
+// Qt
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPainter>
+#include <QTest>
+
+// Local
+#include "../lib/thumbnailprovider/thumbnailpack.h"
+
+QTEST_MAIN(ThumbnailPackTest)
+
+using namespace Gwenview;
+
+static const char* URI1 = "file:///tmp/pictures/a.jpg";
+static const char* URI2 = "file:///tmp/pictures/b.jpg";
+
+static QImage createImage(const QSize& size, QImage::Format format, const QColor& color)
+{
+    QImage image(size, format);
+    image.fill(color);
+    QPainter painter(&image);
+    painter.fillRect(0, 0, size.width() / 2, size.height() / 2, Qt::blue);
+    return image;
+}
+
+static bool imagesAreEqual(const QImage& image1, const QImage& image2)
+{
+    const QImage::Format format = QImage::Format_ARGB32_Premultiplied;
+    return image1.convertToFormat(format) == image2.convertToFormat(format);
+}
+
+void ThumbnailPackTest::init()
+{
+    mDir.reset(new QTemporaryDir);
+    QVERIFY(mDir->isValid());
+}
+
+QString ThumbnailPackTest::packPath() const
+{
+    return mDir->path() + "/gwenview-packs/normal/test.pack";
+}
+
+void ThumbnailPackTest::testPackPath()
+{
+    const QString groupDir = "/home/user/.cache/thumbnails/normal/";
+    const QString path1 = ThumbnailPack::packPath(groupDir, URI1);
+    const QString path2 = ThumbnailPack::packPath(groupDir, URI2);
+    const QString path3 = ThumbnailPack::packPath(groupDir, "file:///tmp/other/a.jpg");
+
+    // Images of the same dir share their pack
+    QCOMPARE(path1, path2);
+    QVERIFY(path1 != path3);
+    QVERIFY(path1.startsWith("/home/user/.cache/thumbnails/gwenview-packs/normal/"));
+    QVERIFY(path1.endsWith(".pack"));
+
+    // The trailing slash does not matter
+    QCOMPARE(ThumbnailPack::packPath("/home/user/.cache/thumbnails/normal", URI1), path1);
+}
+
+void ThumbnailPackTest::testRoundTrip_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::newRow("opaque") << int(QImage::Format_RGB32);
+    QTest::newRow("alpha") << int(QImage::Format_ARGB32);
+}
+
+void ThumbnailPackTest::testRoundTrip()
+{
+    QFETCH(int, format);
+    const QImage image1 = createImage(QSize(128, 96), QImage::Format(format), QColor(255, 0, 0, 128));
+    const QImage image2 = createImage(QSize(64, 128), QImage::Format(format), Qt::green);
+    {
+        ThumbnailPack pack(packPath());
+        QVERIFY(pack.append(URI1, 1000, 2000, QSize(1280, 960), image1));
+        QVERIFY(pack.append(URI2, 1001, 2001, QSize(640, 1280), image2));
+        QCOMPARE(pack.count(), 2);
+    }
+
+    ThumbnailPack pack(packPath());
+    QVERIFY(pack.open());
+    QCOMPARE(pack.count(), 2);
+
+    QSize originalSize;
+    QImage result = pack.image(URI1, 1000, 2000, &originalSize);
+    QCOMPARE(originalSize, QSize(1280, 960));
+    QCOMPARE(result.hasAlphaChannel(), image1.hasAlphaChannel());
+    QVERIFY(imagesAreEqual(result, image1));
+
+    result = pack.image(URI2, 1001, 2001, &originalSize);
+    QCOMPARE(originalSize, QSize(640, 1280));
+    QVERIFY(imagesAreEqual(result, image2));
+
+    QVERIFY(pack.image("file:///tmp/pictures/c.jpg", 1000, 2000, &originalSize).isNull());
+}
+
+void ThumbnailPackTest::testOutdatedEntry()
+{
+    const QImage image = createImage(QSize(128, 128), QImage::Format_RGB32, Qt::red);
+    {
+        ThumbnailPack pack(packPath());
+        QVERIFY(pack.append(URI1, 1000, 2000, QSize(1024, 1024), image));
+        QVERIFY(pack.append(URI2, 1000, 0, QSize(1024, 1024), image));
+    }
+    ThumbnailPack pack(packPath());
+    QVERIFY(pack.open());
+    QSize originalSize;
+    QVERIFY(!pack.image(URI1, 1000, 2000, &originalSize).isNull());
+    QVERIFY(pack.image(URI1, 1001, 2000, &originalSize).isNull());
+    QVERIFY(pack.image(URI1, 1000, 2001, &originalSize).isNull());
+    // A size of 0 means the size was unknown when the entry was stored
+    QVERIFY(!pack.image(URI2, 1000, 1234, &originalSize).isNull());
+}
+
+void ThumbnailPackTest::testReplaceEntry()
+{
+    const QImage image1 = createImage(QSize(128, 128), QImage::Format_RGB32, Qt::red);
+    const QImage image2 = createImage(QSize(128, 64), QImage::Format_RGB32, Qt::green);
+    {
+        ThumbnailPack pack(packPath());
+        QVERIFY(pack.append(URI1, 1000, 2000, QSize(1024, 1024), image1));
+    }
+    {
+        // Another instance appends to the existing pack
+        ThumbnailPack pack(packPath());
+        QVERIFY(pack.append(URI1, 1001, 2000, QSize(1024, 512), image2));
+        QCOMPARE(pack.count(), 1);
+    }
+    ThumbnailPack pack(packPath());
+    QVERIFY(pack.open());
+    QCOMPARE(pack.count(), 1);
+    QSize originalSize;
+    QVERIFY(pack.image(URI1, 1000, 2000, &originalSize).isNull());
+    const QImage result = pack.image(URI1, 1001, 2000, &originalSize);
+    QCOMPARE(originalSize, QSize(1024, 512));
+    QVERIFY(imagesAreEqual(result, image2));
+}
+
+void ThumbnailPackTest::testInvalidFile()
+{
+    ThumbnailPack pack(packPath());
+    QVERIFY(!pack.open());
+
+    QFile file(packPath());
+    QVERIFY(QDir().mkpath(QFileInfo(packPath()).path()));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("this is not a thumbnail pack");
+    file.close();
+    QVERIFY(!pack.open());
+
+    // Appending replaces the invalid file
+    const QImage image = createImage(QSize(128, 128), QImage::Format_RGB32, Qt::red);
+    QVERIFY(pack.append(URI1, 1000, 2000, QSize(1024, 1024), image));
+    QVERIFY(pack.open());
+    QCOMPARE(pack.count(), 1);
+}
+
+void ThumbnailPackTest::testIncompleteRecord()
+{
+    const QImage image = createImage(QSize(128, 128), QImage::Format_RGB32, Qt::red);
+    {
+        ThumbnailPack pack(packPath());
+        QVERIFY(pack.append(URI1, 1000, 2000, QSize(1024, 1024), image));
+        QVERIFY(pack.append(URI2, 1000, 2000, QSize(1024, 1024), image));
+    }
+    // Simulate a writer which crashed in the middle of the last record
+    QFile file(packPath());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 100));
+    file.close();
+
+    ThumbnailPack pack(packPath());
+    QVERIFY(pack.open());
+    QCOMPARE(pack.count(), 1);
+    QSize originalSize;
+    QVERIFY(!pack.image(URI1, 1000, 2000, &originalSize).isNull());
+    QVERIFY(pack.image(URI2, 1000, 2000, &originalSize).isNull());
+
+    // Appending drops the incomplete record
+    QVERIFY(pack.append(URI2, 1000, 2000, QSize(1024, 1024), image));
+    QVERIFY(pack.open());
+    QCOMPARE(pack.count(), 2);
+    QVERIFY(!pack.image(URI2, 1000, 2000, &originalSize).isNull());
+}
+
+void ThumbnailPackTest::testInvalidFormat()
+{
+    const QImage image = createImage(QSize(128, 128), QImage::Format_RGB32, Qt::red);
+    {
+        ThumbnailPack pack(packPath());
+        QVERIFY(pack.append(URI1, 1000, 2000, QSize(1024, 1024), image));
+    }
+    // Replace the RGB888 format of the record, which follows the 16 byte
+    // file header, with one whose pixels would be bigger than the record
+    QFile file(packPath());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.seek(16 + 44));
+    const quint32 format = QImage::Format_RGB32;
+    QVERIFY(file.write(reinterpret_cast<const char*>(&format), sizeof(format)) == sizeof(format));
+    file.close();
+
+    ThumbnailPack pack(packPath());
+    QVERIFY(pack.open());
+    QCOMPARE(pack.count(), 0);
+}
+
+void ThumbnailPackTest::testCached()
+{
+    const QImage image = createImage(QSize(128, 128), QImage::Format_RGB32, Qt::red);
+    ThumbnailPack writer(packPath());
+    QVERIFY(writer.append(URI1, 1000, 2000, QSize(1024, 1024), image));
+
+    const QSharedPointer<const ThumbnailPack> pack1 = ThumbnailPack::cached(packPath());
+    QVERIFY(pack1);
+    QCOMPARE(pack1->count(), 1);
+    QCOMPARE(ThumbnailPack::cached(packPath()), pack1);
+
+    // Appending invalidates the cached pack
+    QVERIFY(writer.append(URI2, 1000, 2000, QSize(1024, 1024), image));
+    const QSharedPointer<const ThumbnailPack> pack2 = ThumbnailPack::cached(packPath());
+    QVERIFY(pack2);
+    QVERIFY(pack2 != pack1);
+    QCOMPARE(pack2->count(), 2);
+
+    // Images of the previous pack remain valid
+    QSize originalSize;
+    const QImage result = pack1->image(URI1, 1000, 2000, &originalSize);
+    QVERIFY(imagesAreEqual(result, image));
+}
+
+void ThumbnailPackTest::testCompaction()
+{
+    // Each entry takes 256 KB
+    const QImage image = createImage(QSize(256, 256), QImage::Format_ARGB32, Qt::red);
+    ThumbnailPack pack(packPath());
+    QVERIFY(pack.append(URI2, 1000, 2000, QSize(1024, 1024), image));
+    for (int i = 0; i < 40; ++i) {
+        QVERIFY(pack.append(URI1, 1000 + i, 2000, QSize(1024, 1024), image));
+    }
+    // Without compaction, the file would contain 41 entries
+    QVERIFY(QFileInfo(packPath()).size() < 20 * 256 * 1024);
+
+    // Images from the pack remain valid while it is rewritten
+    QVERIFY(pack.open());
+    QSize originalSize;
+    const QImage mapped = pack.image(URI2, 1000, 2000, &originalSize);
+    QVERIFY(!mapped.isNull());
+    for (int i = 0; i < 40; ++i) {
+        QVERIFY(pack.append(URI1, 2000 + i, 2000, QSize(1024, 1024), image));
+    }
+    QVERIFY(imagesAreEqual(mapped, image));
+
+    QVERIFY(pack.open());
+    QCOMPARE(pack.count(), 2);
+    QVERIFY(!pack.image(URI1, 2039, 2000, &originalSize).isNull());
+    QVERIFY(!pack.image(URI2, 1000, 2000, &originalSize).isNull());
+}
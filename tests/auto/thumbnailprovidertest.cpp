@@ -33,6 +33,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 // Local
 #include "../lib/imageformats/imageformats.h"
+#include "../lib/thumbnailprovider/thumbnailcache.h"
 #include "../lib/thumbnailprovider/thumbnailprovider.h"
 #include "testutils.h"
 
@@ -278,3 +279,235 @@ void ThumbnailProviderTest::testRemoveItemsWhileGenerating()
     provider.removeItems(list);
     loop.exec();
 }
+
+/**
+ * The provider queues a limited number of items to the generator thread pool
+ * at a time. Make sure all thumbnails are generated anyway, and that
+ * finished() is only emitted once everything is done.
+ */
+void ThumbnailProviderTest::testLoadMoreItemsThanThreads()
+{
+    SandBox sandBox;
+    sandBox.initDir();
+    const int count = 40;
+    for (int i = 0; i < count; ++i) {
+        sandBox.createTestImage(QStringLiteral("image%1.png").arg(i), 300, 200, QColor(i * 5, 0, 0));
+    }
+
+    KFileItemList list;
+    Q_FOREACH(const QFileInfo & info, QDir(sandBox.mPath).entryInfoList(QDir::Files)) {
+        list << KFileItem(QUrl::fromLocalFile(info.absoluteFilePath()));
+    }
+
+    ThumbnailProvider provider;
+    provider.setThumbnailGroup(ThumbnailGroup::Normal);
+    QSignalSpy loadedSpy(&provider, SIGNAL(thumbnailLoaded(KFileItem,QPixmap,QSize,qulonglong)));
+    QSignalSpy finishedSpy(&provider, SIGNAL(finished()));
+    provider.appendItems(list);
+    syncRun(&provider);
+
+    QCOMPARE(loadedSpy.count(), count);
+    QCOMPARE(finishedSpy.count(), 1);
+    QVERIFY(!provider.isRunning());
+}
+
+/**
+ * Non-raster items go through preview jobs: whether a thumbnail plugin
+ * handles them or not, they must not prevent the images from being loaded.
+ */
+void ThumbnailProviderTest::testLoadMixedItems()
+{
+    SandBox sandBox;
+    sandBox.initDir();
+    const int count = 20;
+    for (int i = 0; i < count; ++i) {
+        sandBox.createTestImage(QStringLiteral("image%1.png").arg(i), 300, 200, QColor(i * 10, 0, 0));
+        QFile file(sandBox.mPath + QStringLiteral("/text%1.txt").arg(i));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("Not an image\n");
+    }
+
+    KFileItemList list;
+    Q_FOREACH(const QFileInfo & info, QDir(sandBox.mPath).entryInfoList(QDir::Files, QDir::Name)) {
+        list << KFileItem(QUrl::fromLocalFile(info.absoluteFilePath()));
+    }
+
+    ThumbnailProvider provider;
+    provider.setThumbnailGroup(ThumbnailGroup::Normal);
+    QSignalSpy loadedSpy(&provider, SIGNAL(thumbnailLoaded(KFileItem,QPixmap,QSize,qulonglong)));
+    QSignalSpy finishedSpy(&provider, SIGNAL(finished()));
+    provider.appendItems(list);
+    syncRun(&provider);
+
+    int imageCount = 0;
+    Q_FOREACH(const QList<QVariant>& args, loadedSpy) {
+        const KFileItem item = qvariant_cast<KFileItem>(args.at(0));
+        if (item.url().fileName().endsWith(QStringLiteral(".png"))) {
+            ++imageCount;
+        }
+    }
+    QCOMPARE(imageCount, count);
+    QCOMPARE(finishedSpy.count(), 1);
+    QVERIFY(!provider.isRunning());
+}
+
+/**
+ * Providers share loaded thumbnails: when two providers are asked for the
+ * same items, both get all the thumbnails, and a provider created later gets
+ * them from memory.
+ */
+void ThumbnailProviderTest::testSharedCache()
+{
+    SandBox sandBox;
+    sandBox.initDir();
+    const int count = 10;
+    for (int i = 0; i < count; ++i) {
+        sandBox.createTestImage(QStringLiteral("shared%1.png").arg(i), 300, 200, QColor(0, i * 20, 0));
+    }
+
+    KFileItemList list;
+    Q_FOREACH(const QFileInfo & info, QDir(sandBox.mPath).entryInfoList(QDir::Files)) {
+        list << KFileItem(QUrl::fromLocalFile(info.absoluteFilePath()));
+    }
+
+    {
+        ThumbnailProvider provider1;
+        ThumbnailProvider provider2;
+        provider1.setThumbnailGroup(ThumbnailGroup::Normal);
+        provider2.setThumbnailGroup(ThumbnailGroup::Normal);
+        QSignalSpy loadedSpy1(&provider1, SIGNAL(thumbnailLoaded(KFileItem,QPixmap,QSize,qulonglong)));
+        QSignalSpy loadedSpy2(&provider2, SIGNAL(thumbnailLoaded(KFileItem,QPixmap,QSize,qulonglong)));
+        QSignalSpy finishedSpy1(&provider1, SIGNAL(finished()));
+        QSignalSpy finishedSpy2(&provider2, SIGNAL(finished()));
+        provider1.appendItems(list);
+        provider2.appendItems(list);
+        for (int i = 0; i < 100 && (finishedSpy1.isEmpty() || finishedSpy2.isEmpty()); ++i) {
+            QTest::qWait(100);
+        }
+        QCOMPARE(finishedSpy1.count(), 1);
+        QCOMPARE(finishedSpy2.count(), 1);
+        QCOMPARE(loadedSpy1.count(), count);
+        QCOMPARE(loadedSpy2.count(), count);
+    }
+    while (!ThumbnailProvider::isThumbnailWriterEmpty()) {
+        QTest::qWait(100);
+    }
+
+    // Remove the generated thumbnails: a new provider must not need them
+    QDir(ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Normal)).removeRecursively();
+    ThumbnailProvider provider;
+    provider.setThumbnailGroup(ThumbnailGroup::Normal);
+    QSignalSpy loadedSpy(&provider, SIGNAL(thumbnailLoaded(KFileItem,QPixmap,QSize,qulonglong)));
+    provider.appendItems(list);
+    syncRun(&provider);
+    QCOMPARE(loadedSpy.count(), count);
+    while (!ThumbnailProvider::isThumbnailWriterEmpty()) {
+        QTest::qWait(100);
+    }
+    QDir thumbnailDir = ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Normal);
+    QVERIFY(thumbnailDir.entryList(QStringList("*.png")).isEmpty());
+}
+
+void ThumbnailProviderTest::testCreateFromLargerGroup()
+{
+    mSandBox.createTestImage("big.png", 1024, 512, Qt::red);
+    KFileItemList list;
+    list << KFileItem(QUrl::fromLocalFile(mSandBox.mPath + "/big.png"));
+
+    // Generate the x-large thumbnail
+    {
+        ThumbnailProvider provider;
+        provider.setThumbnailGroup(ThumbnailGroup::XLarge);
+        QSignalSpy spy(&provider, SIGNAL(thumbnailLoaded(KFileItem,QPixmap,QSize,qulonglong)));
+        provider.appendItems(list);
+        syncRun(&provider);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(qvariant_cast<QPixmap>(spy.at(0).at(1)).size(), QSize(512, 256));
+    }
+    while (!ThumbnailProvider::isThumbnailWriterEmpty()) {
+        QTest::qWait(100);
+    }
+
+    // Make the x-large thumbnail green, so that we can tell whether the
+    // normal thumbnail comes from it or from the original
+    QDir xLargeDir = ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::XLarge);
+    const QStringList entryList = xLargeDir.entryList(QStringList("*.png"));
+    QCOMPARE(entryList.count(), 1);
+    const QString xLargePath = xLargeDir.filePath(entryList.first());
+    QImage xLargeThumb(xLargePath);
+    QImage greenThumb = createColoredImage(xLargeThumb.width(), xLargeThumb.height(), Qt::green);
+    Q_FOREACH(const QString& key, xLargeThumb.textKeys()) {
+        greenThumb.setText(key, xLargeThumb.text(key));
+    }
+    QVERIFY(greenThumb.save(xLargePath, "png"));
+
+    ThumbnailProvider provider;
+    provider.setThumbnailGroup(ThumbnailGroup::Normal);
+    QSignalSpy spy(&provider, SIGNAL(thumbnailLoaded(KFileItem,QPixmap,QSize,qulonglong)));
+    provider.appendItems(list);
+    syncRun(&provider);
+    QCOMPARE(spy.count(), 1);
+    const QImage thumb = qvariant_cast<QPixmap>(spy.at(0).at(1)).toImage();
+    QCOMPARE(thumb.size(), QSize(128, 64));
+    QCOMPARE(QColor(thumb.pixel(64, 32)), QColor(Qt::green));
+    QCOMPARE(spy.at(0).at(2).toSize(), QSize(1024, 512));
+}
+
+void ThumbnailProviderTest::testGroupFromPixelSize_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<qreal>("devicePixelRatio");
+    QTest::addColumn<int>("expectedGroup");
+
+    QTest::newRow("normal") << 128 << qreal(1) << int(ThumbnailGroup::Normal);
+    QTest::newRow("large") << 256 << qreal(1) << int(ThumbnailGroup::Large);
+    QTest::newRow("normal-hidpi") << 128 << qreal(2) << int(ThumbnailGroup::Large);
+    QTest::newRow("large-hidpi") << 256 << qreal(2) << int(ThumbnailGroup::XLarge);
+    QTest::newRow("fractional-hidpi") << 200 << qreal(1.5) << int(ThumbnailGroup::XLarge);
+    QTest::newRow("large-hidpi-3x") << 256 << qreal(3) << int(ThumbnailGroup::XXLarge);
+}
+
+/**
+ * On HiDPI screens, thumbnails are drawn with more device pixels than their
+ * logical size, which makes the x-large and xx-large groups reachable with
+ * the largest thumbnail size of the view.
+ */
+void ThumbnailProviderTest::testGroupFromPixelSize()
+{
+    QFETCH(int, size);
+    QFETCH(qreal, devicePixelRatio);
+    QFETCH(int, expectedGroup);
+    QCOMPARE(int(ThumbnailGroup::fromPixelSize(size, devicePixelRatio)), expectedGroup);
+}
+
+/**
+ * Thumbnails which were requested before a group change must not be emitted
+ * or cached as thumbnails of the new group.
+ */
+void ThumbnailProviderTest::testChangeGroupWhileGenerating()
+{
+    mSandBox.createTestImage("zoomed.png", 1024, 512, Qt::red);
+    const KFileItem item(QUrl::fromLocalFile(mSandBox.mPath + "/zoomed.png"));
+    KFileItemList list;
+    list << item;
+
+    ThumbnailProvider provider;
+    provider.setThumbnailGroup(ThumbnailGroup::Normal);
+    QSignalSpy spy(&provider, SIGNAL(thumbnailLoaded(KFileItem,QPixmap,QSize,qulonglong)));
+    provider.appendItems(list);
+    // Like ThumbnailView does when zooming: change the group without
+    // stopping the provider, then ask for the item again
+    provider.setThumbnailGroup(ThumbnailGroup::Large);
+    provider.appendItems(list);
+    syncRun(&provider);
+
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(qvariant_cast<QPixmap>(spy.at(0).at(1)).size(), QSize(256, 128));
+    QPixmap pixmap;
+    QSize originalSize;
+    QVERIFY(ThumbnailCache::instance()->find(item, ThumbnailGroup::Large, &pixmap, &originalSize));
+    QCOMPARE(pixmap.size(), QSize(256, 128));
+    if (ThumbnailCache::instance()->find(item, ThumbnailGroup::Normal, &pixmap, &originalSize)) {
+        QCOMPARE(pixmap.size(), QSize(128, 64));
+    }
+}
@@ -50,6 +50,13 @@ private Q_SLOTS:
     void testLoadRemote();
     void testUseEmbeddedOrNot();
     void testRemoveItemsWhileGenerating();
+    void testLoadMoreItemsThanThreads();
+    void testLoadMixedItems();
+    void testSharedCache();
+    void testCreateFromLargerGroup();
+    void testGroupFromPixelSize_data();
+    void testGroupFromPixelSize();
+    void testChangeGroupWhileGenerating();
 
 private:
     SandBox mSandBox;
@@ -25,6 +25,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 // KDE
 #include <KFileItem>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <qtest.h>
 
@@ -90,3 +91,19 @@ void TimeUtilsTest::testCache()
 
     QCOMPARE(dateTime2, item2.time(KFileItem::ModificationTime));
 }
+
+void TimeUtilsTest::testCachedDateTime()
+{
+    // Use a copy, the original may already be in the cache
+    QTemporaryDir tempDir;
+    const QString path = tempDir.path() + "/image.jpg";
+    QVERIFY(QFile::copy(pathForTestFile("date/exif-datetimeoriginal.jpg"), path));
+    KFileItem item(QUrl::fromLocalFile(path));
+
+    QDateTime dateTime;
+    QVERIFY(!TimeUtils::cachedDateTimeForFileItem(item, &dateTime));
+
+    TimeUtils::dateTimeForFileItem(item);
+    QVERIFY(TimeUtils::cachedDateTimeForFileItem(item, &dateTime));
+    QCOMPARE(dateTime, QDateTime::fromString("2003-03-10T17:45:21", Qt::ISODate));
+}
@@ -31,6 +31,7 @@ private Q_SLOTS:
     void testBasic();
     void testBasic_data();
     void testCache();
+    void testCachedDateTime();
 };
 
 #endif /* TIMEUTILSTEST_H */
@@ -0,0 +1,286 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+// Self
+#include "benchutils.h"
+
+// Qt
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QtDebug>
+
+// std
+#include <cmath>
+
+namespace BenchUtils
+{
+
+/** How often waitFor() checks its condition, in ms */
+static const int WAIT_POLL_INTERVAL = 5;
+
+void useOffscreenPlatform()
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+}
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+bool waitFor(const std::function<bool()>& condition, int timeout)
+{
+    if (condition()) {
+        return true;
+    }
+    QEventLoop loop;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QTimer timer;
+    timer.setInterval(WAIT_POLL_INTERVAL);
+    QObject::connect(&timer, &QTimer::timeout, [&]() {
+        if (condition() || elapsed.elapsed() >= timeout) {
+            loop.quit();
+        }
+    });
+    timer.start();
+    loop.exec();
+    return condition();
+}
+
+//// Corpus /////////////////////////////////////////////////////////////////
+
+QImage createImage(const QSize& size)
+{
+    QImage image(size, QImage::Format_RGB32);
+    if (image.isNull()) {
+        return image;
+    }
+    quint32 seed = 0x12345678;
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        const int g = y * 255 / size.height();
+        for (int x = 0; x < size.width(); ++x) {
+            seed = seed * 1664525 + 1013904223;
+            const int noise = int(seed >> 28) - 8;
+            const int r = qBound(0, x * 255 / size.width() + noise, 255);
+            const int b = qBound(0, 255 - (x + y) * 255 / (size.width() + size.height()) + noise, 255);
+            line[x] = qRgb(r, qBound(0, g + noise, 255), b);
+        }
+    }
+    return image;
+}
+
+QSize sizeForMegaPixels(int megaPixels)
+{
+    // 4:3 aspect ratio
+    const qreal pixels = megaPixels * 1000000.;
+    const int width = qRound(std::sqrt(pixels * 4 / 3));
+    return QSize(width, qRound(pixels / width));
+}
+
+QString createCorpusFile(const QString& path, int megaPixels, QImage* cachedImage, const ImageWriter& write)
+{
+    if (QFile::exists(path)) {
+        return path;
+    }
+    const QSize size = sizeForMegaPixels(megaPixels);
+    if (cachedImage->size() != size) {
+        *cachedImage = QImage();
+        *cachedImage = createImage(size);
+        if (cachedImage->isNull()) {
+            qWarning() << "Not enough memory to create a" << megaPixels << "MP image";
+            return QString();
+        }
+    }
+    out() << "Generating " << QFileInfo(path).fileName() << endl;
+    // Write to a temporary name so that interrupted runs do not leave
+    // truncated files behind
+    const QString tmpPath = path + QStringLiteral(".part");
+    if (!write(*cachedImage, tmpPath)) {
+        QFile::remove(tmpPath);
+        return QString();
+    }
+    QFile::rename(tmpPath, path);
+    return path;
+}
+
+//// Report /////////////////////////////////////////////////////////////////
+
+Report::Report()
+{
+    mRoot.insert(QStringLiteral("qt"), QLatin1String(qVersion()));
+    mRoot.insert(QStringLiteral("date"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+}
+
+void Report::insert(const QString& key, const QJsonValue& value)
+{
+    mRoot.insert(key, value);
+}
+
+void Report::appendResult(const QJsonObject& result)
+{
+    mResults.append(result);
+}
+
+QJsonDocument Report::document() const
+{
+    QJsonObject root = mRoot;
+    root.insert(QStringLiteral("results"), mResults);
+    return QJsonDocument(root);
+}
+
+QJsonDocument loadReport(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open" << path;
+        return QJsonDocument();
+    }
+    return QJsonDocument::fromJson(file.readAll());
+}
+
+int compare(const QJsonDocument& reference, const QJsonDocument& current, qreal threshold,
+            const ResultKeyFunction& key, const QString& valueName, Direction direction)
+{
+    QHash<QString, double> referenceValues;
+    Q_FOREACH(const QJsonValue& value, reference.object().value(QStringLiteral("results")).toArray()) {
+        const QJsonObject result = value.toObject();
+        referenceValues.insert(key(result), result.value(valueName).toDouble());
+    }
+
+    int regressions = 0;
+    out() << endl << "Comparison with reference (new / old " << valueName << "):" << endl;
+    Q_FOREACH(const QJsonValue& value, current.object().value(QStringLiteral("results")).toArray()) {
+        const QJsonObject result = value.toObject();
+        const QString resultKey = key(result);
+        const double oldValue = referenceValues.value(resultKey, -1);
+        if (oldValue <= 0) {
+            continue;
+        }
+        const double ratio = result.value(valueName).toDouble() / oldValue;
+        const bool regression = direction == LowerIsBetter
+            ? ratio > 1 + threshold
+            : ratio < 1 / (1 + threshold);
+        if (regression) {
+            ++regressions;
+        }
+        out() << qSetFieldWidth(40) << left << resultKey << qSetFieldWidth(0)
+              << QString::number(ratio, 'f', 2)
+              << (regression ? " REGRESSION" : "") << endl;
+    }
+    return regressions;
+}
+
+//// Options ////////////////////////////////////////////////////////////////
+
+CommonOptions::CommonOptions(QCommandLineParser* parser, const char* defaultSizes, const QString& measureName)
+: mParser(parser)
+, mCorpusOption(QStringLiteral("corpus-dir"),
+    QStringLiteral("Where to store the generated corpus. Reusing it across runs avoids generating it again. Defaults to a temporary dir."),
+    QStringLiteral("dir"))
+, mSizesOption(QStringLiteral("sizes"),
+    QStringLiteral("Comma separated list of image sizes, in megapixels. Defaults to %1.").arg(QLatin1String(defaultSizes)),
+    QStringLiteral("sizes"), QLatin1String(defaultSizes))
+, mOutputOption(QStringLiteral("output"),
+    QStringLiteral("Write the JSON report to <file>."),
+    QStringLiteral("file"))
+, mCompareOption(QStringLiteral("compare"),
+    QStringLiteral("Compare results with the JSON report in <file>."),
+    QStringLiteral("file"))
+, mThresholdOption(QStringLiteral("threshold"),
+    QStringLiteral("Slowdown ratio above which a %1 is reported as a regression. Defaults to 0.1.").arg(measureName),
+    QStringLiteral("ratio"), QStringLiteral("0.1"))
+{
+    mParser->addHelpOption();
+    mParser->addOptions(QList<QCommandLineOption>() << mCorpusOption << mSizesOption
+                        << mOutputOption << mCompareOption << mThresholdOption);
+}
+
+CommonOptions::~CommonOptions()
+{
+}
+
+bool CommonOptions::sizes(QList<int>* sizes) const
+{
+    Q_FOREACH(const QString& token, mParser->value(mSizesOption).split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        bool ok;
+        const int size = token.toInt(&ok);
+        if (!ok || size <= 0) {
+            qCritical() << "Invalid size:" << token;
+            return false;
+        }
+        *sizes << size;
+    }
+    return true;
+}
+
+bool CommonOptions::corpusDir(QDir* dir)
+{
+    if (mParser->isSet(mCorpusOption)) {
+        *dir = QDir(mParser->value(mCorpusOption));
+    } else {
+        if (!mTempDir) {
+            mTempDir.reset(new QTemporaryDir);
+        }
+        *dir = QDir(mTempDir->path());
+    }
+    if (!dir->mkpath(QStringLiteral("."))) {
+        qCritical() << "Could not create" << dir->path();
+        return false;
+    }
+    return true;
+}
+
+int CommonOptions::finish(const QJsonDocument& json, const CompareFunction& compareFunction) const
+{
+    if (mParser->isSet(mOutputOption)) {
+        QFile file(mParser->value(mOutputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            qCritical() << "Could not write" << file.fileName();
+            return 1;
+        }
+        file.write(json.toJson());
+    }
+
+    if (mParser->isSet(mCompareOption)) {
+        const QJsonDocument reference = loadReport(mParser->value(mCompareOption));
+        if (reference.isNull()) {
+            return 1;
+        }
+        if (compareFunction(reference, json, mParser->value(mThresholdOption).toDouble()) > 0) {
+            return 2;
+        }
+    }
+    return 0;
+}
+
+} // namespace
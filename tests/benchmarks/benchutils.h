@@ -0,0 +1,156 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+#ifndef BENCHUTILS_H
+#define BENCHUTILS_H
+
+// Qt
+#include <QCommandLineOption>
+#include <QDir>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QScopedPointer>
+#include <QString>
+
+// std
+#include <functional>
+
+class QCommandLineParser;
+class QTemporaryDir;
+class QTextStream;
+
+/*
+ * Helpers shared by the benchmarks: synthetic corpus, JSON reports and the
+ * command line options every benchmark accepts
+ */
+namespace BenchUtils
+{
+
+typedef std::function<bool(const QImage&, const QString&)> ImageWriter;
+typedef std::function<QString(const QJsonObject&)> ResultKeyFunction;
+typedef std::function<int(const QJsonDocument&, const QJsonDocument&, qreal)> CompareFunction;
+
+enum Direction {
+    LowerIsBetter,
+    HigherIsBetter
+};
+
+/**
+ * The benchmarks do not show any window. Must be called before the
+ * QApplication is created.
+ */
+void useOffscreenPlatform();
+
+QTextStream& out();
+
+/**
+ * Runs the event loop until @p condition returns true, checking it every few
+ * milliseconds. Returns false if it still returns false after @p timeout ms.
+ */
+bool waitFor(const std::function<bool()>& condition, int timeout = 60000);
+
+/**
+ * A gradient with some noise, so that encoders cannot compress the image to
+ * nothing. Uses its own generator to get the same image everywhere.
+ */
+QImage createImage(const QSize& size);
+
+QSize sizeForMegaPixels(int megaPixels);
+
+/**
+ * Returns @p path, creating it with @p write from a @p megaPixels image if it
+ * does not exist yet. @p cachedImage avoids creating the same image for each
+ * format. Returns an empty string if the file cannot be written.
+ */
+QString createCorpusFile(const QString& path, int megaPixels, QImage* cachedImage, const ImageWriter& write);
+
+QJsonDocument loadReport(const QString& path);
+
+/**
+ * Prints the ratio between the @p valueName values of @p current and
+ * @p reference, matching results with @p key. Returns the number of results
+ * which got worse by more than @p threshold.
+ */
+int compare(const QJsonDocument& reference, const QJsonDocument& current, qreal threshold,
+            const ResultKeyFunction& key, const QString& valueName, Direction direction);
+
+/**
+ * Base of the benchmark reports: the run environment and a list of results
+ */
+class Report
+{
+public:
+    Report();
+
+    void insert(const QString& key, const QJsonValue& value);
+
+    QJsonDocument document() const;
+
+protected:
+    void appendResult(const QJsonObject& result);
+
+private:
+    QJsonObject mRoot;
+    QJsonArray mResults;
+};
+
+/**
+ * Options every benchmark accepts: corpus dir, image sizes, output report,
+ * comparison with a reference report
+ */
+class CommonOptions
+{
+public:
+    CommonOptions(QCommandLineParser* parser, const char* defaultSizes, const QString& measureName);
+    ~CommonOptions();
+
+    /**
+     * Reads the --sizes option. Returns false if it is invalid.
+     */
+    bool sizes(QList<int>* sizes) const;
+
+    /**
+     * Returns the --corpus-dir dir, or a temporary dir, creating it if
+     * necessary. Returns false if it cannot be created.
+     */
+    bool corpusDir(QDir* dir);
+
+    /**
+     * Writes @p json to --output and compares it with --compare using
+     * @p compareFunction. Returns the exit code of the benchmark.
+     */
+    int finish(const QJsonDocument& json, const CompareFunction& compareFunction) const;
+
+private:
+    QCommandLineParser* mParser;
+    QCommandLineOption mCorpusOption;
+    QCommandLineOption mSizesOption;
+    QCommandLineOption mOutputOption;
+    QCommandLineOption mCompareOption;
+    QCommandLineOption mThresholdOption;
+    QScopedPointer<QTemporaryDir> mTempDir;
+};
+
+} // namespace
+
+#endif /* BENCHUTILS_H */
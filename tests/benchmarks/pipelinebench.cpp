@@ -0,0 +1,610 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+/**
+ * Measures the image pipeline on a synthetic corpus.
+ *
+ * The corpus is generated deterministically the first time it is needed, so
+ * that results can be compared between builds and machines. Results are
+ * written as JSON, and a previous report can be passed with --compare to
+ * print how much each measure changed.
+ */
+#include <config-gwenview.h>
+
+// Local
+#include "benchutils.h"
+#include <lib/document/documentfactory.h>
+#include <lib/exiv2imageloader.h>
+#include <lib/imagescaler.h>
+#include <lib/jpegcontent.h>
+#include <lib/orientation.h>
+#include <lib/thumbnailprovider/thumbnailgenerator.h>
+
+// Qt
+#include <QApplication>
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QSignalSpy>
+#include <QTextStream>
+#include <QtDebug>
+
+// libjpeg
+#include <stdio.h>
+extern "C" {
+#include <jpeglib.h>
+}
+
+// std
+#include <algorithm>
+#include <functional>
+
+using namespace Gwenview;
+using namespace BenchUtils;
+
+static const int DEFAULT_ITERATIONS = 3;
+static const char* DEFAULT_SIZES = "1,12,50,200";
+static const int THUMBNAIL_SIZE = 256;
+static const QSize SCALER_VIEWPORT(1920, 1080);
+/** How long to wait for a down sampled image, in ms */
+static const int DOWN_SAMPLED_TIMEOUT = 60000;
+
+struct Format
+{
+    const char* name;
+    const char* extension;
+    bool (*write)(const QImage&, const QString&);
+};
+
+/**
+ * A measured operation. Returns false if it failed, for example because the
+ * image could not be decoded, so that failures are not timed as successes.
+ */
+typedef std::function<bool()> Task;
+
+#ifdef HAVE_FITS
+// Same hack as in app/main.cpp: the FitsPlugin symbols are not visible
+// outside of gwenviewlib, so the moc file must be compiled here for
+// Q_IMPORT_PLUGIN(FitsPlugin) to link
+#include <../../lib/imageformats/moc_fitsplugin.cpp>
+#endif
+
+//// Corpus /////////////////////////////////////////////////////////////////
+
+static bool writeWithQt(const QImage& image, const QString& path, const QByteArray& format, bool progressive = false)
+{
+    QImageWriter writer(path, format);
+    writer.setQuality(90);
+    writer.setProgressiveScanWrite(progressive);
+    if (!writer.write(image)) {
+        qWarning() << "Could not write" << path << ":" << writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+static bool writeJpegBaseline(const QImage& image, const QString& path)
+{
+    return writeWithQt(image, path, "jpeg");
+}
+
+static bool writeJpegProgressive(const QImage& image, const QString& path)
+{
+    return writeWithQt(image, path, "jpeg", true);
+}
+
+static bool writePng(const QImage& image, const QString& path)
+{
+    return writeWithQt(image, path, "png");
+}
+
+static bool writeTiff(const QImage& image, const QString& path)
+{
+    if (!QImageWriter::supportedImageFormats().contains("tiff")) {
+        return false;
+    }
+    return writeWithQt(image, path, "tiff");
+}
+
+/**
+ * Qt cannot write CMYK JPEG, use libjpeg directly. Like Adobe applications,
+ * writes an Adobe marker and stores the channels inverted, which is what
+ * readers expect from CMYK JPEG.
+ */
+static bool writeJpegCmyk(const QImage& image, const QString& path)
+{
+    FILE* file = fopen(QFile::encodeName(path).constData(), "wb");
+    if (!file) {
+        return false;
+    }
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, file);
+    cinfo.image_width = image.width();
+    cinfo.image_height = image.height();
+    cinfo.input_components = 4;
+    cinfo.in_color_space = JCS_CMYK;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    cinfo.write_Adobe_marker = TRUE;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    QByteArray row(image.width() * 4, 0);
+    JSAMPROW rowPointer = reinterpret_cast<JSAMPROW>(row.data());
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(cinfo.next_scanline));
+        uchar* dst = reinterpret_cast<uchar*>(row.data());
+        for (int x = 0; x < image.width(); ++x, dst += 4) {
+            const int r = qRed(line[x]);
+            const int g = qGreen(line[x]);
+            const int b = qBlue(line[x]);
+            // Naive conversion, K takes the common part of the inks. Inverted
+            // channels are the RGB values scaled by the inverted K.
+            const int k = 255 - qMax(r, qMax(g, b));
+            if (k == 255) {
+                dst[0] = dst[1] = dst[2] = 255;
+            } else {
+                dst[0] = uchar(r * 255 / (255 - k));
+                dst[1] = uchar(g * 255 / (255 - k));
+                dst[2] = uchar(b * 255 / (255 - k));
+            }
+            dst[3] = uchar(255 - k);
+        }
+        jpeg_write_scanlines(&cinfo, &rowPointer, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    fclose(file);
+    return true;
+}
+
+/**
+ * Writes LSB-first variable length codes, split in GIF sub-blocks
+ */
+class GifCodeWriter
+{
+public:
+    GifCodeWriter(QFile* file)
+    : mFile(file)
+    , mBits(0)
+    , mBitCount(0)
+    {}
+
+    void write(quint32 code, int size)
+    {
+        mBits |= code << mBitCount;
+        mBitCount += size;
+        while (mBitCount >= 8) {
+            appendByte(mBits & 0xff);
+            mBits >>= 8;
+            mBitCount -= 8;
+        }
+    }
+
+    void finish()
+    {
+        if (mBitCount > 0) {
+            appendByte(mBits & 0xff);
+        }
+        flushBlock();
+        mFile->putChar(0);
+    }
+
+private:
+    QFile* mFile;
+    quint32 mBits;
+    int mBitCount;
+    QByteArray mBlock;
+
+    void appendByte(char byte)
+    {
+        mBlock.append(byte);
+        if (mBlock.size() == 255) {
+            flushBlock();
+        }
+    }
+
+    void flushBlock()
+    {
+        if (mBlock.isEmpty()) {
+            return;
+        }
+        mFile->putChar(char(mBlock.size()));
+        mFile->write(mBlock);
+        mBlock.clear();
+    }
+};
+
+static void writeLittleEndian16(QFile* file, int value)
+{
+    file->putChar(char(value & 0xff));
+    file->putChar(char((value >> 8) & 0xff));
+}
+
+/**
+ * Qt cannot write GIF. Writes a 3-3-2 palette GIF whose LZW stream only
+ * contains literals: the decoder still has to do all its usual work, and
+ * the encoder fits in a few lines.
+ */
+static bool writeGif(const QImage& image, const QString& path)
+{
+    if (image.width() > 0xffff || image.height() > 0xffff) {
+        return false;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write("GIF89a");
+    writeLittleEndian16(&file, image.width());
+    writeLittleEndian16(&file, image.height());
+    file.putChar(char(0xf7)); // Global color table, 8 bits per entry, 256 entries
+    file.putChar(0); // Background color
+    file.putChar(0); // Aspect ratio
+    for (int index = 0; index < 256; ++index) {
+        file.putChar(char((index >> 5) * 255 / 7));
+        file.putChar(char(((index >> 2) & 7) * 255 / 7));
+        file.putChar(char((index & 3) * 255 / 3));
+    }
+
+    file.putChar(',');
+    writeLittleEndian16(&file, 0);
+    writeLittleEndian16(&file, 0);
+    writeLittleEndian16(&file, image.width());
+    writeLittleEndian16(&file, image.height());
+    file.putChar(0); // No local color table, not interlaced
+
+    // With a minimum code size of 8, codes are 9 bits wide until the decoder
+    // table reaches 512 entries. Emit a clear code often enough to never get
+    // there.
+    const int minCodeSize = 8;
+    const quint32 clearCode = 1 << minCodeSize;
+    const quint32 endCode = clearCode + 1;
+    const int codeSize = minCodeSize + 1;
+    const int maxLiteralsPerClear = 250;
+    file.putChar(char(minCodeSize));
+    GifCodeWriter writer(&file);
+    int literals = maxLiteralsPerClear;
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            if (literals == maxLiteralsPerClear) {
+                writer.write(clearCode, codeSize);
+                literals = 0;
+            }
+            const QRgb rgb = line[x];
+            writer.write((qRed(rgb) & 0xe0) | ((qGreen(rgb) >> 3) & 0x1c) | (qBlue(rgb) >> 6), codeSize);
+            ++literals;
+        }
+    }
+    writer.write(endCode, codeSize);
+    writer.finish();
+    file.putChar(';');
+    return true;
+}
+
+static QByteArray fitsCard(const QByteArray& text)
+{
+    return text.leftJustified(80, ' ', true);
+}
+
+/**
+ * Writes a 16 bit grayscale FITS file
+ */
+static bool writeFits(const QImage& image, const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray header;
+    header += fitsCard("SIMPLE  =                    T");
+    header += fitsCard("BITPIX  =                   16");
+    header += fitsCard("NAXIS   =                    2");
+    header += fitsCard("NAXIS1  = " + QByteArray::number(image.width()).rightJustified(20));
+    header += fitsCard("NAXIS2  = " + QByteArray::number(image.height()).rightJustified(20));
+    header += fitsCard("END");
+    header = header.leftJustified(2880, ' ');
+    file.write(header);
+
+    QByteArray row(image.width() * 2, 0);
+    qint64 dataSize = 0;
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        uchar* dst = reinterpret_cast<uchar*>(row.data());
+        for (int x = 0; x < image.width(); ++x, dst += 2) {
+            // Big endian, signed
+            const qint16 value = qint16(qGray(line[x]) * 128);
+            dst[0] = uchar(value >> 8);
+            dst[1] = uchar(value & 0xff);
+        }
+        file.write(row);
+        dataSize += row.size();
+    }
+    const int padding = (2880 - dataSize % 2880) % 2880;
+    file.write(QByteArray(padding, 0));
+    return true;
+}
+
+static const Format FORMATS[] = {
+    { "jpeg-baseline", "jpg", writeJpegBaseline },
+    { "jpeg-progressive", "jpg", writeJpegProgressive },
+    { "jpeg-cmyk", "jpg", writeJpegCmyk },
+    { "png", "png", writePng },
+    { "tiff", "tiff", writeTiff },
+    { "gif", "gif", writeGif },
+    { "fits", "fits", writeFits },
+};
+
+/**
+ * Returns the path of the corpus file for @p format at @p megaPixels,
+ * creating it if necessary. Returns an empty string if the format cannot be
+ * written.
+ */
+static QString corpusFile(const QDir& dir, const Format& format, int megaPixels, QImage* cachedImage)
+{
+    const QString path = dir.filePath(QStringLiteral("%1-%2mp.%3")
+                                      .arg(QLatin1String(format.name))
+                                      .arg(megaPixels)
+                                      .arg(QLatin1String(format.extension)));
+    return createCorpusFile(path, megaPixels, cachedImage, format.write);
+}
+
+//// Measures ///////////////////////////////////////////////////////////////
+
+/**
+ * Returns the median duration of @p task, in milliseconds, or -1 if it
+ * failed
+ */
+static double measure(int iterations, const Task& task)
+{
+    QVector<double> durations;
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        timer.start();
+        if (!task()) {
+            return -1;
+        }
+        durations << timer.nsecsElapsed() / 1000000.;
+    }
+    std::sort(durations.begin(), durations.end());
+    return durations.at(durations.size() / 2);
+}
+
+static bool loadMetaData(const QString& path)
+{
+    QImageReader reader(path);
+    const bool ok = reader.size().isValid();
+    // Not all formats have Exif data, do not check the result
+    Exiv2ImageLoader loader;
+    loader.load(path);
+    return ok;
+}
+
+static bool loadDownSampled(const QString& path)
+{
+    QImageReader reader(path);
+    reader.setScaledSize(reader.size() / 4);
+    return !reader.read().isNull();
+}
+
+static bool loadFull(const QString& path)
+{
+    QImageReader reader(path);
+    return !reader.read().isNull();
+}
+
+static bool transformJpeg(const QString& path)
+{
+    JpegContent content;
+    if (!content.load(path)) {
+        return false;
+    }
+    content.transform(ROT_90);
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    return content.save(&buffer);
+}
+
+static bool generateThumbnail(const QString& path)
+{
+    ThumbnailContext context;
+    return context.load(path, THUMBNAIL_SIZE) && !context.mImage.isNull();
+}
+
+/**
+ * Scales a viewport-sized region of the document at @p zoom, through the
+ * same code path as RasterImageView
+ */
+static bool scaleViewport(const Document::Ptr& doc, qreal zoom)
+{
+    ImageScaler scaler;
+    scaler.setDocument(doc);
+    scaler.setZoom(zoom);
+    scaler.setTransformationMode(Qt::SmoothTransformation);
+    const QRect imageRect(QPoint(0, 0), doc->size() * zoom);
+    scaler.setDestinationRegion(QRect(QPoint(0, 0), SCALER_VIEWPORT).intersected(imageRect));
+    return true;
+}
+
+class PipelineReport : public Report
+{
+public:
+    PipelineReport()
+    : mFailureCount(0)
+    {}
+
+    /**
+     * Measures @p task and adds the result. Failed measures are reported and
+     * counted instead.
+     */
+    void measure(const QString& format, int megaPixels, const QString& name, int iterations, const Task& task)
+    {
+        const double ms = ::measure(iterations, task);
+        if (ms < 0) {
+            addFailure(format, megaPixels, name);
+            return;
+        }
+        add(format, megaPixels, name, ms);
+    }
+
+    void addFailure(const QString& format, int megaPixels, const QString& name)
+    {
+        qCritical() << "Measure" << name << "failed for" << format << megaPixels << "MP";
+        ++mFailureCount;
+    }
+
+    int failureCount() const
+    {
+        return mFailureCount;
+    }
+
+private:
+    int mFailureCount;
+
+    void add(const QString& format, int megaPixels, const QString& name, double ms)
+    {
+        QJsonObject result;
+        result.insert(QStringLiteral("format"), format);
+        result.insert(QStringLiteral("megapixels"), megaPixels);
+        result.insert(QStringLiteral("measure"), name);
+        result.insert(QStringLiteral("ms"), ms);
+        appendResult(result);
+        out() << qSetFieldWidth(18) << left << format
+              << qSetFieldWidth(6) << right << megaPixels << qSetFieldWidth(0) << " MP "
+              << qSetFieldWidth(14) << left << name
+              << qSetFieldWidth(10) << right << QString::number(ms, 'f', 1)
+              << qSetFieldWidth(0) << " ms" << endl;
+    }
+};
+
+static QString resultKey(const QJsonObject& result)
+{
+    return QStringLiteral("%1 %2 MP %3")
+        .arg(result.value(QStringLiteral("format")).toString())
+        .arg(result.value(QStringLiteral("megapixels")).toInt())
+        .arg(result.value(QStringLiteral("measure")).toString());
+}
+
+int main(int argc, char** argv)
+{
+    useOffscreenPlatform();
+    QApplication app(argc, argv);
+    QApplication::setApplicationName(QStringLiteral("pipelinebench"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the Gwenview image pipeline on a synthetic corpus"));
+    CommonOptions options(&parser, DEFAULT_SIZES, QStringLiteral("measure"));
+    QCommandLineOption formatsOption(QStringLiteral("formats"),
+        QStringLiteral("Comma separated list of formats. Defaults to all formats."),
+        QStringLiteral("formats"));
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+        QStringLiteral("Number of runs of each measure, the median is reported. Defaults to %1.").arg(DEFAULT_ITERATIONS),
+        QStringLiteral("count"), QString::number(DEFAULT_ITERATIONS));
+    parser.addOptions(QList<QCommandLineOption>() << formatsOption << iterationsOption);
+    parser.process(app);
+
+    QList<int> sizes;
+    if (!options.sizes(&sizes)) {
+        return 1;
+    }
+    const QStringList formatNames = parser.value(formatsOption).split(QLatin1Char(','), QString::SkipEmptyParts);
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    QDir corpusDir;
+    if (!options.corpusDir(&corpusDir)) {
+        return 1;
+    }
+
+    const QList<QByteArray> readableFormats = QImageReader::supportedImageFormats();
+    PipelineReport report;
+    report.insert(QStringLiteral("iterations"), iterations);
+    Q_FOREACH(int megaPixels, sizes) {
+        QImage sourceImage;
+        for (const Format& format : FORMATS) {
+            const QString formatName = QLatin1String(format.name);
+            if (!formatNames.isEmpty() && !formatNames.contains(formatName)) {
+                continue;
+            }
+            const QString path = corpusFile(corpusDir, format, megaPixels, &sourceImage);
+            if (path.isEmpty()) {
+                out() << "Skipping " << formatName << ": cannot be written" << endl;
+                continue;
+            }
+            if (!readableFormats.contains(format.extension)) {
+                out() << "Skipping " << formatName << ": no image reader" << endl;
+                continue;
+            }
+
+            report.measure(formatName, megaPixels, QStringLiteral("metadata"), iterations,
+                           [&path] { return loadMetaData(path); });
+            report.measure(formatName, megaPixels, QStringLiteral("downsampled"), iterations,
+                           [&path] { return loadDownSampled(path); });
+            report.measure(formatName, megaPixels, QStringLiteral("full"), iterations,
+                           [&path] { return loadFull(path); });
+            report.measure(formatName, megaPixels, QStringLiteral("thumbnail"), iterations,
+                           [&path] { return generateThumbnail(path); });
+            if (QByteArray(format.extension) == "jpg") {
+                report.measure(formatName, megaPixels, QStringLiteral("transform"), iterations,
+                               [&path] { return transformJpeg(path); });
+            }
+
+            const QUrl url = QUrl::fromLocalFile(path);
+            Document::Ptr doc = DocumentFactory::instance()->load(url);
+            doc->waitUntilLoaded();
+            if (doc->loadingState() == Document::Loaded) {
+                // Do not measure the creation of the down sampled image
+                if (!doc->prepareDownSampledImageForZoom(0.2)) {
+                    QSignalSpy spy(doc.data(), SIGNAL(downSampledImageReady()));
+                    if (!spy.wait(DOWN_SAMPLED_TIMEOUT)) {
+                        qWarning() << "Timed out waiting for the down sampled image of" << path;
+                    }
+                }
+                // Below maxDownSampledZoom() the scaler works from the down
+                // sampled pyramid, above it works from the full image
+                report.measure(formatName, megaPixels, QStringLiteral("scale-0.2"), iterations,
+                               [&doc] { return scaleViewport(doc, 0.2); });
+                report.measure(formatName, megaPixels, QStringLiteral("scale-1.5"), iterations,
+                               [&doc] { return scaleViewport(doc, 1.5); });
+            } else {
+                report.addFailure(formatName, megaPixels, QStringLiteral("document"));
+            }
+            doc = Document::Ptr();
+            DocumentFactory::instance()->forget(url);
+        }
+    }
+
+    const int exitCode = options.finish(report.document(),
+        [](const QJsonDocument& reference, const QJsonDocument& current, qreal threshold) {
+            return compare(reference, current, threshold, resultKey, QStringLiteral("ms"), LowerIsBetter);
+        });
+    return report.failureCount() > 0 ? 1 : exitCode;
+}
+
+#ifdef HAVE_FITS
+    Q_IMPORT_PLUGIN(FitsPlugin)
+#endif
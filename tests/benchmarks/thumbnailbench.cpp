@@ -0,0 +1,369 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Cambridge, MA 02110-1301, USA.
+
+*/
+/**
+ * Measures the throughput of ThumbnailProvider on a folder of thousands of
+ * synthetic images.
+ *
+ * The same items go through several phases: generation with an empty
+ * thumbnail dir, loading from the disk cache, loading from the in-memory
+ * cache, and creation of Normal thumbnails from existing Large ones. Each
+ * phase reports its throughput, per thread of the thumbnail generator, the
+ * time needed to write the pending thumbnails and the cache hit rate.
+ *
+ * Results are written as JSON, and a previous report can be passed with
+ * --compare to print how much the throughput of each phase changed.
+ */
+// Local
+#include "benchutils.h"
+#include <lib/gwenviewconfig.h>
+#include <lib/thumbnailprovider/thumbnailcache.h>
+#include <lib/thumbnailprovider/thumbnailprovider.h>
+#include <../auto/testutils.h>
+
+// Qt
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageWriter>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QtDebug>
+
+using namespace Gwenview;
+using namespace BenchUtils;
+
+static const int DEFAULT_COUNT = 2000;
+static const char* DEFAULT_SIZES = "1,3,8";
+
+struct Format
+{
+    const char* name;
+    const char* extension;
+    const char* qtFormat;
+    bool progressive;
+};
+
+static const Format FORMATS[] = {
+    { "jpeg-baseline", "jpg", "jpeg", false },
+    { "jpeg-progressive", "jpg", "jpeg", true },
+    { "png", "png", "png", false },
+};
+
+//// Corpus /////////////////////////////////////////////////////////////////
+
+/**
+ * Returns the path of the model file for @p format at @p megaPixels, creating
+ * it if necessary. Items of the corpus are copies of these files: decoding
+ * costs the same, and the corpus can be created in seconds.
+ */
+static QString modelFile(const QDir& dir, const Format& format, int megaPixels, QImage* cachedImage)
+{
+    const QString path = dir.filePath(QStringLiteral("model-%1-%2mp.%3")
+                                      .arg(QLatin1String(format.name))
+                                      .arg(megaPixels)
+                                      .arg(QLatin1String(format.extension)));
+    return createCorpusFile(path, megaPixels, cachedImage, [&format](const QImage& image, const QString& tmpPath) {
+        QImageWriter writer(tmpPath, format.qtFormat);
+        writer.setQuality(90);
+        writer.setProgressiveScanWrite(format.progressive);
+        if (!writer.write(image)) {
+            qWarning() << "Could not write" << tmpPath << ":" << writer.errorString();
+            return false;
+        }
+        return true;
+    });
+}
+
+/**
+ * Fills dir/images with @p count items, cycling through the formats and the
+ * sizes. Existing items are kept, so a corpus dir can be reused.
+ */
+static bool createCorpus(const QDir& dir, int count, const QList<int>& sizes, KFileItemList* items)
+{
+    QStringList models;
+    Q_FOREACH(int megaPixels, sizes) {
+        QImage image;
+        for (const Format& format : FORMATS) {
+            const QString path = modelFile(dir, format, megaPixels, &image);
+            if (path.isEmpty()) {
+                return false;
+            }
+            models << path;
+        }
+    }
+
+    QDir imageDir(dir.filePath(QStringLiteral("images")));
+    if (!imageDir.mkpath(QStringLiteral("."))) {
+        qCritical() << "Could not create" << imageDir.path();
+        return false;
+    }
+    for (int index = 0; index < count; ++index) {
+        const QFileInfo model(models.at(index % models.count()));
+        // The model name in the item name ensures an item created with
+        // different sizes is not reused
+        const QString path = imageDir.filePath(QStringLiteral("%1-%2")
+                                               .arg(index, 6, 10, QLatin1Char('0'))
+                                               .arg(model.fileName().mid(6)));
+        if (!QFile::exists(path) && !QFile::copy(model.filePath(), path)) {
+            qCritical() << "Could not create" << path;
+            return false;
+        }
+        *items << KFileItem(QUrl::fromLocalFile(path));
+    }
+    return true;
+}
+
+//// Phases /////////////////////////////////////////////////////////////////
+
+struct PhaseResult
+{
+    PhaseResult()
+    : mLoadedCount(0)
+    , mFailedCount(0)
+    , mGeneratedCount(0)
+    , mMs(0)
+    , mDrainMs(0)
+    {}
+
+    int mLoadedCount;
+    int mFailedCount;
+    /// Thumbnails written to the disk cache during the phase
+    int mGeneratedCount;
+    double mMs;
+    double mDrainMs;
+};
+
+static QHash<QUrl, QDateTime> thumbnailTimes(const KFileItemList& items, ThumbnailGroup::Enum group)
+{
+    QHash<QUrl, QDateTime> times;
+    Q_FOREACH(const KFileItem& item, items) {
+        const QFileInfo info(ThumbnailProvider::thumbnailPath(item.url(), group));
+        if (info.exists()) {
+            times.insert(item.url(), info.lastModified());
+        }
+    }
+    return times;
+}
+
+/**
+ * Loads the thumbnails of @p items with a new ThumbnailProvider, then waits
+ * for the thumbnail writer to be done. The in-memory cache is cleared first,
+ * unless @p keepMemoryCache is true.
+ */
+static PhaseResult runPhase(const KFileItemList& items, ThumbnailGroup::Enum group, bool keepMemoryCache)
+{
+    if (!keepMemoryCache) {
+        Q_FOREACH(const KFileItem& item, items) {
+            ThumbnailCache::instance()->remove(item.url());
+        }
+    }
+    const QHash<QUrl, QDateTime> timesBefore = thumbnailTimes(items, group);
+
+    PhaseResult result;
+    QElapsedTimer timer;
+    {
+        ThumbnailProvider provider;
+        provider.setThumbnailGroup(group);
+        QObject::connect(&provider, &ThumbnailProvider::thumbnailLoaded,
+                         [&result](const KFileItem&, const QPixmap&, const QSize&, qulonglong) {
+            ++result.mLoadedCount;
+        });
+        QObject::connect(&provider, &ThumbnailProvider::thumbnailLoadingFailed,
+                         [&result](const KFileItem&) {
+            ++result.mFailedCount;
+        });
+        // finished() may be emitted before appendItems() returns if all the
+        // thumbnails are in memory
+        bool finished = false;
+        QEventLoop loop;
+        QObject::connect(&provider, &ThumbnailProvider::finished,
+                         [&finished, &loop]() {
+            finished = true;
+            loop.quit();
+        });
+
+        timer.start();
+        provider.appendItems(items);
+        if (!finished) {
+            loop.exec();
+        }
+        result.mMs = timer.nsecsElapsed() / 1000000.;
+    }
+
+    timer.start();
+    waitForDeferredDeletes();
+    if (!waitFor(ThumbnailProvider::isThumbnailWriterEmpty)) {
+        qWarning() << "Timed out waiting for the thumbnail writer";
+    }
+    result.mDrainMs = timer.nsecsElapsed() / 1000000.;
+
+    const QHash<QUrl, QDateTime> timesAfter = thumbnailTimes(items, group);
+    for (auto it = timesAfter.constBegin(); it != timesAfter.constEnd(); ++it) {
+        if (timesBefore.value(it.key()) != it.value()) {
+            ++result.mGeneratedCount;
+        }
+    }
+    return result;
+}
+
+static void removeThumbnails(ThumbnailGroup::Enum group)
+{
+    QDir(ThumbnailProvider::thumbnailBaseDir(group)).removeRecursively();
+}
+
+//// Report /////////////////////////////////////////////////////////////////
+
+class ThumbnailReport : public Report
+{
+public:
+    ThumbnailReport(int threadCount)
+    : mThreadCount(threadCount)
+    {
+        insert(QStringLiteral("threads"), threadCount);
+    }
+
+    void add(const QString& name, ThumbnailGroup::Enum group, int itemCount, const PhaseResult& phase)
+    {
+        const double itemsPerSecond = phase.mMs > 0 ? itemCount * 1000. / phase.mMs : 0;
+        // Thumbnails which were not written during the phase came from one
+        // of the caches. Thumbnails created from larger ones count as misses.
+        const double hitRate = itemCount > 0
+            ? qMax(0, phase.mLoadedCount - phase.mGeneratedCount) / double(itemCount)
+            : 0;
+
+        QJsonObject result;
+        result.insert(QStringLiteral("phase"), name);
+        result.insert(QStringLiteral("group"), QDir(ThumbnailProvider::thumbnailBaseDir(group)).dirName());
+        result.insert(QStringLiteral("items"), itemCount);
+        result.insert(QStringLiteral("loaded"), phase.mLoadedCount);
+        result.insert(QStringLiteral("failed"), phase.mFailedCount);
+        result.insert(QStringLiteral("generated"), phase.mGeneratedCount);
+        result.insert(QStringLiteral("ms"), phase.mMs);
+        result.insert(QStringLiteral("drainMs"), phase.mDrainMs);
+        result.insert(QStringLiteral("itemsPerSecond"), itemsPerSecond);
+        result.insert(QStringLiteral("itemsPerSecondPerThread"), itemsPerSecond / mThreadCount);
+        result.insert(QStringLiteral("cacheHitRate"), hitRate);
+        appendResult(result);
+
+        out() << qSetFieldWidth(20) << left << name
+              << qSetFieldWidth(10) << right << QString::number(phase.mMs, 'f', 0)
+              << qSetFieldWidth(0) << " ms"
+              << qSetFieldWidth(10) << right << QString::number(itemsPerSecond, 'f', 1)
+              << qSetFieldWidth(0) << " items/s"
+              << qSetFieldWidth(8) << right << QString::number(itemsPerSecond / mThreadCount, 'f', 1)
+              << qSetFieldWidth(0) << " per thread, drain "
+              << QString::number(phase.mDrainMs, 'f', 0) << " ms, hit rate "
+              << QString::number(hitRate * 100, 'f', 1) << "%";
+        if (phase.mFailedCount > 0) {
+            out() << ", " << phase.mFailedCount << " failed";
+        }
+        out() << endl;
+    }
+
+private:
+    const int mThreadCount;
+};
+
+static QString phaseKey(const QJsonObject& result)
+{
+    return result.value(QStringLiteral("phase")).toString();
+}
+
+int main(int argc, char** argv)
+{
+    useOffscreenPlatform();
+    QApplication app(argc, argv);
+    QApplication::setApplicationName(QStringLiteral("thumbnailbench"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the throughput of Gwenview thumbnail loading on a synthetic corpus"));
+    CommonOptions options(&parser, DEFAULT_SIZES, QStringLiteral("phase"));
+    QCommandLineOption countOption(QStringLiteral("count"),
+        QStringLiteral("Number of images. Defaults to %1.").arg(DEFAULT_COUNT),
+        QStringLiteral("count"), QString::number(DEFAULT_COUNT));
+    QCommandLineOption jobsOption(QStringList() << QStringLiteral("j") << QStringLiteral("jobs"),
+        QStringLiteral("Number of thumbnail generation threads. Defaults to the number of cores."),
+        QStringLiteral("count"), QString::number(QThread::idealThreadCount()));
+    QCommandLineOption packOption(QStringLiteral("pack"),
+        QStringLiteral("Also store thumbnails in thumbnail packs"));
+    parser.addOptions(QList<QCommandLineOption>() << countOption << jobsOption << packOption);
+    parser.process(app);
+
+    QList<int> sizes;
+    if (!options.sizes(&sizes)) {
+        return 1;
+    }
+    const int count = qMax(1, parser.value(countOption).toInt());
+    const int threadCount = qMax(1, parser.value(jobsOption).toInt());
+
+    // Must be done before the first ThumbnailProvider is created. The
+    // configuration is not saved.
+    GwenviewConfig::setThumbnailGenerationThreadCount(threadCount);
+    GwenviewConfig::setThumbnailPackEnabled(parser.isSet(packOption));
+
+    QDir corpusDir;
+    if (!options.corpusDir(&corpusDir)) {
+        return 1;
+    }
+    out() << "Preparing " << count << " images in " << corpusDir.path() << endl;
+    KFileItemList items;
+    if (!createCorpus(corpusDir, count, sizes, &items)) {
+        return 1;
+    }
+
+    // Never touch the user thumbnails
+    QTemporaryDir thumbnailDir;
+    ThumbnailProvider::setThumbnailBaseDir(thumbnailDir.path() + QLatin1Char('/'));
+
+    ThumbnailReport report(threadCount);
+    report.insert(QStringLiteral("items"), count);
+    QJsonArray sizeArray;
+    Q_FOREACH(int size, sizes) {
+        sizeArray.append(size);
+    }
+    report.insert(QStringLiteral("megapixels"), sizeArray);
+    report.insert(QStringLiteral("pack"), parser.isSet(packOption));
+
+    report.add(QStringLiteral("cold"), ThumbnailGroup::Normal, count,
+               runPhase(items, ThumbnailGroup::Normal, false));
+    report.add(QStringLiteral("warm-disk"), ThumbnailGroup::Normal, count,
+               runPhase(items, ThumbnailGroup::Normal, false));
+    report.add(QStringLiteral("warm-memory"), ThumbnailGroup::Normal, count,
+               runPhase(items, ThumbnailGroup::Normal, true));
+    report.add(QStringLiteral("cold-large"), ThumbnailGroup::Large, count,
+               runPhase(items, ThumbnailGroup::Large, false));
+    removeThumbnails(ThumbnailGroup::Normal);
+    report.add(QStringLiteral("normal-from-large"), ThumbnailGroup::Normal, count,
+               runPhase(items, ThumbnailGroup::Normal, false));
+
+    return options.finish(report.document(),
+        [](const QJsonDocument& reference, const QJsonDocument& current, qreal threshold) {
+            return compare(reference, current, threshold, phaseKey,
+                           QStringLiteral("itemsPerSecondPerThread"), HigherIsBetter);
+        });
+}
@@ -51,7 +51,7 @@ int main(int argc, char** argv)
     parser.addHelpOption();
     parser.addVersionOption();
     parser.addPositionalArgument("image-dir", i18n("Image dir to open"));
-    parser.addPositionalArgument("size", i18n("What size of thumbnails to generate. Can be either 'normal' or 'large'"));
+    parser.addPositionalArgument("size", i18n("What size of thumbnails to generate. Can be 'normal', 'large', 'x-large' or 'xx-large'"));
     parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("t") << QStringLiteral("thumbnail-dir"),
                                         i18n("Use <dir> instead of ~/.thumbnails to store thumbnails"), "thumbnail-dir"));
     parser.process(app);
@@ -70,6 +70,10 @@ int main(int argc, char** argv)
     ThumbnailGroup::Enum group = ThumbnailGroup::Normal;
     if (args.last() == "large") {
         group = ThumbnailGroup::Large;
+    } else if (args.last() == "x-large") {
+        group = ThumbnailGroup::XLarge;
+    } else if (args.last() == "xx-large") {
+        group = ThumbnailGroup::XXLarge;
     } else if (args.last() == "normal") {
         // group is already set to the right value
     } else {
@@ -0,0 +1,214 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+// Qt
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QTextStream>
+#include <QThread>
+
+// KDE
+#include <KAboutData>
+#include <KLocalizedString>
+
+// Local
+#include <lib/about.h>
+#include <lib/gwenviewconfig.h>
+#include <lib/imageformats/imageformats.h>
+#include <lib/thumbnailprovider/thumbnailcachecleaner.h>
+#include <lib/thumbnailprovider/thumbnailprovider.h>
+#include "pregenerator.h"
+
+using namespace Gwenview;
+
+static bool groupForName(const QString& name, ThumbnailGroup::Enum* group)
+{
+    for (int value = ThumbnailGroup::Normal; value <= ThumbnailGroup::XXLarge; ++value) {
+        const QString dir = ThumbnailProvider::thumbnailBaseDir(ThumbnailGroup::Enum(value));
+        if (QDir(dir).dirName() == name) {
+            *group = ThumbnailGroup::Enum(value);
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    // Thumbnails are QPixmaps, so we need a GUI application, but there may
+    // be no display when running from a cron job
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")
+            && qEnvironmentVariableIsEmpty("DISPLAY")
+            && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    KLocalizedString::setApplicationDomain("gwenview");
+    QApplication app(argc, argv);
+
+    QScopedPointer<KAboutData> aboutData(
+        Gwenview::createAboutData(
+            QStringLiteral("org.kde.gwenview"), /* component name */
+            i18n("Gwenview Thumbnailer")  /* programName */
+        ));
+    aboutData->setShortDescription(i18n("Generates the thumbnails of the images of folders"));
+
+    KAboutData::setApplicationData(*aboutData);
+
+    QCommandLineParser parser;
+    aboutData.data()->setupCommandLine(&parser);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("s") << QStringLiteral("size"),
+        i18n("Thumbnail size to generate: 'normal', 'large', 'x-large' or 'xx-large'. Can be repeated. Defaults to 'normal' and 'large'."),
+        i18n("size")));
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("j") << QStringLiteral("jobs"),
+        i18n("How many thumbnails to generate at the same time. Defaults to the number of cores."),
+        i18n("count")));
+    parser.addOption(QCommandLineOption(QStringLiteral("max-rate"),
+        i18n("Do not read more than <rate> megabytes of images per second"),
+        i18n("rate")));
+    parser.addOption(QCommandLineOption(QStringLiteral("dry-run"),
+        i18n("List missing and outdated thumbnails instead of generating them")));
+    parser.addOption(QCommandLineOption(QStringLiteral("state"),
+        i18n("Record finished folders in <file>, and skip the folders it lists. Use it to resume an interrupted run."),
+        i18n("file")));
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("t") << QStringLiteral("thumbnail-dir"),
+        i18n("Use <dir> instead of the default thumbnail dir"),
+        i18n("dir")));
+    parser.addOption(QCommandLineOption(QStringLiteral("clean"),
+        i18n("Remove the thumbnails of deleted images, then the least recently used thumbnails until the thumbnail dir fits in the cache size limit")));
+    parser.addOption(QCommandLineOption(QStringLiteral("cache-size"),
+        i18n("Cache size limit used by --clean, in megabytes. Defaults to the Gwenview setting."),
+        i18n("size")));
+    parser.addPositionalArgument("folders", i18n("Folders to process, including their subfolders"), i18n("folder..."));
+    parser.process(app);
+    aboutData->processCommandLine(&parser);
+
+    QTextStream err(stderr);
+    const QStringList dirs = parser.positionalArguments();
+    if (dirs.isEmpty() && !parser.isSet("clean")) {
+        parser.showHelp(1);
+    }
+    Q_FOREACH(const QString& dir, dirs) {
+        if (!QDir(dir).exists()) {
+            err << i18n("%1 is not a folder", dir) << endl;
+            return 1;
+        }
+    }
+
+    if (parser.isSet("thumbnail-dir")) {
+        QString dir = QDir(parser.value("thumbnail-dir")).absolutePath();
+        if (!dir.endsWith('/')) {
+            dir += '/';
+        }
+        ThumbnailProvider::setThumbnailBaseDir(dir);
+    }
+
+    QList<ThumbnailGroup::Enum> groups;
+    Q_FOREACH(const QString& name, parser.values("size")) {
+        ThumbnailGroup::Enum group;
+        if (!groupForName(name, &group)) {
+            err << i18n("Invalid thumbnail size: %1", name) << endl;
+            return 1;
+        }
+        if (!groups.contains(group)) {
+            groups << group;
+        }
+    }
+    if (groups.isEmpty()) {
+        groups << ThumbnailGroup::Normal << ThumbnailGroup::Large;
+    }
+
+    // Unlike the viewer, we do not need to leave a core free. This must be
+    // set before the first ThumbnailProvider is created.
+    int jobs = QThread::idealThreadCount();
+    if (parser.isSet("jobs")) {
+        bool ok;
+        jobs = parser.value("jobs").toInt(&ok);
+        if (!ok || jobs < 1) {
+            err << i18n("Invalid job count: %1", parser.value("jobs")) << endl;
+            return 1;
+        }
+    }
+    GwenviewConfig::setThumbnailGenerationThreadCount(jobs);
+
+    qint64 maxBytesPerSecond = 0;
+    if (parser.isSet("max-rate")) {
+        bool ok;
+        const double rate = parser.value("max-rate").toDouble(&ok);
+        if (!ok || rate <= 0) {
+            err << i18n("Invalid rate: %1", parser.value("max-rate")) << endl;
+            return 1;
+        }
+        maxBytesPerSecond = qint64(rate * 1024 * 1024);
+    }
+
+    qint64 cacheSizeLimit = qint64(GwenviewConfig::thumbnailCacheSizeLimit()) * 1024 * 1024;
+    if (parser.isSet("cache-size")) {
+        bool ok;
+        const qint64 size = parser.value("cache-size").toLongLong(&ok);
+        if (!ok || size < 0) {
+            err << i18n("Invalid cache size: %1", parser.value("cache-size")) << endl;
+            return 1;
+        }
+        cacheSizeLimit = size * 1024 * 1024;
+    }
+
+    if (parser.isSet("clean")) {
+        ThumbnailCacheCleaner cleaner;
+        cleaner.setSizeLimit(cacheSizeLimit);
+        const ThumbnailCacheCleaner::Report report = cleaner.clean();
+        err << i18np("1 thumbnail checked", "%1 thumbnails checked", report.mScannedCount) << endl;
+        err << i18np("1 thumbnail of a deleted image removed", "%1 thumbnails of deleted images removed", report.mOrphanCount) << endl;
+        err << i18np("1 old thumbnail removed", "%1 old thumbnails removed", report.mEvictedCount) << endl;
+        err << i18n("%1 MB freed, %2 MB used", report.mRemovedBytes / (1024 * 1024), report.mRemainingBytes / (1024 * 1024)) << endl;
+        if (dirs.isEmpty()) {
+            return 0;
+        }
+    }
+
+    Gwenview::ImageFormats::registerPlugins();
+
+    Pregenerator pregenerator;
+    pregenerator.setGroups(groups);
+    pregenerator.setDryRun(parser.isSet("dry-run"));
+    pregenerator.setMaxBytesPerSecond(maxBytesPerSecond);
+    if (parser.isSet("state")) {
+        pregenerator.setStateFile(QFileInfo(parser.value("state")).absoluteFilePath());
+    }
+    QObject::connect(&pregenerator, &Pregenerator::finished, &app, &QCoreApplication::quit);
+    pregenerator.start(dirs);
+    app.exec();
+
+    if (parser.isSet("dry-run")) {
+        err << i18np("1 thumbnail to generate", "%1 thumbnails to generate", pregenerator.staleCount()) << endl;
+        return 0;
+    }
+    err << i18np("1 thumbnail generated", "%1 thumbnails generated", pregenerator.generatedCount()) << endl;
+    if (pregenerator.failedCount() > 0) {
+        err << i18np("1 thumbnail could not be generated", "%1 thumbnails could not be generated", pregenerator.failedCount()) << endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,376 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+// Self
+#include "pregenerator.h"
+
+// Qt
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSet>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+
+// KDE
+#include <KFileItem>
+#include <KLocalizedString>
+
+// Local
+#include <lib/mimetypeutils.h>
+#include <lib/thumbnailprovider/pngtextreader.h>
+#include <lib/thumbnailprovider/thumbnailprovider.h>
+
+// std
+#include <algorithm>
+#include <functional>
+
+namespace Gwenview
+{
+
+/**
+ * The longest delay between two checks of the read budget, so that the
+ * generator does not sit idle when the budget allows more reads
+ */
+static const int MAX_FEED_DELAY = 1000;
+
+static QString nameForGroup(ThumbnailGroup::Enum group)
+{
+    const QString dir = ThumbnailProvider::thumbnailBaseDir(group);
+    return QDir(dir).dirName();
+}
+
+/**
+ * Returns true if the thumbnail at @p thumbnailPath matches @p info, or if
+ * @p info is a PNG small enough to be used as its own thumbnail
+ */
+static bool isUpToDate(const QFileInfo& info, const QString& thumbnailPath, ThumbnailGroup::Enum group)
+{
+    QHash<QString, QString> texts;
+    if (PngTextReader::read(thumbnailPath, &texts)) {
+        const qulonglong fileSize = texts.value("Thumb::Size").toULongLong();
+        return texts.value("Thumb::MTime").toLongLong() == info.lastModified().toTime_t()
+            && (fileSize == 0 || fileSize == qulonglong(info.size()));
+    }
+
+    // ThumbnailProvider does not write thumbnails for those
+    QImageReader originalReader(info.filePath());
+    const QSize size = originalReader.size();
+    const int pixelSize = ThumbnailGroup::pixelSize(group);
+    return originalReader.format() == "png"
+        && size.isValid()
+        && qMax(size.width(), size.height()) <= pixelSize;
+}
+
+struct PregeneratorPrivate
+{
+    Pregenerator* q;
+    QList<ThumbnailGroup::Enum> mGroups;
+    bool mDryRun;
+    qint64 mMaxBytesPerSecond;
+    QString mStatePath;
+
+    ThumbnailProvider* mProvider;
+    QTimer* mFeedTimer;
+    QElapsedTimer mChrono;
+    qint64 mBytesRead;
+
+    QStringList mDirs;
+    int mDirCount;
+    /// Directories done, but whose thumbnails may not be written yet
+    QStringList mUnsavedDirs;
+
+    /* @defgroup dir State of the current directory
+     * @{ */
+    QString mDir;
+    KFileItemList mItems;
+    int mGroupIndex;
+    KFileItemList mQueue;
+    /// Urls of the originals already counted in mBytesRead
+    QSet<QUrl> mReadUrls;
+    /* @} */
+
+    int mStaleCount;
+    int mGeneratedCount;
+    int mFailedCount;
+
+    QSet<QString> loadDoneDirs() const
+    {
+        QSet<QString> dirs;
+        if (mStatePath.isEmpty()) {
+            return dirs;
+        }
+        QFile file(mStatePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return dirs;
+        }
+        QTextStream stream(&file);
+        stream.setCodec("UTF-8");
+        while (!stream.atEnd()) {
+            const QString line = stream.readLine();
+            if (!line.isEmpty()) {
+                dirs.insert(line);
+            }
+        }
+        return dirs;
+    }
+
+    void saveDoneDirs()
+    {
+        if (mStatePath.isEmpty() || mUnsavedDirs.isEmpty()) {
+            return;
+        }
+        QFile file(mStatePath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            QTextStream(stderr) << i18n("Could not write to %1", mStatePath) << endl;
+            return;
+        }
+        QTextStream stream(&file);
+        stream.setCodec("UTF-8");
+        Q_FOREACH(const QString& dir, mUnsavedDirs) {
+            stream << dir << '\n';
+        }
+        mUnsavedDirs.clear();
+    }
+
+    void listItems()
+    {
+        mItems.clear();
+        mReadUrls.clear();
+        const QFileInfoList infoList = QDir(mDir).entryInfoList(QDir::Files | QDir::Readable, QDir::Name);
+        Q_FOREACH(const QFileInfo& info, infoList) {
+            const KFileItem item(QUrl::fromLocalFile(info.absoluteFilePath()));
+            if (MimeTypeUtils::fileItemKind(item) == MimeTypeUtils::KIND_RASTER_IMAGE) {
+                mItems << item;
+            }
+        }
+    }
+
+    KFileItemList staleItems(ThumbnailGroup::Enum group) const
+    {
+        KFileItemList list;
+        Q_FOREACH(const KFileItem& item, mItems) {
+            const QFileInfo info(item.url().toLocalFile());
+            if (!isUpToDate(info, ThumbnailProvider::thumbnailPath(item.url(), group), group)) {
+                list << item;
+            }
+        }
+        return list;
+    }
+};
+
+Pregenerator::Pregenerator()
+: d(new PregeneratorPrivate)
+{
+    d->q = this;
+    d->mDryRun = false;
+    d->mMaxBytesPerSecond = 0;
+    d->mProvider = 0;
+    d->mBytesRead = 0;
+    d->mDirCount = 0;
+    d->mGroupIndex = 0;
+    d->mStaleCount = 0;
+    d->mGeneratedCount = 0;
+    d->mFailedCount = 0;
+    d->mGroups << ThumbnailGroup::Large << ThumbnailGroup::Normal;
+
+    d->mFeedTimer = new QTimer(this);
+    d->mFeedTimer->setSingleShot(true);
+    connect(d->mFeedTimer, &QTimer::timeout, this, &Pregenerator::feedProvider);
+}
+
+Pregenerator::~Pregenerator()
+{
+    delete d->mProvider;
+    d->saveDoneDirs();
+    delete d;
+}
+
+void Pregenerator::setGroups(const QList<ThumbnailGroup::Enum>& groups)
+{
+    d->mGroups = groups;
+    std::sort(d->mGroups.begin(), d->mGroups.end(), std::greater<ThumbnailGroup::Enum>());
+}
+
+void Pregenerator::setDryRun(bool dryRun)
+{
+    d->mDryRun = dryRun;
+}
+
+void Pregenerator::setMaxBytesPerSecond(qint64 bytes)
+{
+    d->mMaxBytesPerSecond = bytes;
+}
+
+void Pregenerator::setStateFile(const QString& path)
+{
+    d->mStatePath = path;
+}
+
+void Pregenerator::start(const QStringList& dirs)
+{
+    const QSet<QString> doneDirs = d->loadDoneDirs();
+    QStringList allDirs;
+    Q_FOREACH(const QString& root, dirs) {
+        allDirs << QDir(root).absolutePath();
+        QDirIterator it(root, QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            allDirs << QFileInfo(it.next()).absoluteFilePath();
+        }
+    }
+    allDirs.sort();
+    allDirs.removeDuplicates();
+    Q_FOREACH(const QString& dir, allDirs) {
+        if (!doneDirs.contains(dir)) {
+            d->mDirs << dir;
+        }
+    }
+    d->mDirCount = d->mDirs.count();
+    if (!doneDirs.isEmpty()) {
+        QTextStream(stderr) << i18n("Skipping %1 folders already done", allDirs.count() - d->mDirCount) << endl;
+    }
+
+    if (!d->mDryRun) {
+        d->mProvider = new ThumbnailProvider;
+        connect(d->mProvider, SIGNAL(finished()),
+                SLOT(slotProviderFinished()));
+        connect(d->mProvider, &ThumbnailProvider::thumbnailLoaded,
+                this, &Pregenerator::slotThumbnailLoaded);
+        connect(d->mProvider, &ThumbnailProvider::thumbnailLoadingFailed,
+                this, &Pregenerator::slotThumbnailLoadingFailed);
+    }
+    d->mChrono.start();
+    QMetaObject::invokeMethod(this, "processNextDir", Qt::QueuedConnection);
+}
+
+void Pregenerator::processNextDir()
+{
+    if (ThumbnailProvider::isThumbnailWriterEmpty()) {
+        d->saveDoneDirs();
+    }
+    if (d->mDirs.isEmpty()) {
+        emit finished();
+        return;
+    }
+    d->mDir = d->mDirs.takeFirst();
+    d->listItems();
+    if (!d->mItems.isEmpty()) {
+        QTextStream(stderr)
+            << QString("[%1/%2] ").arg(d->mDirCount - d->mDirs.count()).arg(d->mDirCount)
+            << d->mDir << endl;
+    }
+    d->mGroupIndex = -1;
+    processNextGroup();
+}
+
+void Pregenerator::processNextGroup()
+{
+    while (++d->mGroupIndex < d->mGroups.count()) {
+        const ThumbnailGroup::Enum group = d->mGroups.at(d->mGroupIndex);
+        const KFileItemList list = d->staleItems(group);
+        d->mStaleCount += list.count();
+        if (d->mDryRun) {
+            QTextStream out(stdout);
+            Q_FOREACH(const KFileItem& item, list) {
+                out << nameForGroup(group) << '\t' << item.url().toLocalFile() << '\n';
+            }
+            continue;
+        }
+        if (!list.isEmpty()) {
+            d->mQueue = list;
+            d->mProvider->setThumbnailGroup(group);
+            feedProvider();
+            return;
+        }
+    }
+
+    if (!d->mDryRun) {
+        d->mUnsavedDirs << d->mDir;
+    }
+    // Do not recurse: there can be many folders without images in a row
+    QMetaObject::invokeMethod(this, "processNextDir", Qt::QueuedConnection);
+}
+
+void Pregenerator::feedProvider()
+{
+    KFileItemList list;
+    while (!d->mQueue.isEmpty()) {
+        if (d->mMaxBytesPerSecond > 0) {
+            const qint64 allowed = d->mMaxBytesPerSecond * d->mChrono.elapsed() / 1000;
+            if (d->mBytesRead > allowed) {
+                const qint64 delay = (d->mBytesRead - allowed) * 1000 / d->mMaxBytesPerSecond;
+                d->mFeedTimer->start(int(qBound(qint64(10), delay, qint64(MAX_FEED_DELAY))));
+                break;
+            }
+        }
+        const KFileItem item = d->mQueue.takeFirst();
+        // Smaller groups are usually created from the thumbnails of the
+        // larger ones, count originals only once
+        if (!d->mReadUrls.contains(item.url())) {
+            d->mReadUrls.insert(item.url());
+            d->mBytesRead += item.size();
+        }
+        list << item;
+    }
+    if (!list.isEmpty()) {
+        d->mProvider->appendItems(list);
+    }
+}
+
+void Pregenerator::slotProviderFinished()
+{
+    if (!d->mQueue.isEmpty()) {
+        // Waiting for the read budget
+        return;
+    }
+    processNextGroup();
+}
+
+void Pregenerator::slotThumbnailLoaded(const KFileItem&)
+{
+    ++d->mGeneratedCount;
+}
+
+void Pregenerator::slotThumbnailLoadingFailed(const KFileItem& item)
+{
+    ++d->mFailedCount;
+    QTextStream(stderr) << i18n("Could not generate thumbnail for %1", item.url().toLocalFile()) << endl;
+}
+
+int Pregenerator::staleCount() const
+{
+    return d->mStaleCount;
+}
+
+int Pregenerator::generatedCount() const
+{
+    return d->mGeneratedCount;
+}
+
+int Pregenerator::failedCount() const
+{
+    return d->mFailedCount;
+}
+
+} // namespace
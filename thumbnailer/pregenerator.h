@@ -0,0 +1,102 @@
+// vim: set tabstop=4 shiftwidth=4 expandtab:
+/*
+Gwenview: an image viewer
+Copyright 2026 agent <agent@local>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+#ifndef PREGENERATOR_H
+#define PREGENERATOR_H
+
+// Qt
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+// KDE
+
+// Local
+#include <lib/thumbnailgroup.h>
+
+class KFileItem;
+
+namespace Gwenview
+{
+
+struct PregeneratorPrivate;
+/**
+ * Walks directory trees and generates the missing or outdated thumbnails of
+ * the raster images they contain, one directory at a time.
+ */
+class Pregenerator : public QObject
+{
+    Q_OBJECT
+public:
+    Pregenerator();
+    ~Pregenerator();
+
+    /**
+     * Groups to generate. Larger groups are generated first, so that smaller
+     * ones can be created from them without loading the original again.
+     */
+    void setGroups(const QList<ThumbnailGroup::Enum>& groups);
+
+    /**
+     * Only report outdated thumbnails, do not generate them
+     */
+    void setDryRun(bool dryRun);
+
+    /**
+     * Limits how fast original images are read. 0 means no limit.
+     */
+    void setMaxBytesPerSecond(qint64 bytes);
+
+    /**
+     * Directories listed in @p path are skipped, and directories are added
+     * to it once all their thumbnails have been written, so that an
+     * interrupted run can be resumed
+     */
+    void setStateFile(const QString& path);
+
+    void start(const QStringList& dirs);
+
+    /**
+     * How many thumbnails were missing or outdated
+     */
+    int staleCount() const;
+
+    int generatedCount() const;
+
+    int failedCount() const;
+
+Q_SIGNALS:
+    void finished();
+
+private Q_SLOTS:
+    void processNextDir();
+    void feedProvider();
+    void slotProviderFinished();
+    void slotThumbnailLoaded(const KFileItem& item);
+    void slotThumbnailLoadingFailed(const KFileItem& item);
+
+private:
+    PregeneratorPrivate* const d;
+    void processNextGroup();
+};
+
+} // namespace
+
+#endif /* PREGENERATOR_H */